@@ -2,13 +2,22 @@
 
 #include "renderer/systems/BERenderSystem.hpp"
 #include "renderer/systems/BEPointLightSystem.hpp"
+#include "game/BETransformSystem.hpp"
+#include "game/BEBoundsSystem.hpp"
 #include "camera/BECamera.hpp"
 #include "input/BEKeyboardMovementController.hpp"
 #include "buffers/BEBuffer.hpp"
+#include "assets/BEFileSystem.hpp"
+#include "scene/BEScene.hpp"
+#include "utils/BEJobSystem.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <cstddef>
 #include <array>
 #include <chrono>
+#include <iostream>
+#include <thread>
 
 #include "input/BEMouseInputHandler.hpp"
 
@@ -28,12 +37,35 @@ namespace bucketengine
         alignas(16) glm::vec4 lightColor{1.f}; // w is light intensity
     };
     
-    App::App()
+    static SwapChainSettings swapChainSettings(const AppSettings& settings)
     {
+        SwapChainSettings swapChainSettings = SwapChainSettings::forLatencyMode(settings.latencyMode, settings.gpuPicking);
+        swapChainSettings.dynamicRendering = settings.dynamicRendering;
+        return swapChainSettings;
+    }
+    
+    App::App(const AppSettings& settings)
+        : settings{settings},
+          beRenderer{beWindow, beDevice, swapChainSettings(settings)},
+          framePacer{settings.targetFrameRate}
+    {
+        beRenderer.setPresentWait(settings.presentWait);
+
+        // start the job system here so the main thread owns a deque, before the asset streamer's
+        // threads can get to it first
+        jobThreadCount();
+
         globalPool = BEDescriptorPool::Builder(beDevice)
-            .setMaxSets(BESwapChain::MAX_FRAMES_IN_FLIGHT)
-            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, BESwapChain::MAX_FRAMES_IN_FLIGHT)
+            .setMaxSets(beRenderer.getFramesInFlight())
+            .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, beRenderer.getFramesInFlight())
             .build();
+
+        // packed builds ship their models and shaders in one archive, without it everything is
+        // read as loose files from the working directory
+        if (BEFileSystem::exists(ASSET_ARCHIVE_PATH))
+        {
+            BEFileSystem::mount(std::make_shared<BEAssetArchive>(ASSET_ARCHIVE_PATH));
+        }
         
         loadGameObjects();
     }
@@ -42,7 +74,7 @@ namespace bucketengine
 
     void App::run()
     {
-        std::vector<std::unique_ptr<BEBuffer>> uboBuffers(BESwapChain::MAX_FRAMES_IN_FLIGHT);
+        std::vector<std::unique_ptr<BEBuffer>> uboBuffers(beRenderer.getFramesInFlight());
         for (int i = 0; i < uboBuffers.size(); i++)
         {
             uboBuffers[i] = std::make_unique<BEBuffer>(
@@ -60,7 +92,7 @@ namespace bucketengine
             .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
             .build();
 
-        std::vector<VkDescriptorSet> globalDescriptorSets(BESwapChain::MAX_FRAMES_IN_FLIGHT);
+        std::vector<VkDescriptorSet> globalDescriptorSets(beRenderer.getFramesInFlight());
         for (int i = 0; i < globalDescriptorSets.size(); i++)
         {
             auto bufferInfo = uboBuffers[i]->descriptorInfo();
@@ -72,65 +104,397 @@ namespace bucketengine
         // initialise the render system
         BERenderSystem renderSystem{
             beDevice,
-            beRenderer.getSwapChainRenderPass(),
-            globalSetLayout->getDescriptorSetLayout()
+            beRenderer.getSwapChainRenderTarget(),
+            globalSetLayout->getDescriptorSetLayout(),
+            beRenderer.hasObjectIdAttachment()
         };
 
         // initialise the point light render system
         BEPointLightSystem pointLightRenderSystem{
             beDevice,
-            beRenderer.getSwapChainRenderPass(),
-            globalSetLayout->getDescriptorSetLayout()
+            beRenderer.getSwapChainRenderTarget(),
+            globalSetLayout->getDescriptorSetLayout(),
+            beRenderer.hasObjectIdAttachment()
         };
 
+        BETransformSystem transformSystem{};
+        BEBoundsSystem boundsSystem{};
+
         BECamera camera{};
 
-        auto viewerObject = BEGameObject::createGameObject();
+        // the viewer isn't part of the scene, so it is kept out of the registry
+        TransformComponent viewerTransform{};
         BEKeyboardMovementController cameraController{};
 
-        EditorInput::BEMouseInputHandler mouseInputHandler{beWindow, camera, viewerObject, gameObjects};
+        EditorInput::BEMouseInputHandler mouseInputHandler{
+            beWindow,
+            beRenderer,
+            camera,
+            viewerTransform,
+            registry,
+            boundsSystem
+        };
+
+        // recording and submitting move to their own thread, the main thread keeps polling glfw
+        // and simulating so the next frame is built while the last one is being drawn
+        std::thread renderThread{[&]()
+        {
+            try
+            {
+                renderLoop(renderSystem, pointLightRenderSystem, uboBuffers, globalDescriptorSets);
+            }
+            catch (...)
+            {
+                renderThreadError = std::current_exception();
+                renderThreadFailed.store(true, std::memory_order_release);
+                notifySnapshotWaiters();
+                // the game loop may be asleep in glfw
+                glfwPostEmptyEvent();
+            }
+        }};
+
+        bool presentModeKeyDown = false;
+
+        // set once a snapshot turned out the same as the last one drawn, the loop then sleeps until something happens
+        bool idle = false;
+        uint64_t drawnSnapshotHash = 0;
 
         auto currentTime = std::chrono::high_resolution_clock::now();
 
-        while (!beWindow.shouldClose())
+        try
+        {
+            while (!beWindow.shouldClose() && !renderThreadFailed.load(std::memory_order_acquire))
+            {
+                // stay at most one snapshot ahead of the render thread, waiting here rather than before
+                // publishing keeps the input and simulation in the snapshot as fresh as possible
+                {
+                    std::unique_lock<std::mutex> lock{snapshotMutex};
+                    snapshotCondition.wait(lock, [this]()
+                    {
+                        return !snapshots.hasPending() || renderThreadFailed.load(std::memory_order_acquire);
+                    });
+                }
+
+                if (idle)
+                {
+                    // nothing changed since the last frame, sleep until an event or requestRedraw wakes us. models
+                    // still streaming in can't post an event so they're checked on now and then
+                    if (assetManager.getPendingCount() > 0)
+                    {
+                        glfwWaitEventsTimeout(STREAMING_POLL_SECONDS);
+                    }
+                    else
+                    {
+                        glfwWaitEvents();
+                    }
+
+                    // the time asleep isn't simulated and isn't a late frame
+                    framePacer.restart();
+                    currentTime = std::chrono::high_resolution_clock::now();
+                }
+                else
+                {
+                    // sleep off whatever is left of the frame before sampling input, so it's as fresh as it can be
+                    framePacer.waitForNextFrame();
+
+                    // this function call may block, therefore we call it before our delta time calculations
+                    glfwPollEvents();
+                }
+                auto inputTime = std::chrono::steady_clock::now();
+
+                bool presentModeKey = glfwGetKey(beWindow.getGLFWwindow(), GLFW_KEY_P) == GLFW_PRESS;
+                if (presentModeKey && !presentModeKeyDown)
+                {
+                    switchPresentMode();
+                    redrawRequested.store(true, std::memory_order_relaxed);
+                }
+                presentModeKeyDown = presentModeKey;
+
+                // nothing is drawn while the window is minimized, sleep until it is restored
+                VkExtent2D extent = beWindow.getExtent();
+                if (extent.width == 0 || extent.height == 0)
+                {
+                    glfwWaitEvents();
+                    currentTime = std::chrono::high_resolution_clock::now();
+                    continue;
+                }
+
+                // move any models finished loading in the background onto the gpu
+                assetManager.update();
+
+                // report picks whose ids were read back from an earlier frame
+                mouseInputHandler.update();
+
+                auto newTime = std::chrono::high_resolution_clock::now();
+                // our delta time
+                float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+
+                // store the current time value for the next iteration of the loop
+                currentTime = newTime;
+
+                // handle user input here for the time being until we make a more complete and dynamic implementation
+                cameraController.moveInPlaneXZ(beWindow.getGLFWwindow(), frameTime, viewerTransform);
+                camera.setViewYXZ(viewerTransform.translation, viewerTransform.rotation);
+
+                // get the aspect ratio directly from the renderer, so as we resize the viewport
+                // our render remains correctly drawn
+                float aspect = beRenderer.getAspectRatio();
+                camera.setPerspectiveProjection(glm::radians(50.f), aspect, .1f, 100.f);
+
+                // published ahead of the snapshot, so a frame can only latch a camera as new as its own or newer
+                if (settings.lateLatch)
+                {
+                    LatchedCamera& latched = latchedCameras.back();
+                    latched.projection = camera.getProjection();
+                    latched.view = camera.getView();
+                    latched.inputTime = inputTime;
+                    latchedCameras.publish();
+                }
+
+                // refresh the cached matrices of anything that moved before the renderer reads them
+                transformSystem.update(registry);
+                boundsSystem.update(registry, transformSystem.getMovedEntities());
+
+                buildSnapshot(snapshots.back(), camera, frameTime);
+
+                // skip the frame when it would draw what is already on screen. held movement keys count as a change
+                // even when the first frame after waking moved the camera by nothing, a resize until the render
+                // thread has rebuilt the swap chain once it settled and a pick until its copy has been recorded
+                uint64_t snapshotHash = snapshots.back().hashContents();
+                bool redraw = !settings.renderOnDemand
+                    || redrawRequested.exchange(false, std::memory_order_acq_rel)
+                    || beWindow.consumeRefreshRequest()
+                    || snapshotHash != drawnSnapshotHash
+                    || cameraController.isMoving(beWindow.getGLFWwindow())
+                    || beWindow.getFrameBufferResized()
+                    || beRenderer.isResizePending()
+                    || beRenderer.isObjectIdRequested();
+                idle = !redraw;
+                if (idle) continue;
+
+                drawnSnapshotHash = snapshotHash;
+                snapshots.back().inputTime = inputTime;
+                snapshots.publish();
+                notifySnapshotWaiters();
+
+                // TODO:
+                // begin offscreen shadow pass
+                // render shadow casting objects
+                // end offscreen shadow pass
+            }
+        }
+        catch (...)
+        {
+            // the render thread has to be joined before it goes out of scope
+            stopRenderThread(renderThread);
+            throw;
+        }
+
+        stopRenderThread(renderThread);
+
+        vkDeviceWaitIdle(beDevice.device());
+
+        // where the cpu and the gpu ended up waiting on each other
+        BEFrameTimeline::Stats frameStats = beDevice.frameTimeline().getStats();
+        std::cout << "frames submitted: " << frameStats.submittedFrames
+            << ", cpu stalled on the gpu " << frameStats.cpuStalls << " times for "
+            << frameStats.cpuStallSeconds * 1000.0 << "ms"
+            << ", gpu starved on " << frameStats.gpuStarvedFrames << " frames\n";
+        reportLatency();
+
+        // the depth attachments depend on whether the device offers lazily allocated memory
+        constexpr double MIB = 1024.0 * 1024.0;
+        BESwapChain::AttachmentMemoryUsage attachments = beRenderer.getAttachmentMemoryUsage();
+        std::cout << "attachment memory: " << attachments.depthImages
+            << (attachments.lazilyAllocatedDepth ? " lazily allocated" : " shared") << " depth images, "
+            << attachments.depthCommittedBytes / MIB << " of " << attachments.depthBytes / MIB << "MiB committed";
+        if (attachments.objectIdBytes > 0)
+        {
+            std::cout << ", object ids " << attachments.objectIdBytes / MIB << "MiB";
+        }
+        std::cout << '\n';
+
+        if (framePacer.getTargetFrameRate() > 0.0)
+        {
+            BEFramePacer::Stats pacing = framePacer.getStats();
+            std::cout << "paced to " << framePacer.getTargetFrameRate() << "fps: "
+                << pacing.averageIntervalSeconds * 1000.0 << "ms per frame, "
+                << pacing.jitterSeconds * 1000.0 << "ms jitter, "
+                << pacing.worstLateSeconds * 1000.0 << "ms latest start\n";
+        }
+
+        if (renderThreadError)
+        {
+            std::rethrow_exception(renderThreadError);
+        }
+    }
+
+    void App::requestRedraw()
+    {
+        redrawRequested.store(true, std::memory_order_release);
+        glfwPostEmptyEvent();
+    }
+
+    void App::switchPresentMode()
+    {
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        switch (beRenderer.getRequestedPresentMode())
+        {
+        case VK_PRESENT_MODE_FIFO_KHR:
+            presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            break;
+        default:
+            presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        }
+
+        // unsupported modes fall back to fifo when the swap chain is recreated
+        std::cout << "Switching present mode to " << BESwapChain::presentModeName(presentMode) << "\n";
+        beRenderer.setPresentMode(presentMode);
+    }
+
+    void App::notifySnapshotWaiters()
+    {
+        // taking the lock orders the change being signalled before a waiter's check of it
+        {
+            std::lock_guard<std::mutex> lock{snapshotMutex};
+        }
+        snapshotCondition.notify_all();
+    }
+
+    void App::stopRenderThread(std::thread& renderThread)
+    {
+        stopRendering.store(true, std::memory_order_release);
+        notifySnapshotWaiters();
+        renderThread.join();
+    }
+
+    void App::buildSnapshot(RenderSnapshot& snapshot, const BECamera& camera, float frameTime)
+    {
+        snapshot.clear();
+        snapshot.projection = camera.getProjection();
+        snapshot.view = camera.getView();
+        snapshot.frameTime = frameTime;
+
+        auto renderables = registry.view<WorldTransformComponent, ModelComponent>();
+        renderables.each([&snapshot](Entity entity, WorldTransformComponent& world, ModelComponent& modelComponent)
+        {
+            // models still streaming in are skipped until their upload has finished
+            if (modelComponent.model == nullptr || !modelComponent.model->isReady()) return;
+            snapshot.draws.push_back({modelComponent.model, world.matrix, world.normalMatrix, entity});
+        });
+
+        auto& lights = registry.pool<PointLightComponent>();
+        for (Entity light : lights.entities())
+        {
+            const ColorComponent* color = registry.tryGet<ColorComponent>(light);
+            RenderSnapshot::PointLight pointLight{};
+            pointLight.position = glm::vec3{registry.get<WorldTransformComponent>(light).matrix[3]};
+            pointLight.color = color ? color->color : glm::vec3(1.f);
+            pointLight.intensity = lights.get(light).lightIntensity;
+            snapshot.pointLights.push_back(pointLight);
+        }
+    }
+
+    void App::renderLoop(
+        BERenderSystem& renderSystem,
+        BEPointLightSystem& pointLightRenderSystem,
+        std::vector<std::unique_ptr<BEBuffer>>& uboBuffers,
+        const std::vector<VkDescriptorSet>& globalDescriptorSets)
+    {
+        // the commands only reference the uniform buffer, so the camera in it can change until submission
+        struct CameraLatch
         {
-            // this function call may block, therefore we call it before our delta time calculations
-            glfwPollEvents();
+            App* app;
+            std::vector<std::unique_ptr<BEBuffer>>* uboBuffers;
+        };
+        CameraLatch cameraLatch{this, &uboBuffers};
+        if (settings.lateLatch)
+        {
+            beRenderer.setLateLatch([](void* context, int frameIndex)
+            {
+                auto latch = static_cast<CameraLatch*>(context);
+                latch->app->latchCamera(*(*latch->uboBuffers)[frameIndex]);
+            }, &cameraLatch);
+        }
 
-            auto newTime = std::chrono::high_resolution_clock::now();
-            // our delta time
-            float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+        uint32_t renderTargetVersion = beRenderer.getRenderTargetVersion();
 
-            // store the current time value for the next iteration of the loop
-            currentTime = newTime;
+        while (!stopRendering.load(std::memory_order_acquire))
+        {
+            measureLatency();
 
-            // handle user input here for the time being until we make a more complete and dynamic implementation
-            cameraController.moveInPlaneXZ(beWindow.getGLFWwindow(), frameTime, viewerObject);
-            camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+            // finish picks even when no frame follows the one that read them back, and wake the game
+            // loop to report them in case it's sleeping through an idle scene
+            beRenderer.collectCompletedFrames();
+            if (beRenderer.hasPickedObject())
+            {
+                glfwPostEmptyEvent();
+            }
 
-            // get the aspect ratio directly from the renderer, so as we resize the viewport
-            // our render remains correctly drawn
-            float aspect = beRenderer.getAspectRatio();
-            camera.setPerspectiveProjection(glm::radians(50.f), aspect, .1f, 100.f);
+            // sleep until the game thread publishes the next snapshot, waking up now and then while there
+            // are frames whose latency still has to be timed or picks still have to be read back
+            bool acquired;
+            {
+                auto ready = [this]()
+                {
+                    return stopRendering.load(std::memory_order_acquire) || snapshots.acquire();
+                };
+                std::unique_lock<std::mutex> lock{snapshotMutex};
+                if (pendingLatency.empty())
+                {
+                    snapshotCondition.wait(lock, ready);
+                    acquired = true;
+                }
+                else
+                {
+                    acquired = snapshotCondition.wait_for(lock, std::chrono::milliseconds(1), ready);
+                }
+            }
+            if (!acquired || stopRendering.load(std::memory_order_acquire)) continue;
+
+            // the game thread may be waiting for this snapshot to be taken
+            notifySnapshotWaiters();
+            const RenderSnapshot& snapshot = snapshots.front();
 
             if (auto commandBuffer = beRenderer.beginFrame())
             {
+                // the swap chain only changes its render target when the surface format changes, with dynamic
+                // rendering the pipelines only ever depend on the formats
+                if (beRenderer.getRenderTargetVersion() != renderTargetVersion)
+                {
+                    renderTargetVersion = beRenderer.getRenderTargetVersion();
+                    renderSystem.setRenderTarget(beRenderer.getSwapChainRenderTarget());
+                    pointLightRenderSystem.setRenderTarget(beRenderer.getSwapChainRenderTarget());
+                }
+
                 int frameIndex = beRenderer.getFrameIndex();
                 FrameInfo frameInfo{
                     frameIndex,
-                    frameTime,
+                    snapshot.frameTime,
                     commandBuffer,
-                    camera,
                     globalDescriptorSets[frameIndex],
-                    gameObjects
+                    snapshot
                 };
 
                 // update
                 GlobalUbo ubo{};
-                ubo.projection = camera.getProjection();
-                ubo.view = camera.getView();
+                ubo.projection = snapshot.projection;
+                ubo.view = snapshot.view;
+
+                // the shaders take a single light for now, use the first one in the scene
+                if (!snapshot.pointLights.empty())
+                {
+                    const RenderSnapshot::PointLight& light = snapshot.pointLights.front();
+                    ubo.lightPosition = light.position;
+                    ubo.lightColor = glm::vec4(light.color, light.intensity);
+                }
                 uboBuffers[frameIndex]->writeToBuffer(&ubo);
                 uboBuffers[frameIndex]->flush();
+                frameInputTime = snapshot.inputTime;
 
                 // render
                 beRenderer.beginSwapChainRenderPass(commandBuffer);
@@ -139,35 +503,113 @@ namespace bucketengine
                 beRenderer.endSwapChainRenderPass(commandBuffer);
                 beRenderer.endFrame();
 
-                // TODO:
-                // begin offscreen shadow pass
-                // render shadow casting objects
-                // end offscreen shadow pass
+                pendingLatency.push_back({beDevice.frameTimeline().getSubmittedFrame(), frameInputTime, snapshot.inputTime});
             }
         }
 
-        vkDeviceWaitIdle(beDevice.device());
+        beRenderer.setLateLatch(nullptr, nullptr);
     }
 
-    void App::loadGameObjects()
+    void App::latchCamera(BEBuffer& uboBuffer)
     {
-        std::shared_ptr<BEModel> beModel = BEModel::createModelFromFile(beDevice, "models/smooth_vase.obj");
+        if (latchedCameras.acquire())
+        {
+            hasLatchedCamera = true;
+        }
+        if (!hasLatchedCamera) return;
 
-        auto cube = BEGameObject::createGameObject();
-        cube.model = beModel;
-        cube.transform.translation = {0.f, .5f, 2.f};
-        cube.transform.scale = {3.f, 3.f, 3.f};
+        static_assert(
+            offsetof(GlobalUbo, view) == offsetof(GlobalUbo, projection) + sizeof(glm::mat4),
+            "The camera matrices are latched with one write"
+        );
+        const LatchedCamera& latched = latchedCameras.front();
+        glm::mat4 matrices[2] = {latched.projection, latched.view};
+        uboBuffer.writeToBuffer(matrices, sizeof(matrices), offsetof(GlobalUbo, projection));
+        uboBuffer.flush();
 
-        gameObjects.emplace(cube.getId(), std::move(cube));
+        latchedFrames++;
+        latchGainSecondsTotal += std::chrono::duration<double>(latched.inputTime - frameInputTime).count();
+        frameInputTime = latched.inputTime;
+    }
 
-        // create a quad to represent the floor
-        std::shared_ptr<BEModel> floorModel = BEModel::createModelFromFile(beDevice, "models/quad.obj");
-        
-        auto floor = BEGameObject::createGameObject();
-        floor.model = floorModel;
-        floor.transform.translation = {.0f, .5f, .0f};
-        floor.transform.scale = {3.f, 1.f, 3.f};
+    void App::measureLatency()
+    {
+        if (pendingLatency.empty()) return;
 
-        gameObjects.emplace(floor.getId(), std::move(floor));
+        // presents and finished frames are only noticed here, so the numbers run late by up to one pass of the
+        // render loop, which wakes every millisecond while frames are pending
+        if (beRenderer.supportsPresentWait())
+        {
+            while (!pendingLatency.empty())
+            {
+                const LatencySample& sample = pendingLatency.front();
+                // a zero timeout only polls, blocking here would hold back the next frame
+                bool shown = beRenderer.waitForPresent(sample.frame, 0);
+                auto now = std::chrono::steady_clock::now();
+                double seconds = std::chrono::duration<double>(now - sample.inputTime).count();
+                if (!shown)
+                {
+                    if (seconds < MAX_PRESENT_LATENCY_SECONDS) break;
+                    unpresentedFrames++;
+                } else
+                {
+                    recordLatency(seconds, std::chrono::duration<double>(now - sample.snapshotInputTime).count());
+                }
+                pendingLatency.pop_front();
+            }
+            return;
+        }
+
+        uint64_t completedFrame = beDevice.frameTimeline().getCompletedFrame();
+        auto now = std::chrono::steady_clock::now();
+        while (!pendingLatency.empty() && pendingLatency.front().frame <= completedFrame)
+        {
+            const LatencySample& sample = pendingLatency.front();
+            recordLatency(
+                std::chrono::duration<double>(now - sample.inputTime).count(),
+                std::chrono::duration<double>(now - sample.snapshotInputTime).count()
+            );
+            pendingLatency.pop_front();
+        }
+    }
+
+    void App::recordLatency(double seconds, double snapshotSeconds)
+    {
+        latencyFrames++;
+        latencySecondsTotal += seconds;
+        snapshotLatencySecondsTotal += snapshotSeconds;
+        latencySecondsMax = std::max(latencySecondsMax, seconds);
+    }
+
+    void App::reportLatency() const
+    {
+        std::cout << "latency mode " << latencyModeName(settings.latencyMode)
+            << " (" << beRenderer.getFramesInFlight() << " frames in flight, "
+            << BESwapChain::presentModeName(beRenderer.getPresentMode()) << "): ";
+        if (latencyFrames == 0)
+        {
+            std::cout << "no frames finished\n";
+            return;
+        }
+        // without present wait the display's part of the latency can't be seen, only the gpu's
+        std::cout << (beRenderer.supportsPresentWait() ? "input to present " : "input to gpu finished (no present wait) ")
+            << latencySecondsTotal / latencyFrames * 1000.0 << "ms on average, "
+            << latencySecondsMax * 1000.0 << "ms at worst over " << latencyFrames << " frames\n";
+        if (unpresentedFrames > 0)
+        {
+            std::cout << unpresentedFrames << " frames were never reported shown and left out\n";
+        }
+        if (latchedFrames > 0)
+        {
+            // the same frames timed from their snapshots' input are what they would have measured unlatched
+            std::cout << "late latching sampled the camera " << latchGainSecondsTotal / latchedFrames * 1000.0
+                << "ms after its snapshot on average, " << snapshotLatencySecondsTotal / latencyFrames * 1000.0
+                << "ms on average from the snapshot's input without it\n";
+        }
+    }
+
+    void App::loadGameObjects()
+    {
+        BEScene::load(DEFAULT_SCENE_PATH, assetManager, registry);
     }
 }
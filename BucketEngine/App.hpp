@@ -1,11 +1,20 @@
 ﻿#pragma once
 
 #include "BEWindow.hpp"
-#include "game/BEGameObject.hpp"
+#include "game/BEComponents.hpp"
+#include "ecs/BERegistry.hpp"
 #include "BEDevice.hpp"
 #include "renderer/BERenderer.hpp"
 #include "BEModel.hpp"
 #include "descriptors/BEDescriptors.hpp"
+#include "assets/BEAssetManager.hpp"
+#include "renderer/BERenderSnapshot.hpp"
+#include "renderer/systems/BERenderSystem.hpp"
+#include "renderer/systems/BEPointLightSystem.hpp"
+#include "buffers/BEBuffer.hpp"
+#include "camera/BECamera.hpp"
+#include "utils/BETripleBuffer.hpp"
+#include "utils/BEFramePacer.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -14,34 +23,142 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 namespace bucketengine
 {
+    struct AppSettings
+    {
+        LatencyMode latencyMode = LatencyMode::Balanced;
+        // frames per second the game loop is held to, zero leaves it unlimited
+        double targetFrameRate = 0.0;
+        // keep at most one frame queued for the display where the device supports present wait
+        bool presentWait = false;
+        // only draw when something on screen changed, the game loop sleeps in glfw the rest of the time
+        bool renderOnDemand = true;
+        // write the newest camera into the frame's uniform buffer right before it is submitted, rather than
+        // the camera of the snapshot it was recorded from
+        bool lateLatch = true;
+        // draw straight to the swap chain's image views with VK_KHR_dynamic_rendering where the device
+        // supports it, the pipelines are then built against attachment formats rather than a render pass
+        bool dynamicRendering = false;
+        // pick objects by reading back an object id attachment rather than raycasting on the cpu
+        bool gpuPicking = false;
+    };
+
     class App
     {
     public:
         static constexpr int WIDTH = 800;
         static constexpr int HEIGHT = 600;
+        static constexpr const char* ASSET_ARCHIVE_PATH = "assets.bepk";
+        static constexpr const char* DEFAULT_SCENE_PATH = "scenes/default.bescene";
+        // how often an idle game loop checks on models still streaming in
+        static constexpr double STREAMING_POLL_SECONDS = 0.01;
+        // a frame not reported shown by then went to a swap chain that was replaced and never will be
+        static constexpr double MAX_PRESENT_LATENCY_SECONDS = 0.5;
         
-        App();
+        explicit App(const AppSettings& settings = {});
         ~App();
 
         App(const App &) = delete;
         App &operator=(const App &) = delete;
 
         void run();
+
+        // safe to call from any thread, draws another frame even if nothing the app tracks has changed
+        void requestRedraw();
     private:
         void loadGameObjects();
+        // copies what the renderer needs out of the registry, run on the game thread
+        void buildSnapshot(RenderSnapshot& snapshot, const BECamera& camera, float frameTime);
+        // draws every snapshot the game thread publishes until stopRendering is set
+        void renderLoop(
+            BERenderSystem& renderSystem,
+            BEPointLightSystem& pointLightRenderSystem,
+            std::vector<std::unique_ptr<BEBuffer>>& uboBuffers,
+            const std::vector<VkDescriptorSet>& globalDescriptorSets
+        );
+        // cycles through the present modes on a key press, run on the game thread
+        void switchPresentMode();
+        // wakes whichever thread is waiting on the other to publish or take a snapshot
+        void notifySnapshotWaiters();
+        void stopRenderThread(std::thread& renderThread);
+
+        // render thread only, run right before a frame is submitted. overwrites the camera in the frame's
+        // uniform buffer with the newest one the game thread has published
+        void latchCamera(BEBuffer& uboBuffer);
+
+        // render thread only, times the frames shown since the last call, or the frames the gpu has finished
+        // where the device can't wait for presents
+        void measureLatency();
+        // seconds from the frame's input and from its snapshot's input to it being shown
+        void recordLatency(double seconds, double snapshotSeconds);
+        void reportLatency() const;
+
+        // input to present latency of submitted frames, touched only by the render thread
+        struct LatencySample
+        {
+            uint64_t frame;
+            std::chrono::steady_clock::time_point inputTime;
+            // the input the frame's snapshot was built from, what inputTime would be without late latching
+            std::chrono::steady_clock::time_point snapshotInputTime;
+        };
+        std::deque<LatencySample> pendingLatency;
+        uint64_t latencyFrames = 0;
+        double latencySecondsTotal = 0.0;
+        double latencySecondsMax = 0.0;
+        double snapshotLatencySecondsTotal = 0.0;
+        // frames never reported shown, presented to a swap chain that has since been replaced
+        uint64_t unpresentedFrames = 0;
+        // input time of the frame being recorded, moved forward when its camera is latched
+        std::chrono::steady_clock::time_point frameInputTime{};
+        // how much newer the latched cameras were than their snapshots
+        uint64_t latchedFrames = 0;
+        double latchGainSecondsTotal = 0.0;
+
+        // published by the game thread every time it moves the camera, independently of the snapshots
+        struct LatchedCamera
+        {
+            glm::mat4 projection{1.f};
+            glm::mat4 view{1.f};
+            std::chrono::steady_clock::time_point inputTime{};
+        };
+        BETripleBuffer<LatchedCamera> latchedCameras;
+        // render thread only, front() holds a published camera
+        bool hasLatchedCamera = false;
 
         BEWindow beWindow{WIDTH, HEIGHT, "Bucket Engine"};
         BEDevice beDevice{beWindow};
-        BERenderer beRenderer{beWindow, beDevice};
+        AppSettings settings;
+        BERenderer beRenderer;
 
         std::unique_ptr<BEDescriptorPool> globalPool{};
+
+        // declared before the registry so the models its entities reference outlive them
+        BEAssetManager assetManager{beDevice};
         
-        BEGameObject::Map gameObjects;
+        BERegistry registry;
+
+        // the game thread fills the next snapshot while the render thread draws the last one
+        BETripleBuffer<RenderSnapshot> snapshots;
+        // sleeps the game loop down to the target frame rate, the render thread follows the snapshots it makes
+        BEFramePacer framePacer;
+        // the game and render threads sleep here rather than spin while waiting on each other
+        std::mutex snapshotMutex;
+        std::condition_variable snapshotCondition;
+        std::atomic<bool> stopRendering{false};
+        std::atomic<bool> redrawRequested{false};
+        std::atomic<bool> renderThreadFailed{false};
+        std::exception_ptr renderThreadError;
     };
     
 }
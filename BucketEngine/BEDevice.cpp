@@ -1,6 +1,7 @@
 #include "BEDevice.hpp"
 
 // std headers
+#include <cassert>
 #include <cstring>
 #include <iostream>
 #include <set>
@@ -68,10 +69,20 @@ namespace bucketengine
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPool();
+        frameTimeline_ = std::make_unique<BEFrameTimeline>(*this, timelineSemaphoreSupported);
+        std::cout << "frame sync: " << (frameTimeline_->usesTimelineSemaphore() ? "timeline semaphore" : "fences")
+            << (presentWaitSupported ? ", present wait" : "")
+            << (dynamicRenderingSupported ? ", dynamic rendering" : "")
+            << (lazilyAllocatedMemorySupported ? ", lazily allocated memory" : "") << std::endl;
     }
 
     BEDevice::~BEDevice()
     {
+        // everything still waiting on a frame has to go before the device does
+        vkDeviceWaitIdle(device_);
+        deletionQueue_.flush();
+        frameTimeline_.reset();
+
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -97,7 +108,8 @@ namespace bucketengine
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // 1.1 for vkGetPhysicalDeviceFeatures2, which tells whether optional extensions' features are there
+        appInfo.apiVersion = VK_API_VERSION_1_1;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -158,6 +170,18 @@ namespace bucketengine
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
         std::cout << "physical device: " << properties.deviceName << std::endl;
+
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        const VkMemoryPropertyFlags lazyProperties =
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        {
+            if ((memProperties.memoryTypes[i].propertyFlags & lazyProperties) == lazyProperties)
+            {
+                lazilyAllocatedMemorySupported = true;
+            }
+        }
     }
 
     void BEDevice::createLogicalDevice()
@@ -188,8 +212,78 @@ namespace bucketengine
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+        // optional features are prepended to this chain as they're enabled
+        std::vector<const char*> extensions = deviceExtensions;
+        void* featureChain = nullptr;
+
+        // frames are tracked on a timeline semaphore where the device has one, with fences otherwise
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
+        timelineSemaphoreSupported = isDeviceExtensionSupported(physicalDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+        if (timelineSemaphoreSupported)
+        {
+            extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+            timelineFeatures.pNext = featureChain;
+            featureChain = &timelineFeatures;
+        }
+
+        // present ids and waiting on them let the frame pacer line frames up with the display, unlike the
+        // timeline semaphore the extensions don't guarantee their features so those are queried as well
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        if (properties.apiVersion >= VK_API_VERSION_1_1 &&
+            isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+        {
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            VkPhysicalDeviceFeatures2 features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &presentIdFeatures;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+            presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+        }
+        if (presentWaitSupported)
+        {
+            extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            presentWaitFeatures.pNext = featureChain;
+            featureChain = &presentIdFeatures;
+        }
+
+        // dynamic rendering needs depth stencil resolve, which needs create render pass 2, the rest of what
+        // they depend on is core in vulkan 1.1
+        VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+        dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+        if (properties.apiVersion >= VK_API_VERSION_1_1 &&
+            isDeviceExtensionSupported(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+            isDeviceExtensionSupported(physicalDevice, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) &&
+            isDeviceExtensionSupported(physicalDevice, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME))
+        {
+            VkPhysicalDeviceFeatures2 features{};
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &dynamicRenderingFeatures;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+            dynamicRenderingSupported = dynamicRenderingFeatures.dynamicRendering;
+        }
+        if (dynamicRenderingSupported)
+        {
+            extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+            extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+            dynamicRenderingFeatures.pNext = featureChain;
+            featureChain = &dynamicRenderingFeatures;
+        }
+
+        createInfo.pNext = featureChain;
+
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -210,6 +304,40 @@ namespace bucketengine
 
         vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
         vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+        if (presentWaitSupported)
+        {
+            waitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+                vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+            presentWaitSupported = waitForPresentKHR != nullptr;
+        }
+
+        if (dynamicRenderingSupported)
+        {
+            cmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR"));
+            cmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(
+                vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR"));
+            dynamicRenderingSupported = cmdBeginRenderingKHR != nullptr && cmdEndRenderingKHR != nullptr;
+        }
+    }
+
+    VkResult BEDevice::waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout)
+    {
+        assert(presentWaitSupported && "The device doesn't support waiting for presents");
+        return waitForPresentKHR(device_, swapChain, presentId, timeout);
+    }
+
+    void BEDevice::cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo)
+    {
+        assert(dynamicRenderingSupported && "The device doesn't support dynamic rendering");
+        cmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+    }
+
+    void BEDevice::cmdEndRendering(VkCommandBuffer commandBuffer)
+    {
+        assert(dynamicRenderingSupported && "The device doesn't support dynamic rendering");
+        cmdEndRenderingKHR(commandBuffer);
     }
 
     void BEDevice::createCommandPool()
@@ -372,6 +500,28 @@ namespace bucketengine
         return requiredExtensions.empty();
     }
 
+    bool BEDevice::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(
+            device,
+            nullptr,
+            &extensionCount,
+            availableExtensions.data());
+
+        for (const auto& extension : availableExtensions)
+        {
+            if (std::strcmp(extension.extensionName, extensionName) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
     QueueFamilyIndices BEDevice::findQueueFamilies(VkPhysicalDevice device)
     {
         QueueFamilyIndices indices;
@@ -539,8 +689,11 @@ namespace bucketengine
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &commandBuffer;
 
-        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphicsQueue_);
+        {
+            std::lock_guard<std::mutex> lock{queueMutex_};
+            vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
+            vkQueueWaitIdle(graphicsQueue_);
+        }
 
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
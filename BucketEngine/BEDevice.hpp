@@ -2,8 +2,12 @@
 
 // #include "my_engine_window.hpp"
 #include "BEWindow.hpp"
+#include "BEFrameTimeline.hpp"
+#include "utils/BEDeletionQueue.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -48,6 +52,27 @@ namespace bucketengine
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
+        // queues need external synchronisation, hold this around every submit and present since
+        // the render thread, the asset streamer and one off uploads all share them
+        std::mutex& queueMutex() { return queueMutex_; }
+        // resources that command buffers may still reference are handed here instead of being destroyed
+        BEDeletionQueue& deletionQueue() { return deletionQueue_; }
+        // the numbers of the frames the renderer has submitted and finished
+        BEFrameTimeline& frameTimeline() { return *frameTimeline_; }
+
+        // VK_KHR_present_id and VK_KHR_present_wait, the swap chain tags presents with their frame number
+        bool supportsPresentWait() const { return presentWaitSupported; }
+        // blocks until the present tagged with presentId, or a later one, has been shown
+        VkResult waitForPresent(VkSwapchainKHR swapChain, uint64_t presentId, uint64_t timeout);
+
+        // VK_KHR_dynamic_rendering, rendering straight into image views without render pass or framebuffer objects
+        bool supportsDynamicRendering() const { return dynamicRenderingSupported; }
+        void cmdBeginRendering(VkCommandBuffer commandBuffer, const VkRenderingInfoKHR& renderingInfo);
+        void cmdEndRendering(VkCommandBuffer commandBuffer);
+
+        // a device local memory type that is only backed as the device needs it, found on tiling gpus where
+        // transient attachments can live in on chip memory for the whole pass
+        bool supportsLazilyAllocatedMemory() const { return lazilyAllocatedMemorySupported; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
         uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -92,6 +117,7 @@ namespace bucketengine
         void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
         void hasGflwRequiredInstanceExtensions();
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+        bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
@@ -104,6 +130,16 @@ namespace bucketengine
         VkSurfaceKHR surface_;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
+        std::mutex queueMutex_;
+        BEDeletionQueue deletionQueue_{*this};
+        std::unique_ptr<BEFrameTimeline> frameTimeline_;
+        bool timelineSemaphoreSupported = false;
+        bool presentWaitSupported = false;
+        PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
+        bool dynamicRenderingSupported = false;
+        PFN_vkCmdBeginRenderingKHR cmdBeginRenderingKHR = nullptr;
+        PFN_vkCmdEndRenderingKHR cmdEndRenderingKHR = nullptr;
+        bool lazilyAllocatedMemorySupported = false;
 
         const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
         const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
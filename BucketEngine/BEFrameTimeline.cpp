@@ -0,0 +1,210 @@
+﻿#include "BEFrameTimeline.hpp"
+
+#include "BEDevice.hpp"
+
+// std
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace bucketengine
+{
+    BEFrameTimeline::BEFrameTimeline(BEDevice& device, bool useTimelineSemaphore) : beDevice{device}
+    {
+        if (useTimelineSemaphore)
+        {
+            // the semaphore functions come from the extension, the instance targets vulkan 1.0
+            waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+                vkGetDeviceProcAddr(device.device(), "vkWaitSemaphoresKHR"));
+            getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+                vkGetDeviceProcAddr(device.device(), "vkGetSemaphoreCounterValueKHR"));
+        }
+
+        if (waitSemaphores != nullptr && getSemaphoreCounterValue != nullptr)
+        {
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+
+            if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create frame timeline semaphore");
+            }
+            return;
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (VkFence& fence : fences)
+        {
+            if (vkCreateFence(device.device(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create frame fences");
+            }
+        }
+    }
+
+    BEFrameTimeline::~BEFrameTimeline()
+    {
+        if (timelineSemaphore != VK_NULL_HANDLE)
+        {
+            vkDestroySemaphore(beDevice.device(), timelineSemaphore, nullptr);
+        }
+
+        for (VkFence fence : fences)
+        {
+            if (fence != VK_NULL_HANDLE)
+            {
+                vkDestroyFence(beDevice.device(), fence, nullptr);
+            }
+        }
+    }
+
+    uint64_t BEFrameTimeline::getCompletedFrame()
+    {
+        if (usesTimelineSemaphore())
+        {
+            uint64_t value = 0;
+            if (getSemaphoreCounterValue(beDevice.device(), timelineSemaphore, &value) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to read the frame timeline");
+            }
+            advanceCompletedFrame(value);
+            return completedFrame.load(std::memory_order_acquire);
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        uint64_t submitted = getSubmittedFrame();
+        for (uint64_t frame = completedFrame.load(std::memory_order_relaxed) + 1; frame <= submitted; frame++)
+        {
+            // a slot that has moved on to a later frame was waited on before it was reused
+            uint32_t slot = frame % FENCE_COUNT;
+            if (fenceFrames[slot] == frame && vkGetFenceStatus(beDevice.device(), fences[slot]) != VK_SUCCESS)
+            {
+                break;
+            }
+            advanceCompletedFrame(frame);
+        }
+        return completedFrame.load(std::memory_order_acquire);
+    }
+
+    void BEFrameTimeline::waitForFrame(uint64_t frame)
+    {
+        if (completedFrame.load(std::memory_order_acquire) >= frame) return;
+        assert(frame <= getSubmittedFrame() && "Can't wait for a frame that hasn't been submitted");
+        if (getCompletedFrame() >= frame) return;
+
+        if (usesTimelineSemaphore())
+        {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timelineSemaphore;
+            waitInfo.pValues = &frame;
+
+            auto start = std::chrono::steady_clock::now();
+            if (waitSemaphores(beDevice.device(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to wait for the frame timeline");
+            }
+            recordStall(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            advanceCompletedFrame(frame);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        uint32_t slot = frame % FENCE_COUNT;
+        if (fenceFrames[slot] == frame)
+        {
+            waitForFence(slot);
+        }
+        advanceCompletedFrame(frame);
+    }
+
+    VkFence BEFrameTimeline::beginSubmit(uint64_t& frame)
+    {
+        frame = getSubmittedFrame() + 1;
+
+        // nothing left running on the gpu means it has been waiting for this submit
+        if (frame > 1 && getCompletedFrame() >= frame - 1)
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stats.gpuStarvedFrames++;
+        }
+
+        if (usesTimelineSemaphore()) return VK_NULL_HANDLE;
+
+        std::lock_guard<std::mutex> lock{mutex};
+        uint32_t slot = frame % FENCE_COUNT;
+        if (fenceFrames[slot] > completedFrame.load(std::memory_order_relaxed))
+        {
+            waitForFence(slot);
+        }
+        advanceCompletedFrame(fenceFrames[slot]);
+
+        if (vkResetFences(beDevice.device(), 1, &fences[slot]) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to reset frame fence");
+        }
+        fenceFrames[slot] = frame;
+        return fences[slot];
+    }
+
+    void BEFrameTimeline::endSubmit(uint64_t frame)
+    {
+        assert(frame == getSubmittedFrame() + 1 && "Frames have to be submitted in order");
+        submittedFrame.store(frame, std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock{mutex};
+        stats.submittedFrames++;
+    }
+
+    void BEFrameTimeline::markIdle()
+    {
+        advanceCompletedFrame(getSubmittedFrame());
+    }
+
+    BEFrameTimeline::Stats BEFrameTimeline::getStats() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return stats;
+    }
+
+    void BEFrameTimeline::advanceCompletedFrame(uint64_t frame)
+    {
+        uint64_t completed = completedFrame.load(std::memory_order_relaxed);
+        while (completed < frame &&
+            !completedFrame.compare_exchange_weak(completed, frame, std::memory_order_acq_rel))
+        {
+        }
+    }
+
+    void BEFrameTimeline::waitForFence(uint32_t slot)
+    {
+        if (vkGetFenceStatus(beDevice.device(), fences[slot]) == VK_SUCCESS) return;
+
+        auto start = std::chrono::steady_clock::now();
+        if (vkWaitForFences(beDevice.device(), 1, &fences[slot], VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to wait for frame fence");
+        }
+
+        // the mutex is already held, so update the stats directly
+        stats.cpuStalls++;
+        stats.cpuStallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void BEFrameTimeline::recordStall(double seconds)
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stats.cpuStalls++;
+        stats.cpuStallSeconds += seconds;
+    }
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace bucketengine
+{
+    class BEDevice;
+
+    // numbers the frames the renderer submits from one upwards and tracks which of them the gpu has finished.
+    // with VK_KHR_timeline_semaphore every frame signals its number on a single timeline semaphore, so any
+    // thread can wait for an exact frame. without it each frame signals one of a ring of fences instead
+    class BEFrameTimeline
+    {
+    public:
+        // more fences than frames are ever kept in flight, so reusing one doesn't have to wait
+        static constexpr uint32_t FENCE_COUNT = 8;
+
+        struct Stats
+        {
+            uint64_t submittedFrames = 0;
+            // waits that found their frame unfinished and blocked the calling thread on the gpu
+            uint64_t cpuStalls = 0;
+            double cpuStallSeconds = 0.0;
+            // frames submitted after every earlier frame had finished, the gpu sat idle waiting on the cpu
+            uint64_t gpuStarvedFrames = 0;
+        };
+
+        BEFrameTimeline(BEDevice& device, bool useTimelineSemaphore);
+        ~BEFrameTimeline();
+
+        BEFrameTimeline(const BEFrameTimeline&) = delete;
+        BEFrameTimeline& operator=(const BEFrameTimeline&) = delete;
+
+        bool usesTimelineSemaphore() const { return timelineSemaphore != VK_NULL_HANDLE; }
+        // null without timeline semaphore support
+        VkSemaphore getSemaphore() const { return timelineSemaphore; }
+
+        // the newest frame submitted, zero before the first one
+        uint64_t getSubmittedFrame() const { return submittedFrame.load(std::memory_order_acquire); }
+        // asks the gpu for the newest frame it has finished, every frame before it has finished as well
+        uint64_t getCompletedFrame();
+        // blocks until the frame has finished on the gpu, safe to call from any thread
+        void waitForFrame(uint64_t frame);
+
+        /**
+         * Starts submitting the next frame. Only one thread may submit frames.
+         *
+         * @param frame Receives the number of the frame, with a timeline semaphore the submit has to signal it
+         *
+         * @return The fence to submit the frame with, null when the timeline semaphore is used
+         */
+        VkFence beginSubmit(uint64_t& frame);
+        // call once the frame started with beginSubmit has been submitted to the queue
+        void endSubmit(uint64_t frame);
+
+        // everything submitted is known to have finished, such as after vkDeviceWaitIdle
+        void markIdle();
+
+        Stats getStats() const;
+
+    private:
+        void advanceCompletedFrame(uint64_t frame);
+        // waits on the fence in the given ring slot, the mutex has to be held
+        void waitForFence(uint32_t slot);
+        void recordStall(double seconds);
+
+        BEDevice& beDevice;
+
+        VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+        PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+
+        std::atomic<uint64_t> submittedFrame{0};
+        // the newest completed frame seen so far, the gpu may be further along
+        std::atomic<uint64_t> completedFrame{0};
+
+        // guards the fence ring and the stats
+        mutable std::mutex mutex;
+        // only used without the timeline semaphore, fences[frame % FENCE_COUNT] is signalled by that frame
+        std::array<VkFence, FENCE_COUNT> fences{};
+        std::array<uint64_t, FENCE_COUNT> fenceFrames{};
+        Stats stats{};
+    };
+}
@@ -1,32 +1,117 @@
 ﻿#include "BEModel.hpp"
 
+#include "assets/BEFileSystem.hpp"
 #include "utils/BEUtils.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
-
 // std
 #include <cassert>
-#include <unordered_map>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <streambuf>
 
-namespace std
+namespace bucketengine
 {
-    template <>
-    struct hash<bucketengine::BEModel::Vertex>
+    namespace
     {
-        size_t operator()(bucketengine::BEModel::Vertex const &vertex) const {
-            size_t seed = 0;
-            bucketengine::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-            return seed;
-        }
-    };
-}
+        // read only stream over bytes already in memory, lets tinyobj parse an archive entry in place
+        class MemoryStreamBuffer : public std::streambuf
+        {
+        public:
+            MemoryStreamBuffer(const char* data, size_t size)
+            {
+                char* begin = const_cast<char*>(data);
+                setg(begin, begin, begin + size);
+            }
+        };
+
+        /**
+         * Open addressing table used to deduplicate vertices while loading a model.
+         *
+         * Slots only hold a 32bit hash tag and an index into the builder's vertex array, so the
+         * table is one flat allocation and a lookup touches a single cache line in the common case.
+         * Vertices are hashed and compared as raw bytes, which means -0.0 and 0.0 are treated as
+         * different vertices, that only costs a duplicate vertex and never produces a wrong one.
+         */
+        class VertexDedupTable
+        {
+        public:
+            explicit VertexDedupTable(size_t expectedCount)
+            {
+                size_t capacity = 16;
+                // keep the load factor under 3/4 for the expected number of entries
+                while (capacity * 3 < expectedCount * 4)
+                {
+                    capacity <<= 1;
+                }
+                slots.assign(capacity, Slot{});
+                mask = capacity - 1;
+            }
+
+            // returns the index of an identical vertex, appending the vertex first if it's new
+            uint32_t findOrInsert(const BEModel::Vertex& vertex, std::vector<BEModel::Vertex>& vertices)
+            {
+                const uint32_t tag = static_cast<uint32_t>(hashBytes(&vertex, sizeof(vertex)));
+
+                size_t slot = tag & mask;
+                while (slots[slot].index != EMPTY)
+                {
+                    if (slots[slot].tag == tag
+                        && std::memcmp(&vertices[slots[slot].index], &vertex, sizeof(vertex)) == 0)
+                    {
+                        return slots[slot].index;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+
+                const uint32_t index = static_cast<uint32_t>(vertices.size());
+                slots[slot] = {tag, index};
+                vertices.push_back(vertex);
+
+                if (++count * 4 > slots.size() * 3)
+                {
+                    grow();
+                }
+                return index;
+            }
+
+        private:
+            static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+            struct Slot
+            {
+                uint32_t tag = 0;
+                uint32_t index = EMPTY;
+            };
+
+            void grow()
+            {
+                std::vector<Slot> oldSlots = std::move(slots);
+                slots.assign(oldSlots.size() * 2, Slot{});
+                mask = slots.size() - 1;
+
+                // the tag is the low bits of the full hash so we can re-slot without rehashing vertices
+                for (const auto& oldSlot : oldSlots)
+                {
+                    if (oldSlot.index == EMPTY) continue;
+                    size_t slot = oldSlot.tag & mask;
+                    while (slots[slot].index != EMPTY)
+                    {
+                        slot = (slot + 1) & mask;
+                    }
+                    slots[slot] = oldSlot;
+                }
+            }
+
+            std::vector<Slot> slots;
+            size_t mask = 0;
+            size_t count = 0;
+        };
+    }
 
-namespace bucketengine
-{
     std::vector<VkVertexInputBindingDescription> BEModel::Vertex::getBindingDescriptions()
     {
         std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
@@ -51,21 +136,60 @@ namespace bucketengine
     
     BEModel::BEModel(BEDevice &device, const Builder &builder) : beDevice{device}
     {
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
+        // both copies go into a single submission instead of waiting on the queue twice
+        VkCommandBuffer commandBuffer = beDevice.beginSingleTimeCommands();
+        auto stagingBuffers = recordUpload(builder, commandBuffer);
+        beDevice.endSingleTimeCommands(commandBuffer);
+
+        markReady();
     }
 
+    BEModel::BEModel(BEDevice &device) : beDevice{device}
+    {}
+
     BEModel::~BEModel()
     {}
 
-    std::unique_ptr<BEModel> BEModel::createModelFromFile(BEDevice& device, const std::string& filePath)
+    std::unique_ptr<BEModel> BEModel::createModelFromFile(
+        BEDevice& device,
+        const std::string& filePath,
+        const ImportSettings& settings
+    )
     {
         Builder builder{};
-        builder.loadModel(filePath);
+        builder.loadModel(filePath, settings);
 
         return std::make_unique<BEModel>(device, builder);
     }
 
+    VkDeviceSize BEModel::getMemorySize() const
+    {
+        if (!vertexBuffer) return 0;
+
+        VkDeviceSize size = vertexBuffer->getBufferSize();
+        if (hasIndexBuffer)
+        {
+            size += indexBuffer->getBufferSize();
+        }
+        return size;
+    }
+
+    std::vector<std::unique_ptr<BEBuffer>> BEModel::recordUpload(const Builder &builder, VkCommandBuffer commandBuffer)
+    {
+        assert(!isReady() && "Cannot upload geometry to a model that is already in use");
+
+        bounds = builder.computeBounds();
+        rayBVH = builder.rayBVH;
+
+        std::vector<std::unique_ptr<BEBuffer>> stagingBuffers{};
+        stagingBuffers.push_back(createVertexBuffers(builder.vertices, commandBuffer));
+        if (auto indexStagingBuffer = createIndexBuffers(builder.indices, commandBuffer))
+        {
+            stagingBuffers.push_back(std::move(indexStagingBuffer));
+        }
+        return stagingBuffers;
+    }
+
     void BEModel::bind(VkCommandBuffer commandBuffer)
     {
         VkBuffer buffers[] = {vertexBuffer->getBuffer()};
@@ -94,7 +218,10 @@ namespace bucketengine
         }
     }
 
-    void BEModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+    std::unique_ptr<BEBuffer> BEModel::createVertexBuffers(
+        const std::vector<Vertex>& vertices,
+        VkCommandBuffer commandBuffer
+    )
     {
         vertexCount = static_cast<uint32_t>(vertices.size());
         
@@ -103,16 +230,16 @@ namespace bucketengine
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
         uint32_t vertexSize = sizeof(vertices[0]);
 
-        BEBuffer stagingBuffer{
+        auto stagingBuffer = std::make_unique<BEBuffer>(
             beDevice,
             vertexSize,
             vertexCount,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        );
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)vertices.data());
+        stagingBuffer->map();
+        stagingBuffer->writeToBuffer((void *)vertices.data());
 
         vertexBuffer = std::make_unique<BEBuffer>(
             beDevice,
@@ -122,30 +249,37 @@ namespace bucketengine
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        beDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+        VkBufferCopy copyRegion{};
+        copyRegion.size = bufferSize;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer->getBuffer(), vertexBuffer->getBuffer(), 1, &copyRegion);
+
+        return stagingBuffer;
     }
 
-    void BEModel::createIndexBuffers(const std::vector<uint32_t> &indices)
+    std::unique_ptr<BEBuffer> BEModel::createIndexBuffers(
+        const std::vector<uint32_t> &indices,
+        VkCommandBuffer commandBuffer
+    )
     {
         indexCount = static_cast<uint32_t>(indices.size());
         hasIndexBuffer = indexCount > 0;
 
-        if (!hasIndexBuffer) return;
+        if (!hasIndexBuffer) return nullptr;
 
         VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
 
         uint32_t indexSize = sizeof(indices[0]);
 
-        BEBuffer stagingBuffer{
+        auto stagingBuffer = std::make_unique<BEBuffer>(
             beDevice,
             indexSize,
             indexCount,
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        };
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        );
 
-        stagingBuffer.map();
-        stagingBuffer.writeToBuffer((void *)indices.data());
+        stagingBuffer->map();
+        stagingBuffer->writeToBuffer((void *)indices.data());
 
         indexBuffer = std::make_unique<BEBuffer>(
             beDevice,
@@ -155,26 +289,52 @@ namespace bucketengine
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
         );
 
-        beDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+        VkBufferCopy copyRegion{};
+        copyRegion.size = bufferSize;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer->getBuffer(), indexBuffer->getBuffer(), 1, &copyRegion);
+
+        return stagingBuffer;
     }
 
-    void BEModel::Builder::loadModel(const std::string& filePath)
+    void BEModel::Builder::loadModel(const std::string& filePath, const ImportSettings& settings)
     {
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.c_str()))
+        BEFileData file = BEFileSystem::readFile(filePath);
+        MemoryStreamBuffer streamBuffer{file.data(), file.size()};
+        std::istream stream{&streamBuffer};
+
+        // materials aren't used by the renderer, so no material reader is given and mtllib is skipped
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream))
         {
-            throw std::runtime_error(warn + err);
+            throw std::runtime_error("Failed to load " + filePath + ": " + warn + err);
         }
 
         vertices.clear();
         indices.clear();
+        rayBVH.reset();
+
+        size_t indexCount = 0;
+        for (const auto &shape : shapes)
+        {
+            indexCount += shape.mesh.indices.size();
+        }
+
+        if (settings.deduplicateVertices)
+        {
+            indices.reserve(indexCount);
+        }
+        else
+        {
+            vertices.reserve(indexCount);
+        }
+
+        // every index could in theory be a unique vertex, sizing the table up front means it never rehashes
+        VertexDedupTable uniqueVertices{settings.deduplicateVertices ? indexCount : 0};
 
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-        
         for (const auto &shape : shapes)
         {
             for (const auto &index : shape.mesh.indices)
@@ -210,13 +370,56 @@ namespace bucketengine
                     };
                 }
 
-                if (uniqueVertices.count(vertex) == 0)
+                if (settings.deduplicateVertices)
+                {
+                    indices.push_back(uniqueVertices.findOrInsert(vertex, vertices));
+                }
+                else
                 {
-                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
                     vertices.push_back(vertex);
                 }
-                indices.push_back(uniqueVertices[vertex]);
             }
         }
+
+        // loadModel runs on the streaming thread, so the build cost never lands on a frame
+        if (settings.buildRayBVH)
+        {
+            buildRayBVH();
+        }
+    }
+
+    void BEModel::Builder::deduplicate(const std::vector<Vertex>& corners)
+    {
+        assert(&corners != &vertices && "Cannot deduplicate a builder's own vertices in place");
+        vertices.clear();
+        indices.clear();
+        rayBVH.reset();
+        indices.reserve(corners.size());
+
+        VertexDedupTable uniqueVertices{corners.size()};
+        for (const auto& vertex : corners)
+        {
+            indices.push_back(uniqueVertices.findOrInsert(vertex, vertices));
+        }
+    }
+
+    AABB BEModel::Builder::computeBounds() const
+    {
+        AABB result{};
+        for (const auto& vertex : vertices)
+        {
+            result.expand(vertex.position);
+        }
+        return result;
+    }
+
+    void BEModel::Builder::buildRayBVH()
+    {
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].position;
+        }
+        rayBVH = std::make_shared<const BEMeshBVH>(positions, indices);
     }
 }
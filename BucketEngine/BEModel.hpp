@@ -2,6 +2,8 @@
 
 #include "BEDevice.hpp"
 #include "buffers/BEBuffer.hpp"
+#include "utils/BEBounds.hpp"
+#include "scene/BEMeshBVH.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -9,6 +11,7 @@
 #include <glm/glm.hpp>
 
 // std
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -36,40 +39,100 @@ namespace bucketengine
             }
         };
 
+        // options that change the geometry produced from a source file, models loaded with
+        // different settings are different assets
+        struct ImportSettings
+        {
+            // user provided so it can be used as a default argument inside BEModel
+            ImportSettings() {}
+
+            // merge identical vertices and draw through an index buffer
+            bool deduplicateVertices = true;
+            // build a triangle bvh so ray queries can hit the exact surface instead of the bounds
+            bool buildRayBVH = false;
+
+            bool operator==(const ImportSettings& other) const
+            {
+                return deduplicateVertices == other.deduplicateVertices && buildRayBVH == other.buildRayBVH;
+            }
+        };
+
         struct Builder
         {
             std::vector<Vertex> vertices{};
             std::vector<uint32_t> indices{};
+            // only set when the import settings asked for one
+            std::shared_ptr<const BEMeshBVH> rayBVH{};
 
-            void loadModel(const std::string &filePath);
+            void loadModel(const std::string &filePath, const ImportSettings &settings = {});
+            // replaces the geometry with the unique vertices of a triangle list that has one vertex
+            // per corner and indices into them, the same merge loadModel does with deduplicateVertices
+            void deduplicate(const std::vector<Vertex> &corners);
+            AABB computeBounds() const;
+            void buildRayBVH();
         };
 
         BEModel(BEDevice &device, const Builder &builder);
+        // creates an empty model whose geometry is uploaded later with recordUpload,
+        // it isn't drawable until markReady has been called
+        explicit BEModel(BEDevice &device);
         ~BEModel();
 
         BEModel(const BEModel &) = delete;
         BEModel &operator=(const BEModel &) = delete;
 
-        static std::unique_ptr<BEModel> createModelFromFile(BEDevice &device, const std::string &filePath);
+        static std::unique_ptr<BEModel> createModelFromFile(
+            BEDevice &device,
+            const std::string &filePath,
+            const ImportSettings &settings = {}
+        );
+
+        // the amount of device memory held by this model's vertex and index buffers
+        VkDeviceSize getMemorySize() const;
+        // model space bounds of the vertices, only valid once the geometry has been uploaded
+        const AABB& getBounds() const { return bounds; }
+        // triangle bvh in model space, null unless the model was imported with buildRayBVH
+        const BEMeshBVH* getRayBVH() const { return rayBVH.get(); }
+
+        // records the copies from staging memory into this model's device local buffers.
+        // the returned staging buffers must be kept alive until the command buffer has finished executing
+        std::vector<std::unique_ptr<BEBuffer>> recordUpload(const Builder &builder, VkCommandBuffer commandBuffer);
+        // call once the upload recorded by recordUpload has completed on the gpu
+        void markReady() { ready.store(true, std::memory_order_release); }
+        bool isReady() const { return ready.load(std::memory_order_acquire); }
+        // set instead of ready when a streamed model's file couldn't be loaded, the model stays empty for good
+        void markFailed() { failed.store(true, std::memory_order_release); }
+        bool hasFailed() const { return failed.load(std::memory_order_acquire); }
         
         void bind(VkCommandBuffer commandBuffer);
         void draw(VkCommandBuffer commandBuffer);
 
     private:
-        void createVertexBuffers(const std::vector<Vertex> &vertices);
-        void createIndexBuffers(const std::vector<uint32_t> &indices);
+        std::unique_ptr<BEBuffer> createVertexBuffers(
+            const std::vector<Vertex> &vertices,
+            VkCommandBuffer commandBuffer
+        );
+        std::unique_ptr<BEBuffer> createIndexBuffers(
+            const std::vector<uint32_t> &indices,
+            VkCommandBuffer commandBuffer
+        );
 
         BEDevice& beDevice;
 
         std::unique_ptr<BEBuffer> vertexBuffer;
         // VkBuffer vertexBuffer;
         // VkDeviceMemory vertexBufferMemory;
-        uint32_t vertexCount;
+        uint32_t vertexCount = 0;
 
         bool hasIndexBuffer = false;
         std::unique_ptr<BEBuffer> indexBuffer;
         // VkBuffer indexBuffer;
         // VkDeviceMemory indexBufferMemory;
-        uint32_t indexCount;
+        uint32_t indexCount = 0;
+
+        AABB bounds{};
+        std::shared_ptr<const BEMeshBVH> rayBVH{};
+        std::atomic<bool> ready{false};
+        std::atomic<bool> failed{false};
     };
 }
@@ -1,6 +1,7 @@
 ﻿#include "BEPipeline.hpp"
 
-#include <fstream>
+#include "assets/BEFileSystem.hpp"
+
 #include <iostream>
 #include <stdexcept>
 #include <cassert>
@@ -19,9 +20,10 @@ namespace bucketengine
 
     BEPipeline::~BEPipeline()
     {
-        vkDestroyShaderModule(beDevice.device(), vertShaderModule, nullptr);
-        vkDestroyShaderModule(beDevice.device(), fragShaderModule, nullptr);
-        vkDestroyPipeline(beDevice.device(), graphicsPipeline, nullptr);
+        BEDeletionQueue& deletionQueue = beDevice.deletionQueue();
+        deletionQueue.retireShaderModule(vertShaderModule);
+        deletionQueue.retireShaderModule(fragShaderModule);
+        deletionQueue.retirePipeline(graphicsPipeline);
     }
 
     void BEPipeline::bind(VkCommandBuffer commandBuffer)
@@ -80,21 +82,21 @@ namespace bucketengine
         // color blending controls how we control colors in our frame buffer
         // if we have overlapping colors, our fragment shader will return multiple colors for some pixel
         // here we can enable and configure color blending and it's methods
-        configInfo.colorBlendAttachment.colorWriteMask =
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask =
             VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        configInfo.colorBlendAttachment.blendEnable = VK_FALSE;
-        configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-        configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-        configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-        configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-        configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-        configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        configInfo.colorBlendAttachments = {colorBlendAttachment};
 
         configInfo.colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
         configInfo.colorBlendInfo.logicOpEnable = VK_FALSE;
         configInfo.colorBlendInfo.logicOp = VK_LOGIC_OP_COPY;
-        configInfo.colorBlendInfo.attachmentCount = 1;
-        configInfo.colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
         configInfo.colorBlendInfo.blendConstants[0] = 0.0f;
         configInfo.colorBlendInfo.blendConstants[1] = 0.0f;
         configInfo.colorBlendInfo.blendConstants[2] = 0.0f;
@@ -125,24 +127,21 @@ namespace bucketengine
         configInfo.attributeDescriptions = BEModel::Vertex::getAttributeDescriptions();
     }
 
-    std::vector<char> BEPipeline::readFile(const std::string& filepath)
+    void BEPipeline::addObjectIdAttachment(PipelineConfigInfo& configInfo, bool writeIds)
     {
-        std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-        if (!file.is_open())
-        {
-            throw std::runtime_error("failed to open file: " + filepath);
-        }
-
-        size_t fileSize = static_cast<size_t>(file.tellg());
-
-        std::vector<char> buffer(fileSize);
-
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+        // integer attachments can't be blended, the id is either written as is or not at all
+        VkPipelineColorBlendAttachmentState objectIdAttachment{};
+        objectIdAttachment.colorWriteMask = writeIds ? VK_COLOR_COMPONENT_R_BIT : 0;
+        objectIdAttachment.blendEnable = VK_FALSE;
+        configInfo.colorBlendAttachments.push_back(objectIdAttachment);
+    }
 
-        file.close();
-        return buffer;
+    void BEPipeline::setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget)
+    {
+        configInfo.renderPass = renderTarget.renderPass;
+        configInfo.subpass = 0;
+        configInfo.colorAttachmentFormats = renderTarget.colorFormats;
+        configInfo.depthAttachmentFormat = renderTarget.depthFormat;
     }
 
     void BEPipeline::createGraphicsPipeline(const std::string vertFilePath, const std::string fragFilePath,
@@ -151,11 +150,16 @@ namespace bucketengine
         assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
             "Cannot create graphics pipeline: no pipeline provided in configInfo"
         );
-        assert(configInfo.renderPass != VK_NULL_HANDLE &&
-            "Cannot create graphics pipeline: no renderPass provided in configInfo"
+        assert((configInfo.renderPass != VK_NULL_HANDLE || !configInfo.colorAttachmentFormats.empty()) &&
+            "Cannot create graphics pipeline: no renderPass or attachment formats provided in configInfo"
         );
-        auto vertCode = readFile(vertFilePath);
-        auto fragCode = readFile(fragFilePath);
+        assert((configInfo.renderPass != VK_NULL_HANDLE ||
+            configInfo.colorAttachmentFormats.size() == configInfo.colorBlendAttachments.size()) &&
+            "Cannot create graphics pipeline: every colour attachment needs a format and a blend state"
+        );
+        // shaders come from a mounted asset archive when there is one, otherwise from disk
+        BEFileData vertCode = BEFileSystem::readFile(vertFilePath);
+        BEFileData fragCode = BEFileSystem::readFile(fragFilePath);
 
         // std::cout << "Vertex shader code size: " << vertCode.size() << "\n";
         // std::cout << "Fragment shader code size: " << fragCode.size() << "\n";
@@ -191,6 +195,10 @@ namespace bucketengine
         vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
         vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 
+        VkPipelineColorBlendStateCreateInfo colorBlendInfo = configInfo.colorBlendInfo;
+        colorBlendInfo.attachmentCount = static_cast<uint32_t>(configInfo.colorBlendAttachments.size());
+        colorBlendInfo.pAttachments = configInfo.colorBlendAttachments.data();
+
         VkGraphicsPipelineCreateInfo pipelineInfo{};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineInfo.stageCount = 2;
@@ -200,7 +208,7 @@ namespace bucketengine
         pipelineInfo.pViewportState = &configInfo.viewportInfo;
         pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
         pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-        pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+        pipelineInfo.pColorBlendState = &colorBlendInfo;
         pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
         pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
@@ -208,6 +216,19 @@ namespace bucketengine
         pipelineInfo.renderPass = configInfo.renderPass;
         pipelineInfo.subpass = configInfo.subpass;
 
+        // without a render pass the formats are all the pipeline knows about its attachments
+        VkPipelineRenderingCreateInfoKHR renderingInfo{};
+        if (configInfo.renderPass == VK_NULL_HANDLE)
+        {
+            renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+            renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+            renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+            renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+            renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+            pipelineInfo.pNext = &renderingInfo;
+            pipelineInfo.subpass = 0;
+        }
+
         pipelineInfo.basePipelineIndex = -1;
         pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
@@ -218,7 +239,7 @@ namespace bucketengine
         }
     }
 
-    void BEPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
+    void BEPipeline::createShaderModule(const BEFileData& code, VkShaderModule* shaderModule)
     {
         VkShaderModuleCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
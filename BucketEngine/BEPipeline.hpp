@@ -2,6 +2,7 @@
 
 #include "BEDevice.hpp"
 #include "BEModel.hpp"
+#include "assets/BEFileSystem.hpp"
 
 // std
 #include <string>
@@ -9,6 +10,15 @@
 
 namespace bucketengine
 {
+    // what pipelines draw into. with a render pass they are built against it, without one (dynamic rendering)
+    // they only declare the attachment formats and can draw into any images of those formats
+    struct RenderTargetInfo
+    {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        std::vector<VkFormat> colorFormats{};
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    };
+
     struct PipelineConfigInfo
     {
         PipelineConfigInfo(const PipelineConfigInfo&) = delete;
@@ -23,7 +33,8 @@ namespace bucketengine
         VkPipelineRasterizationStateCreateInfo rasterizationInfo;
         VkPipelineMultisampleStateCreateInfo multisampleInfo;
 
-        VkPipelineColorBlendAttachmentState colorBlendAttachment;
+        // one entry per colour attachment of the subpass, the blend info is pointed at them when the pipeline is built
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments{};
         VkPipelineColorBlendStateCreateInfo colorBlendInfo;
         VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 
@@ -33,6 +44,10 @@ namespace bucketengine
         VkPipelineLayout pipelineLayout = nullptr;
         VkRenderPass renderPass = nullptr;
         uint32_t subpass = 0;
+
+        // dynamic rendering, used when there is no render pass. one format per colour blend attachment
+        std::vector<VkFormat> colorAttachmentFormats{};
+        VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
     };
 
     class BEPipeline
@@ -51,17 +66,25 @@ namespace bucketengine
 
         void bind(VkCommandBuffer commandBuffer);
         static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+        /**
+         * Adds the blend state for the swap chain's object id attachment, pipelines in a render pass
+         * created with one must describe it even when they don't write ids.
+         *
+         * @param configInfo The config to add the attachment to, after defaultPipelineConfigInfo
+         * @param writeIds false masks out all writes, so the pipeline leaves the ids underneath it untouched
+         */
+        static void addObjectIdAttachment(PipelineConfigInfo& configInfo, bool writeIds);
+        // points the config at a render pass or, for dynamic rendering, the attachment formats
+        static void setRenderTarget(PipelineConfigInfo& configInfo, const RenderTargetInfo& renderTarget);
 
     private:
-        static std::vector<char> readFile(const std::string& filepath);
-
         void createGraphicsPipeline(
             const std::string vertFilePath,
             const std::string fragFilePath,
             const PipelineConfigInfo& configInfo
         );
 
-        void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+        void createShaderModule(const BEFileData& code, VkShaderModule* shaderModule);
 
         BEDevice& beDevice;
         VkPipeline graphicsPipeline;
@@ -1,7 +1,9 @@
 #include "BESwapChain.hpp"
 
 // std
+#include <algorithm>
 #include <array>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,19 +13,51 @@
 
 namespace bucketengine
 {
-    BESwapChain::BESwapChain(BEDevice& deviceRef, VkExtent2D extent)
-        : device{deviceRef}, windowExtent{extent}
+    SwapChainSettings SwapChainSettings::forLatencyMode(LatencyMode mode, bool objectIdAttachment)
     {
-        init();
+        SwapChainSettings settings{};
+        settings.objectIdAttachment = objectIdAttachment;
+
+        switch (mode)
+        {
+        case LatencyMode::Low:
+            // the cpu waits for every frame before starting the next, so input is sampled as late as
+            // possible, and mailbox always shows the newest image without tearing
+            settings.framesInFlight = 1;
+            settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case LatencyMode::Balanced:
+            settings.framesInFlight = 2;
+            settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            break;
+        case LatencyMode::Throughput:
+            // keep the gpu fed, every rendered frame is shown in order
+            settings.framesInFlight = 3;
+            settings.imageCount = 4;
+            settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            break;
+        }
+        return settings;
     }
 
-    BESwapChain::BESwapChain(BEDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<BESwapChain> previous)
-        : device{deviceRef}, windowExtent{windowExtent}, oldSwapChain{previous}
+    const char* latencyModeName(LatencyMode mode)
     {
-        init();
+        switch (mode)
+        {
+        case LatencyMode::Low:
+            return "low";
+        case LatencyMode::Balanced:
+            return "balanced";
+        case LatencyMode::Throughput:
+            return "throughput";
+        }
+        return "unknown";
+    }
 
-        // clean up the old swap chain
-        oldSwapChain = nullptr;
+    BESwapChain::BESwapChain(BEDevice& deviceRef, VkExtent2D extent, const SwapChainSettings& settings)
+        : device{deviceRef}, attachmentMemory{deviceRef}, windowExtent{extent}, settings{settings}
+    {
+        init();
     }
 
     BESwapChain::~BESwapChain()
@@ -40,11 +74,17 @@ namespace bucketengine
             swapChain = nullptr;
         }
 
+        // the pool frees the attachments' memory when it goes
         for (int i = 0; i < depthImages.size(); i++)
         {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
+        }
+
+        for (size_t i = 0; i < objectIdImages.size(); i++)
+        {
+            vkDestroyImageView(device.device(), objectIdImageViews[i], nullptr);
+            vkDestroyImage(device.device(), objectIdImages[i], nullptr);
         }
 
         for (auto framebuffer : swapChainFramebuffers)
@@ -52,25 +92,29 @@ namespace bucketengine
             vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
         }
 
-        vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        if (renderPass != VK_NULL_HANDLE)
+        {
+            vkDestroyRenderPass(device.device(), renderPass, nullptr);
+        }
 
         // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < imageAvailableSemaphores.size(); i++)
         {
             vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device.device(), inFlightFences[i], nullptr);
         }
     }
 
     VkResult BESwapChain::acquireNextImage(uint32_t* imageIndex)
     {
-        vkWaitForFences(
-            device.device(),
-            1,
-            &inFlightFences[currentFrame],
-            VK_TRUE,
-            std::numeric_limits<uint64_t>::max());
+        // this frame's semaphores were last used framesInFlight frames ago, that frame has to have
+        // finished before they can be used again
+        BEFrameTimeline& timeline = device.frameTimeline();
+        uint64_t nextFrame = timeline.getSubmittedFrame() + 1;
+        if (nextFrame > settings.framesInFlight)
+        {
+            timeline.waitForFrame(nextFrame - settings.framesInFlight);
+        }
 
         VkResult result = vkAcquireNextImageKHR(
             device.device(),
@@ -84,13 +128,19 @@ namespace bucketengine
     }
 
     VkResult BESwapChain::submitCommandBuffers(
-        const VkCommandBuffer* buffers, uint32_t* imageIndex)
+        const VkCommandBuffer* buffers,
+        uint32_t* imageIndex,
+        void (*beforeSubmit)(void* context),
+        void* context)
     {
-        if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-        {
-            vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-        }
-        imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
+        // images can be acquired out of order, the last frame drawn to this one has to have finished.
+        // it usually has by now, in which case this is only a comparison against the timeline
+        BEFrameTimeline& timeline = device.frameTimeline();
+        timeline.waitForFrame(imageFrames[*imageIndex]);
+
+        uint64_t frame;
+        VkFence fence = timeline.beginSubmit(frame);
+        imageFrames[*imageIndex] = frame;
 
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -104,16 +154,34 @@ namespace bucketengine
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+        // the frame's number is signalled on the timeline next to the binary semaphore presentation waits on,
+        // the value for the binary semaphore is ignored
+        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame], timeline.getSemaphore()};
+        uint64_t signalValues[] = {0, frame};
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
-        vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
-            VK_SUCCESS)
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+        if (timeline.usesTimelineSemaphore())
+        {
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+            timelineInfo.signalSemaphoreValueCount = 2;
+            timelineInfo.pSignalSemaphoreValues = signalValues;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.signalSemaphoreCount = 2;
+        }
+
+        if (beforeSubmit)
+        {
+            beforeSubmit(context);
+        }
+
+        std::lock_guard<std::mutex> lock{device.queueMutex()};
+        if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS)
         {
             throw std::runtime_error("failed to submit draw command buffer!");
         }
+        timeline.endSubmit(frame);
 
         VkPresentInfoKHR presentInfo = {};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -127,32 +195,187 @@ namespace bucketengine
 
         presentInfo.pImageIndices = imageIndex;
 
+        // presents are tagged with their frame number, which only ever grows as present ids have to
+        VkPresentIdKHR presentId{};
+        if (device.supportsPresentWait())
+        {
+            presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+            presentId.swapchainCount = 1;
+            presentId.pPresentIds = &frame;
+            presentInfo.pNext = &presentId;
+
+            if (firstPresentedFrame == 0)
+            {
+                firstPresentedFrame = frame;
+            }
+        }
+
         auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % settings.framesInFlight;
 
         return result;
     }
 
+    bool BESwapChain::waitForPresent(uint64_t frame, uint64_t timeout)
+    {
+        // frames before the first one presented here went to an older swap chain
+        if (!device.supportsPresentWait() || firstPresentedFrame == 0 || frame < firstPresentedFrame)
+        {
+            return false;
+        }
+
+        VkResult result = device.waitForPresent(swapChain, frame, timeout);
+        if (result == VK_ERROR_DEVICE_LOST)
+        {
+            throw std::runtime_error("Device lost while waiting for a present");
+        }
+        // timeouts and out of date swap chains are left to the next acquire to deal with
+        return result == VK_SUCCESS;
+    }
+
     void BESwapChain::init()
     {
-        createSwapChain();
+        assert(settings.framesInFlight >= 1 && settings.framesInFlight <= MAX_FRAMES_IN_FLIGHT &&
+            "Frames in flight out of range");
+        dynamicRendering = settings.dynamicRendering && device.supportsDynamicRendering();
+        lazilyAllocatedDepth = device.supportsLazilyAllocatedMemory();
+
+        createSwapChain(VK_NULL_HANDLE);
         createImageViews();
         createRenderPass();
         createDepthResources();
+        createObjectIdResources();
         createFramebuffers();
         createSyncObjects();
     }
 
-    void BESwapChain::createSwapChain()
+    RenderTargetInfo BESwapChain::getRenderTarget() const
+    {
+        RenderTargetInfo renderTarget{};
+        renderTarget.renderPass = renderPass;
+        if (dynamicRendering)
+        {
+            renderTarget.colorFormats.push_back(swapChainImageFormat);
+            if (settings.objectIdAttachment)
+            {
+                renderTarget.colorFormats.push_back(OBJECT_ID_FORMAT);
+            }
+            renderTarget.depthFormat = swapChainDepthFormat;
+        }
+        return renderTarget;
+    }
+
+    BESwapChain::AttachmentMemoryUsage BESwapChain::getAttachmentMemoryUsage() const
+    {
+        AttachmentMemoryUsage usage{};
+        usage.lazilyAllocatedDepth = lazilyAllocatedDepth;
+        usage.depthImages = static_cast<uint32_t>(depthImages.size());
+        usage.depthBytes = depthImageBytes * depthImages.size();
+        usage.depthCommittedBytes = usage.depthBytes;
+        if (lazilyAllocatedDepth)
+        {
+            // the whole pooled block is committed to lazily, headroom included
+            usage.depthCommittedBytes = 0;
+            for (VkDeviceMemory memory : depthImageMemorys)
+            {
+                VkDeviceSize committedBytes = 0;
+                vkGetDeviceMemoryCommitment(device.device(), memory, &committedBytes);
+                usage.depthCommittedBytes += committedBytes;
+            }
+        }
+        usage.objectIdBytes = objectIdImageBytes * objectIdImages.size();
+        return usage;
+    }
+
+    void BESwapChain::recreate(VkExtent2D extent, const SwapChainSettings& newSettings)
+    {
+        assert(newSettings.framesInFlight == settings.framesInFlight &&
+            newSettings.objectIdAttachment == settings.objectIdAttachment &&
+            newSettings.dynamicRendering == settings.dynamicRendering &&
+            "Frames in flight, the object id attachment and dynamic rendering are fixed for the swap chain's lifetime");
+
+        windowExtent = extent;
+        settings = newSettings;
+
+        retireImageResources();
+
+        // the old swap chain's images that are still queued for presentation are shown before it goes, it is
+        // destroyed once the frames that drew to it have finished
+        VkSwapchainKHR oldSwapChain = swapChain;
+        VkFormat oldImageFormat = swapChainImageFormat;
+        createSwapChain(oldSwapChain);
+        device.deletionQueue().retireSwapchain(oldSwapChain);
+
+        createImageViews();
+        // pipelines depend on the image format either way, through the render pass or the formats they declare
+        if (swapChainImageFormat != oldImageFormat)
+        {
+            if (renderPass != VK_NULL_HANDLE)
+            {
+                device.deletionQueue().retireRenderPass(renderPass);
+            }
+            createRenderPass();
+            renderTargetVersion++;
+        }
+        createDepthResources();
+        createObjectIdResources();
+        createFramebuffers();
+
+        // the new images haven't been drawn to, and present ids start over with the new swap chain
+        imageFrames.assign(imageCount(), 0);
+        firstPresentedFrame = 0;
+    }
+
+    void BESwapChain::retireImageResources()
+    {
+        BEDeletionQueue& deletionQueue = device.deletionQueue();
+
+        for (VkFramebuffer framebuffer : swapChainFramebuffers)
+        {
+            deletionQueue.retireFramebuffer(framebuffer);
+        }
+        swapChainFramebuffers.clear();
+
+        for (VkImageView imageView : swapChainImageViews)
+        {
+            deletionQueue.retireImageView(imageView);
+        }
+        swapChainImageViews.clear();
+        swapChainImages.clear();
+
+        for (size_t i = 0; i < depthImages.size(); i++)
+        {
+            deletionQueue.retireImageView(depthImageViews[i]);
+            attachmentMemory.releaseImage(depthImages[i], depthImageMemorys[i]);
+        }
+        depthImages.clear();
+        depthImageMemorys.clear();
+        depthImageViews.clear();
+
+        for (size_t i = 0; i < objectIdImages.size(); i++)
+        {
+            deletionQueue.retireImageView(objectIdImageViews[i]);
+            attachmentMemory.releaseImage(objectIdImages[i], objectIdImageMemorys[i]);
+        }
+        objectIdImages.clear();
+        objectIdImageMemorys.clear();
+        objectIdImageViews.clear();
+    }
+
+    void BESwapChain::createSwapChain(VkSwapchainKHR oldSwapChain)
     {
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        if (settings.imageCount != 0)
+        {
+            imageCount = std::max(settings.imageCount, swapChainSupport.capabilities.minImageCount);
+        }
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount)
         {
@@ -192,7 +415,7 @@ namespace bucketengine
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = oldSwapChain == nullptr ? VK_NULL_HANDLE : oldSwapChain->swapChain;
+        createInfo.oldSwapchain = oldSwapChain;
 
         if (vkCreateSwapchainKHR(device.device(), &createInfo, nullptr, &swapChain) != VK_SUCCESS)
         {
@@ -237,6 +460,12 @@ namespace bucketengine
 
     void BESwapChain::createRenderPass()
     {
+        if (dynamicRendering)
+        {
+            renderPass = VK_NULL_HANDLE;
+            return;
+        }
+
         VkAttachmentDescription depthAttachment{};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -265,32 +494,58 @@ namespace bucketengine
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        // cleared to NULL_ENTITY so pixels nothing was drawn to read back as no object
+        VkAttachmentDescription objectIdAttachmentDescription = {};
+        objectIdAttachmentDescription.format = OBJECT_ID_FORMAT;
+        objectIdAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+        objectIdAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        objectIdAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        objectIdAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        objectIdAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        objectIdAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        objectIdAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        std::array<VkAttachmentReference, 2> colorAttachmentRefs = {colorAttachmentRef, {}};
+        colorAttachmentRefs[1].attachment = 2;
+        colorAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
         VkSubpassDescription subpass = {};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef;
+        subpass.colorAttachmentCount = settings.objectIdAttachment ? 2 : 1;
+        subpass.pColorAttachments = colorAttachmentRefs.data();
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
         VkSubpassDependency dependency = {};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.srcAccessMask = 0;
-        dependency.srcStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        // the depth image may be shared with the frame before, its clear has to wait for that frame's depth writes
+        dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
         dependency.dstSubpass = 0;
-        dependency.dstStageMask =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask =
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        // the ids have to be written before the readback copy recorded after the pass reads them
+        VkSubpassDependency objectIdDependency = {};
+        objectIdDependency.srcSubpass = 0;
+        objectIdDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        objectIdDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        objectIdDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        objectIdDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        objectIdDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        std::array<VkSubpassDependency, 2> dependencies = {dependency, objectIdDependency};
+        std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, objectIdAttachmentDescription};
         VkRenderPassCreateInfo renderPassInfo = {};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.attachmentCount = settings.objectIdAttachment ? 3 : 2;
         renderPassInfo.pAttachments = attachments.data();
         renderPassInfo.subpassCount = 1;
         renderPassInfo.pSubpasses = &subpass;
-        renderPassInfo.dependencyCount = 1;
-        renderPassInfo.pDependencies = &dependency;
+        renderPassInfo.dependencyCount = settings.objectIdAttachment ? 2 : 1;
+        renderPassInfo.pDependencies = dependencies.data();
 
         if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
         {
@@ -300,16 +555,22 @@ namespace bucketengine
 
     void BESwapChain::createFramebuffers()
     {
+        if (dynamicRendering) return;
+
         swapChainFramebuffers.resize(imageCount());
         for (size_t i = 0; i < imageCount(); i++)
         {
-            std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+            std::array<VkImageView, 3> attachments = {
+                swapChainImageViews[i],
+                depthImageViews[depthIndex(static_cast<int>(i))],
+                settings.objectIdAttachment ? objectIdImageViews[i] : VK_NULL_HANDLE
+            };
 
             VkExtent2D swapChainExtent = getSwapChainExtent();
             VkFramebufferCreateInfo framebufferInfo = {};
             framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.attachmentCount = settings.objectIdAttachment ? 3 : 2;
             framebufferInfo.pAttachments = attachments.data();
             framebufferInfo.width = swapChainExtent.width;
             framebufferInfo.height = swapChainExtent.height;
@@ -333,9 +594,10 @@ namespace bucketengine
         swapChainDepthFormat = depthFormat;
         VkExtent2D swapChainExtent = getSwapChainExtent();
 
-        depthImages.resize(imageCount());
-        depthImageMemorys.resize(imageCount());
-        depthImageViews.resize(imageCount());
+        size_t depthImageCount = lazilyAllocatedDepth ? imageCount() : 1;
+        depthImages.resize(depthImageCount);
+        depthImageMemorys.resize(depthImageCount);
+        depthImageViews.resize(depthImageCount);
 
         for (int i = 0; i < depthImages.size(); i++)
         {
@@ -350,18 +612,25 @@ namespace bucketengine
             imageInfo.format = depthFormat;
             imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
             imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            // the depth is cleared at the start of the pass and never stored, so it needn't leave tile memory
+            imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
             imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
             imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
             imageInfo.flags = 0;
 
-            device.createImageWithInfo(
+            attachmentMemory.createImage(
                 imageInfo,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                lazilyAllocatedDepth
+                    ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                    : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 depthImages[i],
                 depthImageMemorys[i]
             );
 
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device.device(), depthImages[i], &memRequirements);
+            depthImageBytes = memRequirements.size;
+
             VkImageViewCreateInfo viewInfo{};
             viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             viewInfo.image = depthImages[i];
@@ -380,27 +649,78 @@ namespace bucketengine
         }
     }
 
+    void BESwapChain::createObjectIdResources()
+    {
+        if (!settings.objectIdAttachment) return;
+
+        VkExtent2D swapChainExtent = getSwapChainExtent();
+
+        objectIdImages.resize(imageCount());
+        objectIdImageMemorys.resize(imageCount());
+        objectIdImageViews.resize(imageCount());
+
+        for (size_t i = 0; i < objectIdImages.size(); i++)
+        {
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = swapChainExtent.width;
+            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = OBJECT_ID_FORMAT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.flags = 0;
+
+            attachmentMemory.createImage(
+                imageInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                objectIdImages[i],
+                objectIdImageMemorys[i]
+            );
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device.device(), objectIdImages[i], &memRequirements);
+            objectIdImageBytes = memRequirements.size;
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = objectIdImages[i];
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = OBJECT_ID_FORMAT;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(device.device(), &viewInfo, nullptr, &objectIdImageViews[i]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("failed to create object id image view!");
+            }
+        }
+    }
+
     void BESwapChain::createSyncObjects()
     {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+        imageAvailableSemaphores.resize(settings.framesInFlight);
+        renderFinishedSemaphores.resize(settings.framesInFlight);
+        imageFrames.resize(imageCount(), 0);
 
         VkSemaphoreCreateInfo semaphoreInfo = {};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo = {};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        for (size_t i = 0; i < settings.framesInFlight; i++)
         {
             if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
                 VK_SUCCESS ||
                 vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
-                VK_SUCCESS ||
-                vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+                VK_SUCCESS)
             {
                 throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
@@ -426,28 +746,38 @@ namespace bucketengine
         const std::vector<VkPresentModeKHR>& availablePresentModes)
     {
         // Mailbox: Lower latency, not always supported, high power consumption
+        // Immediate: Low latency, usually supported, Screen Tearing, high power consumption
         for (const auto& availablePresentMode : availablePresentModes)
         {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (availablePresentMode == settings.presentMode)
             {
-                std::cout << "Present mode: Mailbox" << std::endl;
+                std::cout << "Present mode: " << presentModeName(availablePresentMode) << std::endl;
                 return availablePresentMode;
             }
         }
 
-        // Immediate: Low latency, usually supported, Screen Tearing, high power consumption 
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
-
         // FIFO: V-sync bound, good for mobile, always supported, potentially higher latency
-        std::cout << "Present mode: V-Sync" << std::endl;
+        std::cout << "Present mode: " << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
+    const char* BESwapChain::presentModeName(VkPresentModeKHR presentMode)
+    {
+        switch (presentMode)
+        {
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "Mailbox";
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "Immediate";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "V-Sync";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "Relaxed V-Sync";
+        default:
+            return "Unknown";
+        }
+    }
+
     VkExtent2D BESwapChain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
     {
         if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "BEDevice.hpp"
+#include "BEPipeline.hpp"
+#include "utils/BEImageMemoryPool.hpp"
 
 // vulkan headers
 #include <vulkan/vulkan.h>
@@ -12,21 +14,98 @@
 
 namespace bucketengine
 {
+    // trades input latency against keeping the gpu busy
+    enum class LatencyMode
+    {
+        Low,
+        Balanced,
+        Throughput
+    };
+
+    const char* latencyModeName(LatencyMode mode);
+
+    struct SwapChainSettings
+    {
+        // frames the cpu may record ahead of the gpu, from 1 to BESwapChain::MAX_FRAMES_IN_FLIGHT
+        uint32_t framesInFlight = 2;
+        // swap chain images to ask for, 0 takes one more than the surface's minimum
+        uint32_t imageCount = 0;
+        // used when the surface supports it, otherwise fifo which every surface does
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+        // the render pass gets a second colour attachment the render systems write the id of the
+        // object covering each pixel into, it is left in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL at the
+        // end of the pass so texels can be copied out
+        bool objectIdAttachment = false;
+        // render straight into the images with VK_KHR_dynamic_rendering instead of through a render pass and
+        // framebuffers, ignored when the device doesn't support it
+        bool dynamicRendering = false;
+
+        static SwapChainSettings forLatencyMode(LatencyMode mode, bool objectIdAttachment = false);
+    };
+
     class BESwapChain
     {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        // the most frames in flight any settings may ask for
+        static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+        static_assert(MAX_FRAMES_IN_FLIGHT <= BEFrameTimeline::FENCE_COUNT, "Every frame in flight needs its own fence");
+        static constexpr VkFormat OBJECT_ID_FORMAT = VK_FORMAT_R32_UINT;
 
-        BESwapChain(BEDevice& deviceRef, VkExtent2D windowExtent);
-        BESwapChain(BEDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<BESwapChain> previous);
+        BESwapChain(BEDevice& deviceRef, VkExtent2D windowExtent, const SwapChainSettings& settings = {});
         ~BESwapChain();
 
         BESwapChain(const BESwapChain&) = delete;
         BESwapChain& operator=(const BESwapChain&) = delete;
 
+        /**
+         * Replaces the swap chain and everything sized to it without waiting for the device. The old handles
+         * are retired through the device's deletion queue and the attachments' memory is reused once the
+         * frames drawing to it have finished. The render pass and the frames' semaphores are kept unless the
+         * surface format changed, in which case the render pass is replaced and getRenderTargetVersion moves on.
+         * Must not be called while a frame is being recorded.
+         *
+         * @param windowExtent The window's size in pixels
+         * @param settings The new settings, frames in flight, the object id attachment and dynamic rendering
+         * can't change
+         */
+        void recreate(VkExtent2D windowExtent, const SwapChainSettings& settings);
+
+        // there is no render pass or framebuffers with dynamic rendering
+        bool usesDynamicRendering() const { return dynamicRendering; }
         VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
         VkRenderPass getRenderPass() { return renderPass; }
+        // what pipelines drawing to the swap chain are built for
+        RenderTargetInfo getRenderTarget() const;
+        // moves on when the render target changes, pipelines made for an older version have to be recreated
+        uint32_t getRenderTargetVersion() const { return renderTargetVersion; }
+        BEImageMemoryPool::Stats getAttachmentMemoryStats() const { return attachmentMemory.getStats(); }
+
+        struct AttachmentMemoryUsage
+        {
+            // one lazily allocated depth image per swap chain image, otherwise one depth image every frame shares
+            bool lazilyAllocatedDepth = false;
+            uint32_t depthImages = 0;
+            // what the depth images' memory requirements add up to
+            VkDeviceSize depthBytes = 0;
+            // what the device has actually backed them with, all of it unless they're lazily allocated
+            VkDeviceSize depthCommittedBytes = 0;
+            VkDeviceSize objectIdBytes = 0;
+        };
+        AttachmentMemoryUsage getAttachmentMemoryUsage() const;
+
+        VkImage getImage(int index) { return swapChainImages[index]; }
         VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+        // the depth attachment drawn to along with swap chain image index
+        VkImage getDepthImage(int index) { return depthImages[depthIndex(index)]; }
+        VkImageView getDepthImageView(int index) { return depthImageViews[depthIndex(index)]; }
+        VkFormat getSwapChainDepthFormat() const { return swapChainDepthFormat; }
+        bool hasObjectIdAttachment() const { return settings.objectIdAttachment; }
+        uint32_t getFramesInFlight() const { return settings.framesInFlight; }
+        // the present mode in use, which is fifo if the requested one wasn't supported
+        VkPresentModeKHR getPresentMode() const { return presentMode; }
+        static const char* presentModeName(VkPresentModeKHR presentMode);
+        VkImage getObjectIdImage(int index) { return objectIdImages[index]; }
+        VkImageView getObjectIdImageView(int index) { return objectIdImageViews[index]; }
         size_t imageCount() { return swapChainImages.size(); }
         VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
         VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -41,22 +120,47 @@ namespace bucketengine
         VkFormat findDepthFormat();
 
         VkResult acquireNextImage(uint32_t* imageIndex);
-        VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
-
-        bool compareSwapFormats(const BESwapChain &swapChain) const
-        {
-            return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
-                swapChain.swapChainImageFormat == swapChainImageFormat;
-        }
+        /**
+         * Submits the frame's command buffers and presents the image they draw to.
+         *
+         * @param buffers The frame's command buffer
+         * @param imageIndex The acquired image the frame draws to
+         * @param beforeSubmit (Optional) Called with context right before the queue submission, once nothing
+         * else can hold the frame up. Writes to host visible memory the commands read are still picked up
+         * @param context (Optional) Passed to beforeSubmit
+         *
+         * @return The result of presenting
+         */
+        VkResult submitCommandBuffers(
+            const VkCommandBuffer* buffers,
+            uint32_t* imageIndex,
+            void (*beforeSubmit)(void* context) = nullptr,
+            void* context = nullptr
+        );
+
+        /**
+         * Blocks until a frame presented through this swap chain is on screen. Needs
+         * BEDevice::supportsPresentWait, without it or for frames presented elsewhere it returns straight away.
+         *
+         * @param frame The frame's number on the device's frame timeline
+         * @param timeout Nanoseconds to wait at most
+         *
+         * @return True if the frame has been shown
+         */
+        bool waitForPresent(uint64_t frame, uint64_t timeout);
         
     private:
         void init();
-        void createSwapChain();
+        void createSwapChain(VkSwapchainKHR oldSwapChain);
         void createImageViews();
         void createDepthResources();
+        size_t depthIndex(int imageIndex) const { return lazilyAllocatedDepth ? imageIndex : 0; }
+        void createObjectIdResources();
         void createRenderPass();
         void createFramebuffers();
         void createSyncObjects();
+        // hands everything sized to the swap chain's images to the deletion queue and the memory pool
+        void retireImageResources();
 
         // Helper functions
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -70,24 +174,39 @@ namespace bucketengine
         VkExtent2D swapChainExtent;
 
         std::vector<VkFramebuffer> swapChainFramebuffers;
-        VkRenderPass renderPass;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t renderTargetVersion = 0;
+        bool dynamicRendering = false;
+        // depth is never read after the pass, so it is either lazily allocated for each image or one image all
+        // of them share, the render pass orders each frame's depth writes after the last frame's
+        bool lazilyAllocatedDepth = false;
+        VkDeviceSize depthImageBytes = 0;
+        VkDeviceSize objectIdImageBytes = 0;
 
         std::vector<VkImage> depthImages;
         std::vector<VkDeviceMemory> depthImageMemorys;
         std::vector<VkImageView> depthImageViews;
+        std::vector<VkImage> objectIdImages;
+        std::vector<VkDeviceMemory> objectIdImageMemorys;
+        std::vector<VkImageView> objectIdImageViews;
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
 
         BEDevice& device;
+        // the depth and object id attachments' memory, kept across recreations
+        BEImageMemoryPool attachmentMemory;
         VkExtent2D windowExtent;
+        SwapChainSettings settings;
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        // zero until something has been presented with a present id
+        uint64_t firstPresentedFrame = 0;
 
         VkSwapchainKHR swapChain;
-        std::shared_ptr<BESwapChain> oldSwapChain;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
-        std::vector<VkFence> inFlightFences;
-        std::vector<VkFence> imagesInFlight;
+        // the frame of the device's frame timeline that last rendered to each image, zero if none has
+        std::vector<uint64_t> imageFrames;
         size_t currentFrame = 0;
     };
 }
@@ -31,6 +31,12 @@ namespace bucketengine
         beWindow->height = height;
     }
 
+    void BEWindow::refreshCallback(GLFWwindow* window)
+    {
+        auto beWindow = reinterpret_cast<BEWindow *>(glfwGetWindowUserPointer(window));
+        beWindow->refreshRequested = true;
+    }
+
     void BEWindow::initWindow()
     {
         glfwInit();
@@ -40,5 +46,6 @@ namespace bucketengine
         window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, frameBufferResizedCallback);
+        glfwSetWindowRefreshCallback(window, refreshCallback);
     }
 }
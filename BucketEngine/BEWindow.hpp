@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <string>
 
 namespace bucketengine
@@ -23,16 +24,27 @@ namespace bucketengine
         bool getFrameBufferResized() { return frameBufferResized; }
         void resetWindowResizedFlag() { frameBufferResized = false; }
 
+        // true once after the system asked for the window's contents to be drawn again, eg when it was uncovered
+        bool consumeRefreshRequest() { return refreshRequested.exchange(false); }
+
         GLFWwindow *getGLFWwindow() const { return window; }
+
+        // the glfw user pointer belongs to the window, input callbacks find their handler through this
+        void setInputHandler(void *handler) { inputHandler = handler; }
+        void *getInputHandler() const { return inputHandler; }
         
         void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
     private:
         static void frameBufferResizedCallback(GLFWwindow *window, int width, int height);
+        static void refreshCallback(GLFWwindow *window);
         void initWindow();
 
-        int width;
-        int height;
-        bool frameBufferResized = false;
+        // written by glfw callbacks on the main thread and read by the render thread
+        std::atomic<int> width;
+        std::atomic<int> height;
+        std::atomic<bool> frameBufferResized{false};
+        std::atomic<bool> refreshRequested{false};
+        void *inputHandler = nullptr;
 
         std::string windowName;
         GLFWwindow *window;
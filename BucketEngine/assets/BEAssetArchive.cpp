@@ -0,0 +1,412 @@
+﻿#include "BEAssetArchive.hpp"
+
+#include "../utils/BECompression.hpp"
+#include "../utils/BEUtils.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr char ARCHIVE_MAGIC[4] = {'B', 'E', 'P', 'K'};
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    BEAssetArchive::BEAssetArchive(const std::string& archivePath) : archivePath{archivePath}
+    {
+        mapFile();
+        try
+        {
+            validate();
+        }
+        catch (...)
+        {
+            unmapFile();
+            throw;
+        }
+    }
+
+    BEAssetArchive::~BEAssetArchive()
+    {
+        unmapFile();
+    }
+
+    const BEAssetArchive::Entry* BEAssetArchive::find(const std::string& path) const
+    {
+        std::string normalized = normalizePath(path);
+        uint64_t hash = hashPath(normalized);
+
+        const Entry* end = entries + entryCount;
+        const Entry* it = std::lower_bound(entries, end, hash, [](const Entry& entry, uint64_t value)
+        {
+            return entry.pathHash < value;
+        });
+
+        // walk every entry sharing the hash, collisions are resolved by comparing the stored path
+        for (; it != end && it->pathHash == hash; ++it)
+        {
+            if (it->pathLength == normalized.size()
+                && std::memcmp(paths + it->pathOffset, normalized.data(), normalized.size()) == 0)
+            {
+                return it;
+            }
+        }
+        return nullptr;
+    }
+
+    const char* BEAssetArchive::view(const Entry& entry) const
+    {
+        assert(entry.compression == Compression::None && "Cannot view a compressed archive entry");
+        return mapping + entry.offset;
+    }
+
+    void BEAssetArchive::read(const Entry& entry, std::vector<char>& output) const
+    {
+        output.resize(static_cast<size_t>(entry.size));
+
+        const char* stored = mapping + entry.offset;
+        switch (entry.compression)
+        {
+        case Compression::None:
+            if (!output.empty()) std::memcpy(output.data(), stored, output.size());
+            break;
+        case Compression::LZ4:
+            if (!lz4::decompress(stored, static_cast<size_t>(entry.storedSize), output.data(), output.size()))
+            {
+                throw std::runtime_error("Failed to decompress " + getEntryPath(entry) + " in " + archivePath);
+            }
+            break;
+        default:
+            throw std::runtime_error("Unknown compression for " + getEntryPath(entry) + " in " + archivePath);
+        }
+
+        if (hashBytes(output.data(), output.size()) != entry.contentHash)
+        {
+            throw std::runtime_error("Content hash mismatch for " + getEntryPath(entry) + " in " + archivePath);
+        }
+    }
+
+    std::string BEAssetArchive::getEntryPath(const Entry& entry) const
+    {
+        return std::string(paths + entry.pathOffset, entry.pathLength);
+    }
+
+    std::string BEAssetArchive::normalizePath(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    uint64_t BEAssetArchive::hashPath(const std::string& path)
+    {
+        return hashBytes(path.data(), path.size());
+    }
+
+    void BEAssetArchive::mapFile()
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(
+            archivePath.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_FLAG_RANDOM_ACCESS,
+            nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("Failed to open archive: " + archivePath);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to read archive size: " + archivePath);
+        }
+
+        HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (fileMapping == nullptr)
+        {
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map archive: " + archivePath);
+        }
+
+        void* view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+        if (view == nullptr)
+        {
+            CloseHandle(fileMapping);
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map archive: " + archivePath);
+        }
+
+        fileHandle = file;
+        mappingHandle = fileMapping;
+        mapping = static_cast<const char*>(view);
+        mappingSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = open(archivePath.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to open archive: " + archivePath);
+        }
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to read archive size: " + archivePath);
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps the file referenced, the descriptor isn't needed any more
+        close(fd);
+        if (view == MAP_FAILED)
+        {
+            throw std::runtime_error("Failed to map archive: " + archivePath);
+        }
+
+        // entries are read in whatever order the game asks for them
+        madvise(view, static_cast<size_t>(fileStat.st_size), MADV_RANDOM);
+
+        mapping = static_cast<const char*>(view);
+        mappingSize = static_cast<size_t>(fileStat.st_size);
+#endif
+    }
+
+    void BEAssetArchive::unmapFile()
+    {
+        if (mapping == nullptr)
+        {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        munmap(const_cast<char*>(mapping), mappingSize);
+#endif
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+    void BEAssetArchive::validate()
+    {
+        if (mappingSize < sizeof(Header))
+        {
+            throw std::runtime_error("Archive is too small: " + archivePath);
+        }
+
+        Header header;
+        std::memcpy(&header, mapping, sizeof(header));
+        if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0)
+        {
+            throw std::runtime_error("Not an asset archive: " + archivePath);
+        }
+        if (header.version != VERSION)
+        {
+            throw std::runtime_error("Unsupported archive version: " + archivePath);
+        }
+
+        uint64_t tableSize = static_cast<uint64_t>(header.entryCount) * sizeof(Entry);
+        if (header.entriesOffset % alignof(Entry) != 0
+            || header.entriesOffset > mappingSize
+            || tableSize > mappingSize - header.entriesOffset
+            || header.pathsOffset > mappingSize
+            || header.pathsSize > mappingSize - header.pathsOffset)
+        {
+            throw std::runtime_error("Archive table of contents is out of range: " + archivePath);
+        }
+
+        entries = reinterpret_cast<const Entry*>(mapping + header.entriesOffset);
+        entryCount = header.entryCount;
+        paths = mapping + header.pathsOffset;
+
+        // checking every range once here means lookups and reads never have to
+        for (uint32_t i = 0; i < entryCount; i++)
+        {
+            const Entry& entry = entries[i];
+            if (entry.offset > mappingSize
+                || entry.storedSize > mappingSize - entry.offset
+                || static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > header.pathsSize
+                || (entry.compression == Compression::None && entry.storedSize != entry.size)
+                // a corrupt size would otherwise be allocated in full before decompression rejects it
+                || (entry.compression == Compression::LZ4 && entry.size > lz4::maxDecompressedSize(entry.storedSize))
+                || (entry.compression != Compression::None && entry.compression != Compression::LZ4)
+                || (i > 0 && entries[i - 1].pathHash > entry.pathHash))
+            {
+                throw std::runtime_error("Archive entry is corrupt: " + archivePath);
+            }
+        }
+    }
+
+    void BEAssetArchive::Writer::addData(
+        const std::string& path,
+        const void* data,
+        size_t size,
+        Compression compression)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        pendingEntries.push_back({normalizePath(path), std::vector<char>(bytes, bytes + size), compression});
+    }
+
+    void BEAssetArchive::Writer::addFile(
+        const std::string& path,
+        const std::string& filePath,
+        Compression compression)
+    {
+        std::ifstream file{filePath, std::ios::ate | std::ios::binary};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open file: " + filePath);
+        }
+
+        std::vector<char> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+        pendingEntries.push_back({normalizePath(path), std::move(data), compression});
+    }
+
+    void BEAssetArchive::Writer::addDirectory(
+        const std::string& directory,
+        const std::vector<std::string>& extensions,
+        Compression compression)
+    {
+        // sorted so packing the same files twice produces the same archive
+        std::vector<std::filesystem::path> files;
+        for (const auto& item : std::filesystem::recursive_directory_iterator(directory))
+        {
+            if (!item.is_regular_file()) continue;
+
+            const std::string extension = item.path().extension().string();
+            if (std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+            {
+                files.push_back(item.path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        for (const auto& file : files)
+        {
+            addFile(file.generic_string(), file.string(), compression);
+        }
+    }
+
+    void BEAssetArchive::Writer::write(const std::string& archivePath) const
+    {
+        std::vector<const PendingEntry*> sorted;
+        sorted.reserve(pendingEntries.size());
+        for (const auto& pending : pendingEntries)
+        {
+            sorted.push_back(&pending);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const PendingEntry* a, const PendingEntry* b)
+        {
+            return hashPath(a->path) < hashPath(b->path);
+        });
+
+        std::ofstream file{archivePath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to create archive: " + archivePath);
+        }
+
+        std::vector<Entry> table;
+        table.reserve(sorted.size());
+        std::string pathStrings;
+
+        uint64_t offset = sizeof(Header);
+        file.seekp(static_cast<std::streamoff>(offset));
+
+        auto pad = [&file, &offset](uint64_t alignment)
+        {
+            static const char zeros[ENTRY_ALIGNMENT] = {};
+            uint64_t aligned = alignUp(offset, alignment);
+            file.write(zeros, static_cast<std::streamsize>(aligned - offset));
+            offset = aligned;
+        };
+
+        std::vector<char> compressed;
+        for (const PendingEntry* pending : sorted)
+        {
+            pad(ENTRY_ALIGNMENT);
+
+            Entry entry{};
+            entry.pathHash = hashPath(pending->path);
+            entry.offset = offset;
+            entry.size = pending->data.size();
+            entry.contentHash = hashBytes(pending->data.data(), pending->data.size());
+            entry.pathOffset = static_cast<uint32_t>(pathStrings.size());
+            entry.pathLength = static_cast<uint32_t>(pending->path.size());
+            pathStrings += pending->path;
+
+            const char* stored = pending->data.data();
+            entry.storedSize = pending->data.size();
+            entry.compression = Compression::None;
+
+            if (pending->compression == Compression::LZ4)
+            {
+                compressed.resize(lz4::compressBound(pending->data.size()));
+                size_t compressedSize = lz4::compress(pending->data.data(), pending->data.size(), compressed.data());
+
+                // keep data that doesn't shrink uncompressed, it is then readable in place
+                if (compressedSize < pending->data.size())
+                {
+                    stored = compressed.data();
+                    entry.storedSize = compressedSize;
+                    entry.compression = Compression::LZ4;
+                }
+            }
+
+            file.write(stored, static_cast<std::streamsize>(entry.storedSize));
+            offset += entry.storedSize;
+            table.push_back(entry);
+        }
+
+        pad(ENTRY_ALIGNMENT);
+        Header header{};
+        std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+        header.version = VERSION;
+        header.entryCount = static_cast<uint32_t>(table.size());
+        header.entriesOffset = offset;
+        header.pathsOffset = offset + table.size() * sizeof(Entry);
+        header.pathsSize = pathStrings.size();
+
+        file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(Entry)));
+        file.write(pathStrings.data(), static_cast<std::streamsize>(pathStrings.size()));
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write archive: " + archivePath);
+        }
+    }
+}
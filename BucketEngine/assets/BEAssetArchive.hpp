@@ -0,0 +1,134 @@
+﻿#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bucketengine
+{
+    // a read only pack of assets that is memory mapped as a whole. the table of contents is sorted
+    // by path hash so a lookup is a binary search over memory that is already mapped, and entries
+    // stored uncompressed are handed out as pointers straight into the mapping.
+    //
+    // file layout, all integers little endian:
+    //   Header | entry data, each entry 16 byte aligned | Entry table | path strings
+    class BEAssetArchive
+    {
+    public:
+        enum class Compression : uint32_t
+        {
+            None = 0,
+            LZ4 = 1,
+        };
+
+        struct Entry
+        {
+            uint64_t pathHash;
+            uint64_t offset;        // from the start of the archive
+            uint64_t storedSize;    // size in the archive, after compression
+            uint64_t size;          // size once decompressed
+            uint64_t contentHash;   // hashBytes of the decompressed data
+            Compression compression;
+            uint32_t pathOffset;    // into the path string table
+            uint32_t pathLength;
+            uint32_t reserved;
+        };
+
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint64_t ENTRY_ALIGNMENT = 16;
+
+        explicit BEAssetArchive(const std::string& archivePath);
+        ~BEAssetArchive();
+
+        BEAssetArchive(const BEAssetArchive&) = delete;
+        BEAssetArchive& operator=(const BEAssetArchive&) = delete;
+
+        // nullptr if the archive has no entry for the path
+        const Entry* find(const std::string& path) const;
+
+        // pointer to the entry's bytes inside the mapping, only valid for uncompressed entries
+        // and only for as long as the archive is alive
+        const char* view(const Entry& entry) const;
+
+        // decompresses, or copies, the entry into output and checks it against its content hash
+        void read(const Entry& entry, std::vector<char>& output) const;
+
+        std::string getEntryPath(const Entry& entry) const;
+        uint32_t getEntryCount() const { return entryCount; }
+        const std::string& getArchivePath() const { return archivePath; }
+
+        // archive paths are stored lexically normalised with forward slashes so "./models/a.obj"
+        // and "models\\a.obj" name the same entry
+        static std::string normalizePath(const std::string& path);
+        static uint64_t hashPath(const std::string& path);
+
+        // builds archives, used by tooling rather than at runtime
+        class Writer
+        {
+        public:
+            void addData(
+                const std::string& path,
+                const void* data,
+                size_t size,
+                Compression compression = Compression::LZ4
+            );
+            void addFile(
+                const std::string& path,
+                const std::string& filePath,
+                Compression compression = Compression::LZ4
+            );
+            // adds every file below directory with one of the extensions, under the same relative path
+            // it would be read from as a loose file
+            void addDirectory(
+                const std::string& directory,
+                const std::vector<std::string>& extensions,
+                Compression compression = Compression::LZ4
+            );
+
+            size_t getEntryCount() const { return pendingEntries.size(); }
+
+            void write(const std::string& archivePath) const;
+
+        private:
+            struct PendingEntry
+            {
+                std::string path;
+                std::vector<char> data;
+                Compression compression;
+            };
+
+            std::vector<PendingEntry> pendingEntries;
+        };
+
+    private:
+        struct Header
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t entryCount;
+            uint32_t reserved;
+            uint64_t entriesOffset;
+            uint64_t pathsOffset;
+            uint64_t pathsSize;
+        };
+
+        void mapFile();
+        void unmapFile();
+        void validate();
+
+        std::string archivePath;
+
+        const char* mapping = nullptr;
+        size_t mappingSize = 0;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+
+        const Entry* entries = nullptr;
+        uint32_t entryCount = 0;
+        const char* paths = nullptr;
+    };
+}
@@ -0,0 +1,200 @@
+﻿#include "BEAssetManager.hpp"
+
+#include "../utils/BEUtils.hpp"
+
+// std
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace bucketengine
+{
+    size_t BEAssetManager::ModelKeyHash::operator()(const ModelKey& key) const
+    {
+        size_t seed = 0;
+        hashCombine(seed, key.path, key.settings.deduplicateVertices, key.settings.buildRayBVH);
+        return seed;
+    }
+
+    BEAssetManager::BEAssetManager(BEDevice& device, VkDeviceSize memoryBudget)
+        : beDevice{device}, streamer{device}, memoryBudget{memoryBudget}
+    {}
+
+    BEAssetManager::~BEAssetManager()
+    {
+        for (const auto& [key, entry] : models)
+        {
+            if (entry.model.use_count() > 1)
+            {
+                std::cerr << "Asset manager destroyed while model is still referenced: " << key.path << "\n";
+            }
+        }
+    }
+
+    std::shared_ptr<BEModel> BEAssetManager::loadModel(
+        const std::string& filePath,
+        const BEModel::ImportSettings& settings
+    )
+    {
+        ModelKey key{canonicalPath(filePath), settings};
+
+        auto it = models.find(key);
+        if (it != models.end())
+        {
+            it->second.lastRequested = ++requestCounter;
+            return it->second.model;
+        }
+
+        // load from the path we were given, the canonical path is only used as the cache key
+        std::shared_ptr<BEModel> model = BEModel::createModelFromFile(beDevice, filePath, settings);
+        VkDeviceSize memorySize = model->getMemorySize();
+
+        models.emplace(std::move(key), ModelEntry{model, filePath, memorySize, ++requestCounter});
+        memoryUsage += memorySize;
+
+        if (memoryUsage > memoryBudget)
+        {
+            evictUnreferenced();
+        }
+
+        return model;
+    }
+
+    std::shared_ptr<BEModel> BEAssetManager::loadModelAsync(
+        const std::string& filePath,
+        const BEModel::ImportSettings& settings
+    )
+    {
+        ModelKey key{canonicalPath(filePath), settings};
+
+        auto it = models.find(key);
+        if (it != models.end())
+        {
+            it->second.lastRequested = ++requestCounter;
+            return it->second.model;
+        }
+
+        // the memory size is filled in by update() once the upload has finished
+        auto model = std::make_shared<BEModel>(beDevice);
+        models.emplace(std::move(key), ModelEntry{model, filePath, 0, ++requestCounter});
+        streamer.requestModel(model, filePath, settings);
+
+        return model;
+    }
+
+    void BEAssetManager::update(const BEAssetStreamer::UploadBudget& budget)
+    {
+        failedLoads.clear();
+        streamer.update(budget, readyModels, failedLoads);
+
+        for (const auto& failed : failedLoads)
+        {
+            std::cerr << "Failed to load model " << failed.filePath << ": " << failed.error << "\n";
+            for (auto it = models.begin(); it != models.end(); ++it)
+            {
+                if (it->second.model == failed.model)
+                {
+                    models.erase(it);
+                    break;
+                }
+            }
+        }
+
+        if (readyModels.empty()) return;
+
+        for (auto& [key, entry] : models)
+        {
+            if (entry.memorySize == 0 && entry.model->isReady())
+            {
+                entry.memorySize = entry.model->getMemorySize();
+                memoryUsage += entry.memorySize;
+            }
+        }
+        readyModels.clear();
+
+        if (memoryUsage > memoryBudget)
+        {
+            evictUnreferenced();
+        }
+    }
+
+    void BEAssetManager::setMemoryBudget(VkDeviceSize budget)
+    {
+        memoryBudget = budget;
+        evictUnreferenced();
+    }
+
+    std::vector<BEAssetManager::AssetInfo> BEAssetManager::getAssetInfo() const
+    {
+        std::vector<AssetInfo> info{};
+        info.reserve(models.size());
+        for (const auto& [key, entry] : models)
+        {
+            info.push_back({key.path, entry.memorySize, entry.model.use_count() - 1});
+        }
+        return info;
+    }
+
+    bool BEAssetManager::getModelSource(const BEModel* model, ModelSource& source) const
+    {
+        for (const auto& [key, entry] : models)
+        {
+            if (entry.model.get() == model)
+            {
+                source.path = entry.sourcePath;
+                source.settings = key.settings;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void BEAssetManager::evictUnreferenced()
+    {
+        evict(memoryBudget);
+    }
+
+    void BEAssetManager::purgeUnreferenced()
+    {
+        evict(0);
+    }
+
+    std::string BEAssetManager::canonicalPath(const std::string& filePath)
+    {
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::weakly_canonical(filePath, error);
+        if (error)
+        {
+            path = std::filesystem::path(filePath).lexically_normal();
+        }
+        return path.generic_string();
+    }
+
+    void BEAssetManager::evict(VkDeviceSize targetUsage)
+    {
+        if (memoryUsage <= targetUsage) return;
+
+        // a use count of one means the only handle left is ours
+        std::vector<decltype(models)::iterator> candidates{};
+        for (auto it = models.begin(); it != models.end(); ++it)
+        {
+            if (it->second.model.use_count() == 1)
+            {
+                candidates.push_back(it);
+            }
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b)
+        {
+            return a->second.lastRequested < b->second.lastRequested;
+        });
+
+        for (auto it : candidates)
+        {
+            if (memoryUsage <= targetUsage) break;
+
+            memoryUsage -= it->second.memorySize;
+            models.erase(it);
+        }
+    }
+}
@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include "../BEDevice.hpp"
+#include "../BEModel.hpp"
+#include "BEAssetStreamer.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bucketengine
+{
+    // owns every model loaded from disk so each unique file and import settings pair is only
+    // parsed and uploaded to the gpu once, no matter how many game objects reference it
+    class BEAssetManager
+    {
+    public:
+        static constexpr VkDeviceSize DEFAULT_MEMORY_BUDGET = 512ull * 1024 * 1024;
+
+        struct AssetInfo
+        {
+            std::string path;
+            VkDeviceSize memorySize;
+            // number of handles held outside of the asset manager
+            long references;
+        };
+
+        // where a cached model was loaded from, as it was first requested
+        struct ModelSource
+        {
+            std::string path;
+            BEModel::ImportSettings settings;
+        };
+
+        BEAssetManager(BEDevice& device, VkDeviceSize memoryBudget = DEFAULT_MEMORY_BUDGET);
+        ~BEAssetManager();
+
+        BEAssetManager(const BEAssetManager&) = delete;
+        BEAssetManager& operator=(const BEAssetManager&) = delete;
+
+        std::shared_ptr<BEModel> loadModel(
+            const std::string& filePath,
+            const BEModel::ImportSettings& settings = {}
+        );
+
+        // returns immediately with a model that isn't ready yet, it's parsed on a worker thread and
+        // uploaded by update() within the streaming budget. check BEModel::isReady before drawing it
+        std::shared_ptr<BEModel> loadModelAsync(
+            const std::string& filePath,
+            const BEModel::ImportSettings& settings = {}
+        );
+
+        // progresses background loads, call once per frame before recording
+        void update(const BEAssetStreamer::UploadBudget& budget = {});
+        // background loads that failed during the last update. their models are marked failed and dropped
+        // from the cache, so requesting the same path again retries the load
+        const std::vector<BEAssetStreamer::FailedLoad>& getFailedLoads() const { return failedLoads; }
+        size_t getPendingCount() const { return streamer.pendingCount(); }
+
+        // the budget is soft, models still referenced by the game are never evicted
+        void setMemoryBudget(VkDeviceSize budget);
+        VkDeviceSize getMemoryBudget() const { return memoryBudget; }
+        VkDeviceSize getMemoryUsage() const { return memoryUsage; }
+        size_t getModelCount() const { return models.size(); }
+        std::vector<AssetInfo> getAssetInfo() const;
+
+        // false if the model wasn't loaded through this asset manager
+        bool getModelSource(const BEModel* model, ModelSource& source) const;
+
+        // drop unreferenced models, least recently requested first, until we fit the budget
+        void evictUnreferenced();
+        // drop every unreferenced model regardless of the budget
+        void purgeUnreferenced();
+
+        static std::string canonicalPath(const std::string& filePath);
+
+    private:
+        struct ModelKey
+        {
+            std::string path;
+            BEModel::ImportSettings settings;
+
+            bool operator==(const ModelKey& other) const
+            {
+                return path == other.path && settings == other.settings;
+            }
+        };
+
+        struct ModelKeyHash
+        {
+            size_t operator()(const ModelKey& key) const;
+        };
+
+        struct ModelEntry
+        {
+            std::shared_ptr<BEModel> model;
+            // the path as it was requested, unlike the key it is relative to the working directory
+            std::string sourcePath;
+            VkDeviceSize memorySize;
+            uint64_t lastRequested;
+        };
+
+        void evict(VkDeviceSize targetUsage);
+
+        BEDevice& beDevice;
+        BEAssetStreamer streamer;
+        std::vector<std::shared_ptr<BEModel>> readyModels;
+        std::vector<BEAssetStreamer::FailedLoad> failedLoads;
+
+        std::unordered_map<ModelKey, ModelEntry, ModelKeyHash> models;
+        VkDeviceSize memoryBudget;
+        VkDeviceSize memoryUsage = 0;
+        uint64_t requestCounter = 0;
+    };
+}
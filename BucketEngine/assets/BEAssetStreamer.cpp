@@ -0,0 +1,252 @@
+﻿#include "BEAssetStreamer.hpp"
+
+// std
+#include <cassert>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+namespace bucketengine
+{
+    BEAssetStreamer::BEAssetStreamer(BEDevice& device, uint32_t workerCount) : beDevice{device}
+    {
+        // uploads get their own pool so recording them never races the renderer's command buffers
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = beDevice.findPhysicalQueueFamilies().graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if (vkCreateCommandPool(beDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create asset streaming command pool");
+        }
+
+        if (workerCount == 0)
+        {
+            const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            workers.emplace_back(&BEAssetStreamer::workerLoop, this);
+        }
+    }
+
+    BEAssetStreamer::~BEAssetStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            stopping = true;
+        }
+        queueCondition.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        // staging buffers can't be freed while the gpu may still be reading them
+        std::vector<std::shared_ptr<BEModel>> readyModels{};
+        retireUploads(true, readyModels);
+
+        vkDestroyCommandPool(beDevice.device(), commandPool, nullptr);
+    }
+
+    void BEAssetStreamer::requestModel(
+        std::shared_ptr<BEModel> model,
+        const std::string& filePath,
+        const BEModel::ImportSettings& settings
+    )
+    {
+        assert(model && !model->isReady() && "Can only stream into an empty model");
+        {
+            std::lock_guard<std::mutex> lock{queueMutex};
+            parseQueue.push_back({std::move(model), filePath, settings});
+        }
+        queueCondition.notify_one();
+    }
+
+    void BEAssetStreamer::update(
+        const UploadBudget& budget,
+        std::vector<std::shared_ptr<BEModel>>& readyModels,
+        std::vector<FailedLoad>& failedLoads
+    )
+    {
+        retireUploads(false, readyModels);
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto elapsedMilliseconds = [&startTime]()
+        {
+            auto now = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration<float, std::chrono::milliseconds::period>(now - startTime).count();
+        };
+
+        Upload upload{};
+        VkDeviceSize bytesRecorded = 0;
+
+        while (bytesRecorded < budget.maxBytesPerFrame && elapsedMilliseconds() < budget.maxMillisecondsPerFrame)
+        {
+            ParsedModel parsed{};
+            {
+                std::lock_guard<std::mutex> lock{queueMutex};
+                if (parsedQueue.empty()) break;
+
+                const auto& next = parsedQueue.front();
+                VkDeviceSize nextSize = next.builder.vertices.size() * sizeof(BEModel::Vertex)
+                    + next.builder.indices.size() * sizeof(uint32_t);
+
+                // a model bigger than the whole budget still goes through on its own so it can't stall forever
+                if (bytesRecorded > 0 && bytesRecorded + nextSize > budget.maxBytesPerFrame) break;
+
+                parsed = std::move(parsedQueue.front());
+                parsedQueue.pop_front();
+                bytesRecorded += nextSize;
+            }
+
+            if (!parsed.error.empty())
+            {
+                parsed.model->markFailed();
+                failedLoads.push_back({std::move(parsed.model), std::move(parsed.filePath), std::move(parsed.error)});
+                continue;
+            }
+
+            if (upload.commandBuffer == VK_NULL_HANDLE)
+            {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandPool = commandPool;
+                allocInfo.commandBufferCount = 1;
+
+                if (vkAllocateCommandBuffers(beDevice.device(), &allocInfo, &upload.commandBuffer) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to allocate asset upload command buffer");
+                }
+
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+            }
+
+            auto stagingBuffers = parsed.model->recordUpload(parsed.builder, upload.commandBuffer);
+            for (auto& stagingBuffer : stagingBuffers)
+            {
+                upload.stagingBuffers.push_back(std::move(stagingBuffer));
+            }
+            upload.models.push_back(std::move(parsed.model));
+        }
+
+        if (upload.commandBuffer == VK_NULL_HANDLE) return;
+
+        vkEndCommandBuffer(upload.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(beDevice.device(), &fenceInfo, nullptr, &upload.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create asset upload fence");
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &upload.commandBuffer;
+
+        {
+            std::lock_guard<std::mutex> lock{beDevice.queueMutex()};
+            if (vkQueueSubmit(beDevice.graphicsQueue(), 1, &submitInfo, upload.fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to submit asset upload");
+            }
+        }
+
+        uploads.push_back(std::move(upload));
+    }
+
+    size_t BEAssetStreamer::pendingCount() const
+    {
+        std::lock_guard<std::mutex> lock{queueMutex};
+        size_t uploading = 0;
+        for (const auto& upload : uploads)
+        {
+            uploading += upload.models.size();
+        }
+        return parseQueue.size() + parsingCount + parsedQueue.size() + uploading;
+    }
+
+    void BEAssetStreamer::flush(std::vector<FailedLoad>& failedLoads)
+    {
+        std::vector<std::shared_ptr<BEModel>> readyModels{};
+        UploadBudget unlimited{~VkDeviceSize{0}, std::numeric_limits<float>::max()};
+
+        while (pendingCount() > 0)
+        {
+            update(unlimited, readyModels, failedLoads);
+            retireUploads(true, readyModels);
+            std::this_thread::yield();
+        }
+    }
+
+    void BEAssetStreamer::workerLoop()
+    {
+        while (true)
+        {
+            ParseRequest request{};
+            {
+                std::unique_lock<std::mutex> lock{queueMutex};
+                queueCondition.wait(lock, [this]() { return stopping || !parseQueue.empty(); });
+
+                if (stopping) return;
+
+                request = std::move(parseQueue.front());
+                parseQueue.pop_front();
+                parsingCount++;
+            }
+
+            ParsedModel parsed{};
+            parsed.model = std::move(request.model);
+            parsed.filePath = std::move(request.filePath);
+            try
+            {
+                parsed.builder.loadModel(parsed.filePath, request.settings);
+            } catch (const std::exception& e)
+            {
+                parsed.error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock{queueMutex};
+            parsedQueue.push_back(std::move(parsed));
+            parsingCount--;
+        }
+    }
+
+    void BEAssetStreamer::retireUploads(bool wait, std::vector<std::shared_ptr<BEModel>>& readyModels)
+    {
+        // uploads are submitted in order, so the first unfinished one ends the scan
+        while (!uploads.empty())
+        {
+            auto& upload = uploads.front();
+            if (wait)
+            {
+                vkWaitForFences(beDevice.device(), 1, &upload.fence, VK_TRUE, UINT64_MAX);
+            }
+            else if (vkGetFenceStatus(beDevice.device(), upload.fence) != VK_SUCCESS)
+            {
+                break;
+            }
+
+            for (auto& model : upload.models)
+            {
+                model->markReady();
+                readyModels.push_back(std::move(model));
+            }
+
+            vkDestroyFence(beDevice.device(), upload.fence, nullptr);
+            vkFreeCommandBuffers(beDevice.device(), commandPool, 1, &upload.commandBuffer);
+            uploads.pop_front();
+        }
+    }
+}
@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include "../BEDevice.hpp"
+#include "../BEModel.hpp"
+#include "../buffers/BEBuffer.hpp"
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bucketengine
+{
+    // loads models in the background. worker threads parse the source files, and each frame
+    // update() moves as many parsed models to the gpu as the upload budget allows. a model is
+    // marked ready once the fence of the submission that copied its buffers has signaled
+    class BEAssetStreamer
+    {
+    public:
+        struct UploadBudget
+        {
+            // bytes of geometry copied into staging memory per frame
+            VkDeviceSize maxBytesPerFrame = 8ull * 1024 * 1024;
+            // cpu time spent recording uploads per frame
+            float maxMillisecondsPerFrame = 2.f;
+        };
+
+        // a request whose file couldn't be parsed, its model has been marked failed and will never be ready
+        struct FailedLoad
+        {
+            std::shared_ptr<BEModel> model;
+            std::string filePath;
+            std::string error;
+        };
+
+        // a worker count of zero uses one worker per hardware thread, leaving one for the main thread
+        BEAssetStreamer(BEDevice& device, uint32_t workerCount = 0);
+        ~BEAssetStreamer();
+
+        BEAssetStreamer(const BEAssetStreamer&) = delete;
+        BEAssetStreamer& operator=(const BEAssetStreamer&) = delete;
+
+        // model must have been created with the empty BEModel constructor
+        void requestModel(
+            std::shared_ptr<BEModel> model,
+            const std::string& filePath,
+            const BEModel::ImportSettings& settings = {}
+        );
+
+        // retires finished uploads then records new ones, must be called from the thread that submits
+        // to the graphics queue. models that became ready during this call are appended to readyModels,
+        // requests that failed to parse to failedLoads
+        void update(
+            const UploadBudget& budget,
+            std::vector<std::shared_ptr<BEModel>>& readyModels,
+            std::vector<FailedLoad>& failedLoads
+        );
+
+        // requests still being parsed or uploaded
+        size_t pendingCount() const;
+        // blocks until every request made so far is ready or has failed, used when a frame can't be drawn
+        // without them
+        void flush(std::vector<FailedLoad>& failedLoads);
+
+    private:
+        struct ParseRequest
+        {
+            std::shared_ptr<BEModel> model;
+            std::string filePath;
+            BEModel::ImportSettings settings;
+        };
+
+        struct ParsedModel
+        {
+            std::shared_ptr<BEModel> model;
+            std::string filePath;
+            BEModel::Builder builder;
+            std::string error;
+        };
+
+        struct Upload
+        {
+            std::vector<std::shared_ptr<BEModel>> models;
+            std::vector<std::unique_ptr<BEBuffer>> stagingBuffers;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VkFence fence = VK_NULL_HANDLE;
+        };
+
+        void workerLoop();
+        void retireUploads(bool wait, std::vector<std::shared_ptr<BEModel>>& readyModels);
+
+        BEDevice& beDevice;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+
+        std::vector<std::thread> workers;
+        mutable std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<ParseRequest> parseQueue;
+        std::deque<ParsedModel> parsedQueue;
+        size_t parsingCount = 0;
+        bool stopping = false;
+
+        // only touched by the thread calling update
+        std::deque<Upload> uploads;
+    };
+}
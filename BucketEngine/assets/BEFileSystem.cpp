@@ -0,0 +1,85 @@
+﻿#include "BEFileSystem.hpp"
+
+// std
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace bucketengine
+{
+    std::mutex BEFileSystem::mountMutex{};
+    std::vector<std::shared_ptr<const BEAssetArchive>> BEFileSystem::archives{};
+
+    void BEFileSystem::mount(std::shared_ptr<const BEAssetArchive> archive)
+    {
+        std::lock_guard<std::mutex> lock{mountMutex};
+        archives.insert(archives.begin(), std::move(archive));
+    }
+
+    void BEFileSystem::unmountAll()
+    {
+        std::lock_guard<std::mutex> lock{mountMutex};
+        archives.clear();
+    }
+
+    bool BEFileSystem::exists(const std::string& path)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mountMutex};
+            for (const auto& archive : archives)
+            {
+                if (archive->find(path) != nullptr)
+                {
+                    return true;
+                }
+            }
+        }
+
+        std::error_code error;
+        return std::filesystem::is_regular_file(path, error);
+    }
+
+    BEFileData BEFileSystem::readFile(const std::string& path)
+    {
+        std::shared_ptr<const BEAssetArchive> archive{};
+        const BEAssetArchive::Entry* entry = nullptr;
+        {
+            std::lock_guard<std::mutex> lock{mountMutex};
+            for (const auto& mounted : archives)
+            {
+                entry = mounted->find(path);
+                if (entry != nullptr)
+                {
+                    archive = mounted;
+                    break;
+                }
+            }
+        }
+
+        // decompressing or copying happens outside the lock, the shared pointer keeps the
+        // archive mapped even if it is unmounted meanwhile
+        if (entry != nullptr)
+        {
+            if (entry->compression == BEAssetArchive::Compression::None)
+            {
+                const char* bytes = archive->view(*entry);
+                return BEFileData{std::move(archive), bytes, static_cast<size_t>(entry->size)};
+            }
+
+            std::vector<char> bytes;
+            archive->read(*entry, bytes);
+            return BEFileData{std::move(bytes)};
+        }
+
+        std::ifstream file{path, std::ios::ate | std::ios::binary};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("failed to open file: " + path);
+        }
+
+        std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        return BEFileData{std::move(bytes)};
+    }
+}
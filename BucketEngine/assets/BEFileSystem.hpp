@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include "BEAssetArchive.hpp"
+
+// std
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bucketengine
+{
+    // the contents of one file. uncompressed archive entries point straight into the archive's
+    // mapping and hold a reference to keep it mapped, everything else owns a copy of its bytes
+    class BEFileData
+    {
+    public:
+        BEFileData() = default;
+        explicit BEFileData(std::vector<char> bytes) : owned{std::move(bytes)} {}
+        BEFileData(std::shared_ptr<const BEAssetArchive> archive, const char* bytes, size_t size)
+            : archive{std::move(archive)}, borrowed{bytes}, borrowedSize{size} {}
+
+        const char* data() const { return archive ? borrowed : owned.data(); }
+        size_t size() const { return archive ? borrowedSize : owned.size(); }
+        bool isMapped() const { return archive != nullptr; }
+
+    private:
+        std::shared_ptr<const BEAssetArchive> archive{};
+        const char* borrowed = nullptr;
+        size_t borrowedSize = 0;
+        std::vector<char> owned{};
+    };
+
+    // resolves asset paths against the mounted archives, most recently mounted first, and falls
+    // back to loose files on disk so development builds work without packing anything
+    class BEFileSystem
+    {
+    public:
+        static void mount(std::shared_ptr<const BEAssetArchive> archive);
+        static void unmountAll();
+
+        static bool exists(const std::string& path);
+
+        // throws if the path is in no archive and can't be opened from disk
+        static BEFileData readFile(const std::string& path);
+
+    private:
+        // file reads happen on the asset streaming workers as well as the main thread
+        static std::mutex mountMutex;
+        static std::vector<std::shared_ptr<const BEAssetArchive>> archives;
+    };
+}
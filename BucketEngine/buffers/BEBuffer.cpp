@@ -45,8 +45,9 @@ namespace bucketengine
     BEBuffer::~BEBuffer()
     {
         unmap();
-        vkDestroyBuffer(beDevice.device(), buffer, nullptr);
-        vkFreeMemory(beDevice.device(), memory, nullptr);
+        // frames in flight may still read the buffer, it's destroyed once they have finished
+        beDevice.deletionQueue().retireBuffer(buffer);
+        beDevice.deletionQueue().retireMemory(memory);
     }
 
     /**
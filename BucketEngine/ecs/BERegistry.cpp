@@ -0,0 +1,119 @@
+﻿#include "BERegistry.hpp"
+
+namespace bucketengine
+{
+    Entity BERegistry::create()
+    {
+        Entity entity;
+        if (freeCount > MIN_FREE_SLOTS)
+        {
+            uint32_t index = freeHead;
+            Entity link = slots[index];
+            freeHead = entityIndex(link);
+            if (freeHead == NO_SLOT)
+            {
+                freeTail = NO_SLOT;
+            }
+            freeCount--;
+            entity = makeEntity(index, entityGeneration(link));
+            slots[index] = entity;
+        }
+        else
+        {
+            assert(slots.size() < MAX_SLOTS && "Ran out of entity slots");
+            entity = makeEntity(static_cast<uint32_t>(slots.size()), 0);
+            slots.push_back(entity);
+        }
+
+        alive.insert(entity);
+        return entity;
+    }
+
+    void BERegistry::create(Entity* entities, size_t count)
+    {
+        size_t reusable = freeCount > MIN_FREE_SLOTS ? freeCount - MIN_FREE_SLOTS : 0;
+        alive.reserve(alive.size() + count);
+        if (count > reusable)
+        {
+            slots.reserve(slots.size() + count - reusable);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            entities[i] = create();
+        }
+    }
+
+    void BERegistry::destroy(Entity entity)
+    {
+        assert(valid(entity) && "Cannot destroy an entity that doesn't exist");
+        for (auto& componentPool : pools)
+        {
+            if (componentPool != nullptr && componentPool->contains(entity))
+            {
+                componentPool->remove(entity);
+            }
+        }
+        alive.remove(entity);
+        release(entity);
+    }
+
+    void BERegistry::destroy(const Entity* entities, size_t count)
+    {
+        for (auto& componentPool : pools)
+        {
+            if (componentPool == nullptr || componentPool->empty()) continue;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                assert(valid(entities[i]) && "Cannot destroy an entity that doesn't exist");
+                if (componentPool->contains(entities[i]))
+                {
+                    componentPool->remove(entities[i]);
+                }
+            }
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            assert(valid(entities[i]) && "Cannot destroy an entity that doesn't exist or is in the batch twice");
+            alive.remove(entities[i]);
+            release(entities[i]);
+        }
+    }
+
+    void BERegistry::clear()
+    {
+        for (auto& componentPool : pools)
+        {
+            if (componentPool != nullptr)
+            {
+                componentPool->clear();
+            }
+        }
+
+        // every slot moves to the free list so handles from before the clear stay invalid
+        for (Entity entity : alive.entities())
+        {
+            release(entity);
+        }
+        alive.clear();
+    }
+
+    void BERegistry::release(Entity entity)
+    {
+        uint32_t index = entityIndex(entity);
+        slots[index] = makeEntity(NO_SLOT, entityGeneration(entity) + 1);
+
+        if (freeTail != NO_SLOT)
+        {
+            slots[freeTail] = makeEntity(index, entityGeneration(slots[freeTail]));
+        }
+        else
+        {
+            freeHead = index;
+        }
+        freeTail = index;
+        freeCount++;
+    }
+}
@@ -0,0 +1,446 @@
+﻿#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bucketengine
+{
+    // entities are plain handles, all of their state lives in the registry's component pools. the low
+    // bits index a slot in the registry and the high bits are the slot's generation, which changes
+    // every time the slot is reused, so a handle kept after its entity was destroyed never matches
+    // the entity living in the slot now
+    using Entity = uint32_t;
+    constexpr uint32_t ENTITY_INDEX_BITS = 20;
+    constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+    constexpr uint32_t ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+    // its index is never handed out, so it can't collide with a living entity
+    constexpr Entity NULL_ENTITY = ~Entity{0};
+
+    constexpr uint32_t entityIndex(Entity entity) { return entity & ENTITY_INDEX_MASK; }
+    constexpr uint32_t entityGeneration(Entity entity) { return entity >> ENTITY_INDEX_BITS; }
+    constexpr Entity makeEntity(uint32_t index, uint32_t generation)
+    {
+        return (generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS | (index & ENTITY_INDEX_MASK);
+    }
+
+    // maps entity indices to positions in a dense array. the dense array holds every member packed
+    // together so iterating a pool never visits an entity that isn't in it, and lookups go through
+    // a paged sparse array so huge indices don't need one huge allocation. the dense array keeps
+    // the full handles, so a stale handle whose slot was reused isn't mistaken for a member
+    class BESparseSet
+    {
+    public:
+        BESparseSet() = default;
+        virtual ~BESparseSet() = default;
+
+        BESparseSet(const BESparseSet&) = delete;
+        BESparseSet& operator=(const BESparseSet&) = delete;
+
+        bool contains(Entity entity) const
+        {
+            uint32_t slot = entityIndex(entity);
+            size_t page = slot / PAGE_SIZE;
+            if (page >= sparse.size() || sparse[page] == nullptr) return false;
+
+            uint32_t position = sparse[page][slot % PAGE_SIZE];
+            return position != INVALID_INDEX && dense[position] == entity;
+        }
+
+        // position of the entity in the dense array, the entity must be in the set
+        size_t index(Entity entity) const
+        {
+            assert(contains(entity) && "Entity is not in this set");
+            uint32_t slot = entityIndex(entity);
+            return sparse[slot / PAGE_SIZE][slot % PAGE_SIZE];
+        }
+
+        size_t size() const { return dense.size(); }
+        bool empty() const { return dense.empty(); }
+        const Entity* data() const { return dense.data(); }
+        const std::vector<Entity>& entities() const { return dense; }
+
+        // changes whenever a member is added or removed, so systems can cache derived data and
+        // cheaply tell when it went stale. also invalidates pointers into derived pools
+        uint64_t version() const { return changes; }
+
+        // virtual so the registry can drop a destroyed entity from every pool without knowing the types
+        virtual void remove(Entity entity)
+        {
+            swapAndPop(entity);
+        }
+
+        virtual void reserve(size_t capacity)
+        {
+            dense.reserve(capacity);
+        }
+
+        virtual void clear()
+        {
+            for (Entity entity : dense)
+            {
+                uint32_t slot = entityIndex(entity);
+                sparse[slot / PAGE_SIZE][slot % PAGE_SIZE] = INVALID_INDEX;
+            }
+            dense.clear();
+            changes++;
+        }
+
+    protected:
+        static constexpr size_t PAGE_SIZE = 4096;
+        static constexpr uint32_t INVALID_INDEX = ~uint32_t{0};
+
+        void insert(Entity entity)
+        {
+            assert(entity != NULL_ENTITY && "Cannot add the null entity to a set");
+            assert(!contains(entity) && "Entity is already in this set");
+            pageFor(entity)[entityIndex(entity) % PAGE_SIZE] = static_cast<uint32_t>(dense.size());
+            dense.push_back(entity);
+            changes++;
+        }
+
+        // moves the last member into the removed member's slot, returns the slot so derived pools
+        // can move their component data the same way
+        size_t swapAndPop(Entity entity)
+        {
+            size_t removed = index(entity);
+            Entity last = dense.back();
+
+            uint32_t lastSlot = entityIndex(last);
+            uint32_t removedSlot = entityIndex(entity);
+            dense[removed] = last;
+            sparse[lastSlot / PAGE_SIZE][lastSlot % PAGE_SIZE] = static_cast<uint32_t>(removed);
+            sparse[removedSlot / PAGE_SIZE][removedSlot % PAGE_SIZE] = INVALID_INDEX;
+            dense.pop_back();
+            changes++;
+            return removed;
+        }
+
+    private:
+        uint32_t* pageFor(Entity entity)
+        {
+            size_t page = entityIndex(entity) / PAGE_SIZE;
+            if (page >= sparse.size())
+            {
+                sparse.resize(page + 1);
+            }
+            if (sparse[page] == nullptr)
+            {
+                sparse[page] = std::make_unique<uint32_t[]>(PAGE_SIZE);
+                std::fill(sparse[page].get(), sparse[page].get() + PAGE_SIZE, INVALID_INDEX);
+            }
+            return sparse[page].get();
+        }
+
+        std::vector<std::unique_ptr<uint32_t[]>> sparse{};
+        std::vector<Entity> dense{};
+        uint64_t changes = 0;
+    };
+
+    // one dense array of components per type, kept in the same order as the set's entities
+    template <typename T>
+    class BEComponentPool : public BESparseSet
+    {
+    public:
+        template <typename... Args>
+        T& emplace(Entity entity, Args&&... args)
+        {
+            insert(entity);
+            // aggregates can't be constructed with parentheses until c++20
+            if constexpr (std::is_aggregate_v<T>)
+            {
+                components.push_back(T{std::forward<Args>(args)...});
+            }
+            else
+            {
+                components.emplace_back(std::forward<Args>(args)...);
+            }
+            return components.back();
+        }
+
+        T& get(Entity entity) { return components[index(entity)]; }
+        const T& get(Entity entity) const { return components[index(entity)]; }
+
+        T* tryGet(Entity entity) { return contains(entity) ? &components[index(entity)] : nullptr; }
+        const T* tryGet(Entity entity) const { return contains(entity) ? &components[index(entity)] : nullptr; }
+
+        // components in dense order, component i belongs to entities()[i]
+        T* raw() { return components.data(); }
+        const T* raw() const { return components.data(); }
+
+        void remove(Entity entity) override
+        {
+            size_t removed = swapAndPop(entity);
+            if (removed != components.size() - 1)
+            {
+                components[removed] = std::move(components.back());
+            }
+            components.pop_back();
+        }
+
+        void reserve(size_t capacity) override
+        {
+            BESparseSet::reserve(capacity);
+            components.reserve(capacity);
+        }
+
+        void clear() override
+        {
+            BESparseSet::clear();
+            components.clear();
+        }
+
+    private:
+        std::vector<T> components{};
+    };
+
+    template <typename... Components>
+    class BEView;
+
+    // owns every entity and component. components are stored per type in dense arrays so systems
+    // iterate contiguous memory instead of chasing a pointer per object
+    class BERegistry
+    {
+    public:
+        BERegistry() = default;
+
+        BERegistry(const BERegistry&) = delete;
+        BERegistry& operator=(const BERegistry&) = delete;
+
+        // reuses the slots of destroyed entities, oldest first, once enough of them are waiting
+        Entity create();
+        // removes the entity and all of its components, its handle stops being valid
+        void destroy(Entity entity);
+        // false for handles of destroyed entities, even once their slot holds a new entity
+        bool valid(Entity entity) const
+        {
+            uint32_t index = entityIndex(entity);
+            return index < slots.size() && slots[index] == entity;
+        }
+
+        /**
+         * Create a batch of entities, with storage for all of them reserved up front.
+         *
+         * @param entities Receives count handles
+         * @param count Number of entities to create
+         */
+        void create(Entity* entities, size_t count);
+
+        /**
+         * Destroy a batch of entities. Each component pool is visited once for the whole batch
+         * instead of once per entity.
+         *
+         * @param entities Handles of living entities, without duplicates
+         * @param count Number of handles
+         */
+        void destroy(const Entity* entities, size_t count);
+
+        // number of living entities
+        size_t size() const { return alive.size(); }
+        const std::vector<Entity>& entities() const { return alive.entities(); }
+        void clear();
+
+        template <typename T, typename... Args>
+        T& emplace(Entity entity, Args&&... args)
+        {
+            assert(valid(entity) && "Cannot add a component to a destroyed entity");
+            return pool<T>().emplace(entity, std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        void remove(Entity entity)
+        {
+            BEComponentPool<T>* componentPool = findPool<T>();
+            if (componentPool != nullptr && componentPool->contains(entity))
+            {
+                componentPool->remove(entity);
+            }
+        }
+
+        template <typename T>
+        bool has(Entity entity) const
+        {
+            const BEComponentPool<T>* componentPool = findPool<T>();
+            return componentPool != nullptr && componentPool->contains(entity);
+        }
+
+        template <typename T>
+        T& get(Entity entity)
+        {
+            assert(has<T>(entity) && "Entity doesn't have the requested component");
+            return findPool<T>()->get(entity);
+        }
+
+        template <typename T>
+        const T& get(Entity entity) const
+        {
+            assert(has<T>(entity) && "Entity doesn't have the requested component");
+            return findPool<T>()->get(entity);
+        }
+
+        template <typename T>
+        T* tryGet(Entity entity)
+        {
+            BEComponentPool<T>* componentPool = findPool<T>();
+            return componentPool != nullptr ? componentPool->tryGet(entity) : nullptr;
+        }
+
+        template <typename T>
+        const T* tryGet(Entity entity) const
+        {
+            const BEComponentPool<T>* componentPool = findPool<T>();
+            return componentPool != nullptr ? componentPool->tryGet(entity) : nullptr;
+        }
+
+        // reserve room for a batch of entities and components before adding them. once every pool
+        // has room for the most entities alive at once, creating and destroying never allocates
+        void reserve(size_t capacity)
+        {
+            alive.reserve(capacity);
+            slots.reserve(std::min<size_t>(capacity + MIN_FREE_SLOTS, MAX_SLOTS));
+        }
+
+        template <typename T>
+        void reserve(size_t capacity) { pool<T>().reserve(capacity); }
+
+        template <typename T>
+        BEComponentPool<T>& pool()
+        {
+            size_t id = componentTypeId<T>();
+            if (id >= pools.size())
+            {
+                pools.resize(id + 1);
+            }
+            if (pools[id] == nullptr)
+            {
+                pools[id] = std::make_unique<BEComponentPool<T>>();
+            }
+            return static_cast<BEComponentPool<T>&>(*pools[id]);
+        }
+
+        // iterates every entity that has all of the given components
+        template <typename... Components>
+        BEView<Components...> view()
+        {
+            return BEView<Components...>{pool<Components>()...};
+        }
+
+    private:
+        // each component type gets a small dense id the first time it's used, the id indexes pools
+        static size_t nextComponentTypeId()
+        {
+            static std::atomic<size_t> counter{0};
+            return counter++;
+        }
+
+        template <typename T>
+        static size_t componentTypeId()
+        {
+            static const size_t id = nextComponentTypeId();
+            return id;
+        }
+
+        template <typename T>
+        BEComponentPool<T>* findPool()
+        {
+            size_t id = componentTypeId<T>();
+            return id < pools.size() ? static_cast<BEComponentPool<T>*>(pools[id].get()) : nullptr;
+        }
+
+        template <typename T>
+        const BEComponentPool<T>* findPool() const
+        {
+            size_t id = componentTypeId<T>();
+            return id < pools.size() ? static_cast<const BEComponentPool<T>*>(pools[id].get()) : nullptr;
+        }
+
+        // the set of living entities, it has no component data of its own
+        struct EntitySet : BESparseSet
+        {
+            using BESparseSet::insert;
+        };
+
+        // puts the destroyed entity's slot at the back of the free list with its next generation
+        void release(Entity entity);
+
+        // marks the end of the free list, the null entity's index is never a real slot
+        static constexpr uint32_t NO_SLOT = ENTITY_INDEX_MASK;
+        static constexpr size_t MAX_SLOTS = ENTITY_INDEX_MASK;
+        // freed slots wait until this many have piled up, so a slot is only reused after at least
+        // this many other destructions and its generation takes that much longer to wrap around
+        static constexpr size_t MIN_FREE_SLOTS = 1024;
+
+        // the handle of the entity in each slot. a free slot keeps the generation its next entity
+        // will get, and the index of the next free slot instead of its own
+        std::vector<Entity> slots{};
+        uint32_t freeHead = NO_SLOT;
+        uint32_t freeTail = NO_SLOT;
+        size_t freeCount = 0;
+
+        EntitySet alive{};
+        std::vector<std::unique_ptr<BESparseSet>> pools{};
+    };
+
+    // walks the smallest of its pools and looks the entity up in the others, so the cost scales
+    // with the rarest component rather than the total number of entities. entities and components
+    // must not be added or removed from the viewed pools while iterating
+    template <typename... Components>
+    class BEView
+    {
+    public:
+        explicit BEView(BEComponentPool<Components>&... pools) : pools{&pools...} {}
+
+        // fn(Entity, Components&...)
+        template <typename Fn>
+        void each(Fn&& fn)
+        {
+            if constexpr (sizeof...(Components) == 1)
+            {
+                // a single pool is already exactly the set we want, walk both arrays in lockstep
+                auto& componentPool = *std::get<0>(pools);
+                const Entity* entities = componentPool.data();
+                auto* components = componentPool.raw();
+                for (size_t i = 0, count = componentPool.size(); i < count; i++)
+                {
+                    fn(entities[i], components[i]);
+                }
+            }
+            else
+            {
+                const BESparseSet* smallest = smallestPool();
+                const Entity* entities = smallest->data();
+                for (size_t i = 0, count = smallest->size(); i < count; i++)
+                {
+                    Entity entity = entities[i];
+                    if ((std::get<BEComponentPool<Components>*>(pools)->contains(entity) && ...))
+                    {
+                        fn(entity, std::get<BEComponentPool<Components>*>(pools)->get(entity)...);
+                    }
+                }
+            }
+        }
+
+        // an upper bound on the number of entities the view visits
+        size_t sizeHint() const { return smallestPool()->size(); }
+
+    private:
+        const BESparseSet* smallestPool() const
+        {
+            const BESparseSet* smallest = nullptr;
+            ((smallest = (smallest == nullptr || std::get<BEComponentPool<Components>*>(pools)->size() < smallest->size())
+                ? std::get<BEComponentPool<Components>*>(pools)
+                : smallest), ...);
+            return smallest;
+        }
+
+        std::tuple<BEComponentPool<Components>*...> pools;
+    };
+}
@@ -0,0 +1,242 @@
+﻿#include "BEBoundsSystem.hpp"
+
+#include "../utils/BEParallel.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace bucketengine
+{
+    namespace
+    {
+        // narrow phase for a candidate the tree found, toModel is the inverse of its world matrix.
+        // returns the distance of the hit and fills hit if the ray hits the model closer than
+        // maxDistance, returns maxDistance otherwise
+        float intersectCandidate(
+            const BEModel& model,
+            const glm::mat4& toModel,
+            Entity entity,
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            float maxDistance,
+            RaycastHit& hit)
+        {
+            // the transform is affine, so distances along the model space ray match the world ones
+            glm::vec3 modelOrigin{toModel * glm::vec4{origin, 1.f}};
+            glm::vec3 modelDirection{toModel * glm::vec4{direction, 0.f}};
+
+            if (const BEMeshBVH* meshBVH = model.getRayBVH())
+            {
+                MeshRayHit meshHit{};
+                if (!meshBVH->intersect(modelOrigin, modelDirection, maxDistance, meshHit)) return maxDistance;
+
+                hit = RaycastHit{entity, meshHit.distance, meshHit.triangle, meshHit.barycentrics};
+                return meshHit.distance;
+            }
+
+            // with the ray in model space the model's own box is an exact oriented box test
+            float hitDistance;
+            if (model.getBounds().intersectRay(modelOrigin, 1.f / modelDirection, maxDistance, hitDistance)
+                && hitDistance < maxDistance)
+            {
+                hit = RaycastHit{entity, hitDistance, BEMeshBVH::NO_TRIANGLE, glm::vec2{}};
+                return hitDistance;
+            }
+            return maxDistance;
+        }
+    }
+
+    void BEBoundsSystem::update(BERegistry& registry, const std::vector<Entity>& movedEntities)
+    {
+        auto& models = registry.pool<ModelComponent>();
+        auto& worlds = registry.pool<WorldTransformComponent>();
+
+        if (models.version() != modelVersion || worlds.version() != worldVersion)
+        {
+            syncProxies(registry);
+            modelVersion = models.version();
+            worldVersion = worlds.version();
+        }
+        else if (!waitingForModel.empty())
+        {
+            scratch.swap(waitingForModel);
+            waitingForModel.clear();
+            for (Entity entity : scratch)
+            {
+                const ModelComponent* model = models.tryGet(entity);
+                if (model == nullptr || model->model == nullptr) continue;
+
+                if (model->model->isReady())
+                {
+                    addProxy(entity, computeWorldBounds(worlds.get(entity), *model));
+                }
+                else
+                {
+                    waitingForModel.push_back(entity);
+                }
+            }
+        }
+
+        for (Entity entity : movedEntities)
+        {
+            if (const uint32_t* proxy = proxies.tryGet(entity))
+            {
+                tree.moveProxy(*proxy, computeWorldBounds(worlds.get(entity), models.get(entity)));
+            }
+        }
+    }
+
+    bool BEBoundsSystem::raycast(
+        BERegistry& registry,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        RaycastHit& hit,
+        float maxDistance
+    ) const
+    {
+        RaycastHit closest{};
+        traceRay(registry.pool<ModelComponent>(), registry.pool<WorldTransformComponent>(), origin, direction, maxDistance, closest);
+
+        if (closest.entity == NULL_ENTITY) return false;
+
+        hit = closest;
+        return true;
+    }
+
+    void BEBoundsSystem::raycastBatch(
+        BERegistry& registry,
+        const Ray* rays,
+        size_t count,
+        RaycastHit* hits,
+        SimdLevel level
+    ) const
+    {
+        // looked up before going wide, pool() creates missing pools and the workers may only read
+        const auto& models = registry.pool<ModelComponent>();
+        const auto& worlds = registry.pool<WorldTransformComponent>();
+
+        parallelFor(count, RAYCAST_GRAIN, [&](size_t begin, size_t end)
+        {
+            RayPacket packet;
+            for (size_t first = begin; first < end; first += RayPacket::MAX_RAYS)
+            {
+                const size_t packetSize = std::min<size_t>(RayPacket::MAX_RAYS, end - first);
+                for (size_t i = 0; i < packetSize; i++)
+                {
+                    hits[first + i] = RaycastHit{};
+                }
+
+                // rays heading into different octants part ways at the first few nodes, after which
+                // the packet drags every ray through every other ray's subtrees
+                bool coherent = true;
+                const glm::vec3& leadDirection = rays[first].direction;
+                for (size_t i = 1; i < packetSize && coherent; i++)
+                {
+                    const glm::vec3& direction = rays[first + i].direction;
+                    coherent = std::signbit(direction.x) == std::signbit(leadDirection.x)
+                        && std::signbit(direction.y) == std::signbit(leadDirection.y)
+                        && std::signbit(direction.z) == std::signbit(leadDirection.z);
+                }
+                if (!coherent)
+                {
+                    for (size_t i = first; i < first + packetSize; i++)
+                    {
+                        traceRay(models, worlds, rays[i].origin, rays[i].direction, rays[i].maxDistance, hits[i]);
+                    }
+                    continue;
+                }
+
+                packet.clear();
+                for (size_t i = first; i < first + packetSize; i++)
+                {
+                    packet.add(rays[i].origin, rays[i].direction, rays[i].maxDistance);
+                }
+
+                // every ray reaching a leaf is handed over in a row, so each entity's inverse
+                // transform is computed once per packet rather than once per ray
+                Entity cachedEntity = NULL_ENTITY;
+                glm::mat4 toModel{1.f};
+                tree.raycastPacket(packet, [&](uint32_t ray, Entity entity, float closestDistance)
+                {
+                    if (entity != cachedEntity)
+                    {
+                        toModel = glm::inverse(worlds.get(entity).matrix);
+                        cachedEntity = entity;
+                    }
+                    const Ray& packetRay = rays[first + ray];
+                    return intersectCandidate(
+                        *models.get(entity).model,
+                        toModel,
+                        entity,
+                        packetRay.origin,
+                        packetRay.direction,
+                        closestDistance,
+                        hits[first + ray]);
+                }, level);
+            }
+        });
+    }
+
+    void BEBoundsSystem::traceRay(
+        const BEComponentPool<ModelComponent>& models,
+        const BEComponentPool<WorldTransformComponent>& worlds,
+        const glm::vec3& origin,
+        const glm::vec3& direction,
+        float maxDistance,
+        RaycastHit& hit
+    ) const
+    {
+        tree.raycast(origin, direction, maxDistance, [&](Entity entity, float closestDistance)
+        {
+            glm::mat4 toModel = glm::inverse(worlds.get(entity).matrix);
+            return intersectCandidate(*models.get(entity).model, toModel, entity, origin, direction, closestDistance, hit);
+        });
+    }
+
+    AABB BEBoundsSystem::computeWorldBounds(const WorldTransformComponent& world, const ModelComponent& model)
+    {
+        if (model.model == nullptr || !model.model->isReady()) return AABB{};
+        return model.model->getBounds().transformed(world.matrix);
+    }
+
+    void BEBoundsSystem::syncProxies(BERegistry& registry)
+    {
+        auto& models = registry.pool<ModelComponent>();
+        auto& worlds = registry.pool<WorldTransformComponent>();
+
+        // drop entities that were destroyed or lost their model or transform
+        scratch.assign(proxies.entities().begin(), proxies.entities().end());
+        for (Entity entity : scratch)
+        {
+            const ModelComponent* model = models.tryGet(entity);
+            if (model == nullptr || model->model == nullptr || !worlds.contains(entity))
+            {
+                tree.destroyProxy(proxies.get(entity));
+                proxies.remove(entity);
+            }
+        }
+
+        waitingForModel.clear();
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            Entity entity = models.entities()[i];
+            const ModelComponent& model = models.raw()[i];
+            if (proxies.contains(entity) || model.model == nullptr || !worlds.contains(entity)) continue;
+
+            if (model.model->isReady())
+            {
+                addProxy(entity, computeWorldBounds(worlds.get(entity), model));
+            }
+            else
+            {
+                waitingForModel.push_back(entity);
+            }
+        }
+    }
+
+    void BEBoundsSystem::addProxy(Entity entity, const AABB& bounds)
+    {
+        proxies.emplace(entity, tree.createProxy(bounds, entity));
+    }
+}
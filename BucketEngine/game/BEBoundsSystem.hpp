@@ -0,0 +1,124 @@
+﻿#pragma once
+
+#include "BEComponents.hpp"
+#include "../ecs/BERegistry.hpp"
+#include "../scene/BEBoundsTree.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace bucketengine
+{
+    struct Ray
+    {
+        glm::vec3 origin{};
+        // normalised
+        glm::vec3 direction{0.f, 0.f, 1.f};
+        float maxDistance = std::numeric_limits<float>::max();
+    };
+
+    struct RaycastHit
+    {
+        Entity entity = NULL_ENTITY;
+        float distance = 0.f;
+        // the model's triangle and the barycentrics of the hit on it, NO_TRIANGLE when the model
+        // has no ray bvh and only its bounds were hit
+        uint32_t triangle = BEMeshBVH::NO_TRIANGLE;
+        glm::vec2 barycentrics{};
+    };
+
+    // keeps a BEBoundsTree of the world space bounds of every entity with a model, so rays and
+    // other spatial queries don't have to visit every object. run it after BETransformSystem, only
+    // entities that moved that frame are refit
+    class BEBoundsSystem
+    {
+    public:
+        // rays per parallelFor range in raycastBatch, a multiple of the packet size
+        static constexpr size_t RAYCAST_GRAIN = 16 * RayPacket::MAX_RAYS;
+
+        BEBoundsSystem() = default;
+
+        BEBoundsSystem(const BEBoundsSystem&) = delete;
+        BEBoundsSystem& operator=(const BEBoundsSystem&) = delete;
+
+        // movedEntities is BETransformSystem::getMovedEntities
+        void update(BERegistry& registry, const std::vector<Entity>& movedEntities);
+
+        /**
+         * Find the closest entity a ray hits.
+         *
+         * The tree narrows the search down to a few candidates whose rays are moved into model
+         * space. Models imported with a ray bvh are then tested against their triangles, the rest
+         * against their model space bounds, so rotated and offset meshes are hit where they
+         * actually are.
+         *
+         * @param registry The registry passed to update
+         * @param origin Start of the ray in world space
+         * @param direction Normalised direction of the ray
+         * @param hit Receives the closest hit, untouched when nothing is hit
+         * @param maxDistance (Optional) Ignore anything further than this
+         *
+         * @return true if the ray hit an entity
+         */
+        bool raycast(
+            BERegistry& registry,
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            RaycastHit& hit,
+            float maxDistance = std::numeric_limits<float>::max()
+        ) const;
+
+        /**
+         * Cast a batch of rays, each gets the same result raycast would give it.
+         *
+         * Consecutive rays are traced through the tree together in packets of RayPacket::MAX_RAYS,
+         * so callers should keep rays that start close together and point the same way next to
+         * each other. Packets whose rays point into different octants are traced one ray at a
+         * time instead, and the batch is split over the parallelFor workers, so incoherent
+         * batches still scale with the threads.
+         *
+         * @param registry The registry passed to update, it must not be modified during the call
+         * @param rays The rays to cast
+         * @param count Number of rays
+         * @param hits Receives count hits, hit i has a NULL_ENTITY entity if ray i hit nothing
+         * @param level (Optional) Forces the simd path of the packet traversal
+         */
+        void raycastBatch(
+            BERegistry& registry,
+            const Ray* rays,
+            size_t count,
+            RaycastHit* hits,
+            SimdLevel level = getSimdLevel()
+        ) const;
+
+        const BEBoundsTree& getTree() const { return tree; }
+
+        // world space bounds of an entity's model, empty if it has no ready model
+        static AABB computeWorldBounds(const WorldTransformComponent& world, const ModelComponent& model);
+
+    private:
+        // raycast with the pools already looked up, hit is only written when something is hit
+        void traceRay(
+            const BEComponentPool<ModelComponent>& models,
+            const BEComponentPool<WorldTransformComponent>& worlds,
+            const glm::vec3& origin,
+            const glm::vec3& direction,
+            float maxDistance,
+            RaycastHit& hit
+        ) const;
+
+        void syncProxies(BERegistry& registry);
+        void addProxy(Entity entity, const AABB& bounds);
+
+        BEBoundsTree tree{};
+        // the tree proxy of each entity in the tree
+        BEComponentPool<uint32_t> proxies{};
+        // entities whose model is still streaming in, added once it's ready
+        std::vector<Entity> waitingForModel{};
+        std::vector<Entity> scratch{};
+
+        uint64_t modelVersion = ~uint64_t{0};
+        uint64_t worldVersion = ~uint64_t{0};
+    };
+}
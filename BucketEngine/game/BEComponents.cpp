@@ -1,8 +1,11 @@
-﻿#include "BEGameObject.hpp"
+﻿#include "BEComponents.hpp"
+
+// std
+#include <cstring>
 
 namespace bucketengine
 {
-    glm::mat4 TransformComponent::mat4()
+    glm::mat4 TransformComponent::mat4() const
     {
         const float c3 = glm::cos(rotation.z);
         const float s3 = glm::sin(rotation.z);
@@ -32,7 +35,7 @@ namespace bucketengine
             {translation.x, translation.y, translation.z, 1.0f}};
     }
 
-    glm::mat3 TransformComponent::normalMatrix()
+    glm::mat3 TransformComponent::normalMatrix() const
     {
         const float c3 = glm::cos(rotation.z);
         const float s3 = glm::sin(rotation.z);
@@ -62,14 +65,20 @@ namespace bucketengine
         };
     }
 
-    BEGameObject BEGameObject::createGameObject()
+    bool TransformComponent::isDirty() const
     {
-        static id_t currentId = 0;
-        return BEGameObject{currentId++};
+        // compared bitwise so a NaN component doesn't make the transform dirty forever
+        return !cacheValid
+            || std::memcmp(&translation, &cachedTranslation, sizeof(glm::vec3)) != 0
+            || std::memcmp(&rotation, &cachedRotation, sizeof(glm::vec3)) != 0
+            || std::memcmp(&scale, &cachedScale, sizeof(glm::vec3)) != 0;
     }
 
-    BEGameObject::id_t BEGameObject::getId()
+    void TransformComponent::markClean()
     {
-        return id;
+        cachedTranslation = translation;
+        cachedRotation = rotation;
+        cachedScale = scale;
+        cacheValid = true;
     }
 }
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "../BEModel.hpp"
+#include "../ecs/BERegistry.hpp"
+
+// libs
+#include <glm/gtc/matrix_transform.hpp>
+
+//std
+#include <cstdint>
+#include <memory>
+
+namespace bucketengine
+{
+    // translation, scale and rotation are relative to the parent when the entity has a ParentComponent.
+    // the world matrices derived from them live in WorldTransformComponent, so the check for what
+    // moved each frame only has to read this small component
+    struct TransformComponent
+    {
+        glm::vec3 translation{};
+        glm::vec3 scale{1.f, 1.f, 1.f};
+        glm::vec3 rotation{};
+
+        // the local matrices, these rotations are interpreted as Extrinsic by reading them right to left (z -> y -> x)
+        // ie: around the global origin.
+        // to interpret the rotation as Intrinsic, we read the angles from left to right instead (x -> y -> z)
+        // ie: around the object itself
+        glm::mat4 mat4() const;
+        glm::mat3 normalMatrix() const;
+
+        // true if translation, rotation or scale changed since the last markClean
+        bool isDirty() const;
+        void markClean();
+
+    private:
+        friend class BETransformSystem;
+        static constexpr uint32_t NO_GRAPH_NODE = ~uint32_t{0};
+
+        // the values the world matrices were computed from
+        glm::vec3 cachedTranslation{};
+        glm::vec3 cachedScale{};
+        glm::vec3 cachedRotation{};
+        // where BETransformSystem keeps this transform in its hierarchy, if it has a parent or children
+        uint32_t graphNode = NO_GRAPH_NODE;
+        bool cacheValid = false;
+    };
+
+    // added and kept up to date by BETransformSystem::update for every entity with a TransformComponent,
+    // read these instead of calling mat4() and normalMatrix() every frame. the normal matrix is kept
+    // as a mat3x4 to match the push constant
+    struct WorldTransformComponent
+    {
+        glm::mat4 matrix{1.f};
+        glm::mat3x4 normalMatrix{1.f};
+    };
+
+    // attaches the entity to another one so it follows it around, both need a TransformComponent.
+    // links to entities without one are ignored and the child is treated as a root
+    struct ParentComponent
+    {
+        Entity parent = NULL_ENTITY;
+    };
+
+    struct ModelComponent
+    {
+        std::shared_ptr<BEModel> model{};
+    };
+
+    struct ColorComponent
+    {
+        glm::vec3 color{};
+    };
+
+    // the light's radius is stored in the transform's x scale
+    struct PointLightComponent
+    {
+        float lightIntensity = 1.0f;
+    };
+}
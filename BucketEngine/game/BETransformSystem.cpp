@@ -0,0 +1,323 @@
+﻿#include "BETransformSystem.hpp"
+
+#include "../utils/BEParallel.hpp"
+#include "../utils/BETransformBatch.hpp"
+
+// std
+#include <algorithm>
+#include <utility>
+
+namespace bucketengine
+{
+    BETransformSystem::BETransformSystem()
+        : localMatrices(BATCH_SIZE), localNormalMatrices(BATCH_SIZE)
+    {
+        pendingEntities.reserve(BATCH_SIZE);
+        pendingTransforms.reserve(BATCH_SIZE);
+        for (auto& input : inputs)
+        {
+            input.resize(BATCH_SIZE);
+        }
+    }
+
+    size_t BETransformSystem::update(BERegistry& registry)
+    {
+        auto& transforms = registry.pool<TransformComponent>();
+        auto& worlds = registry.pool<WorldTransformComponent>();
+
+        if (transforms.version() != transformVersion)
+        {
+            addWorldTransforms(registry);
+            transformVersion = transforms.version();
+        }
+        if (rebuildNeeded || hierarchyChanged(registry))
+        {
+            rebuildHierarchy(registry);
+        }
+
+        movedEntities.clear();
+        size_t updated = 0;
+        registry.view<TransformComponent>().each([this, &worlds, &updated](Entity entity, TransformComponent& transform)
+        {
+            if (!transform.isDirty()) return;
+
+            const size_t i = pendingEntities.size();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                inputs[axis][i] = transform.translation[axis];
+                inputs[3 + axis][i] = transform.rotation[axis];
+                inputs[6 + axis][i] = transform.scale[axis];
+            }
+            pendingEntities.push_back(entity);
+            pendingTransforms.push_back(&transform);
+            updated++;
+
+            if (pendingEntities.size() == BATCH_SIZE)
+            {
+                flush(worlds);
+            }
+        });
+        flush(worlds);
+
+        propagate(worlds);
+        return updated;
+    }
+
+    void BETransformSystem::addWorldTransforms(BERegistry& registry)
+    {
+        auto& transforms = registry.pool<TransformComponent>();
+        auto& worlds = registry.pool<WorldTransformComponent>();
+
+        for (Entity entity : transforms.entities())
+        {
+            if (!worlds.contains(entity))
+            {
+                worlds.emplace(entity);
+                transforms.get(entity).cacheValid = false;
+            }
+        }
+
+        // a removed transform may have been holding part of the hierarchy together
+        for (Entity entity : nodeEntities)
+        {
+            if (!transforms.contains(entity))
+            {
+                rebuildNeeded = true;
+                break;
+            }
+        }
+    }
+
+    bool BETransformSystem::hierarchyChanged(BERegistry& registry) const
+    {
+        const auto& parents = registry.pool<ParentComponent>();
+        if (parents.version() != parentVersion) return true;
+
+        // parents can be changed in place without touching the pool
+        const ParentComponent* links = parents.raw();
+        for (size_t i = 0; i < parentSnapshot.size(); i++)
+        {
+            if (links[i].parent != parentSnapshot[i]) return true;
+        }
+        return false;
+    }
+
+    void BETransformSystem::rebuildHierarchy(BERegistry& registry)
+    {
+        auto& transforms = registry.pool<TransformComponent>();
+        auto& parents = registry.pool<ParentComponent>();
+
+        rebuildNeeded = false;
+        parentVersion = parents.version();
+        parentSnapshot.resize(parents.size());
+        for (size_t i = 0; i < parents.size(); i++)
+        {
+            parentSnapshot[i] = parents.raw()[i].parent;
+        }
+
+        // anything leaving or joining the hierarchy gets new world matrices, so recompute it
+        TransformComponent* transformData = transforms.raw();
+        for (size_t i = 0; i < transforms.size(); i++)
+        {
+            if (transformData[i].graphNode != TransformComponent::NO_GRAPH_NODE)
+            {
+                transformData[i].graphNode = TransformComponent::NO_GRAPH_NODE;
+                transformData[i].cacheValid = false;
+            }
+        }
+
+        auto linkedParent = [&transforms, &parents](Entity entity)
+        {
+            const ParentComponent* link = parents.tryGet(entity);
+            if (link == nullptr || link->parent == entity || !transforms.contains(link->parent))
+            {
+                return NULL_ENTITY;
+            }
+            return link->parent;
+        };
+
+        // depth of every linked child and of the roots above them. each walk stops at the first
+        // ancestor with a known depth, so every link is followed about once
+        depths.clear();
+        uint32_t maxDepth = 0;
+        for (Entity child : parents.entities())
+        {
+            if (!transforms.contains(child) || depths.contains(child) || linkedParent(child) == NULL_ENTITY) continue;
+
+            chain.clear();
+            Entity current = child;
+            uint32_t depth = 0;
+            bool cycle = false;
+            while (true)
+            {
+                if (const uint32_t* known = depths.tryGet(current))
+                {
+                    depth = *known + 1;
+                    break;
+                }
+
+                chain.push_back(current);
+                Entity parent = linkedParent(current);
+                if (parent == NULL_ENTITY) break;
+
+                if (chain.size() > parents.size() + 1)
+                {
+                    assert(false && "Parent links form a cycle");
+                    cycle = true;
+                    break;
+                }
+                current = parent;
+            }
+            // the entities in a cycle are left out of the hierarchy and behave like roots
+            if (cycle) continue;
+
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+            {
+                depths.emplace(*it, depth);
+                maxDepth = std::max(maxDepth, depth);
+                depth++;
+            }
+        }
+
+        // counting sort by depth
+        const size_t nodeCount = depths.size();
+        levelOffsets.assign(nodeCount > 0 ? maxDepth + 2 : 0, 0);
+        for (size_t i = 0; i < nodeCount; i++)
+        {
+            levelOffsets[depths.raw()[i] + 1]++;
+        }
+        for (size_t level = 1; level < levelOffsets.size(); level++)
+        {
+            levelOffsets[level] += levelOffsets[level - 1];
+        }
+
+        std::vector<std::pair<uint32_t, Entity>> sorted(nodeCount);
+        {
+            std::vector<size_t> cursors(levelOffsets.begin(), levelOffsets.end());
+            for (size_t i = 0; i < nodeCount; i++)
+            {
+                sorted[cursors[depths.raw()[i]]++] = {NO_PARENT, depths.entities()[i]};
+            }
+        }
+
+        nodeEntities.resize(nodeCount);
+        nodeParents.resize(nodeCount);
+        for (size_t level = 0; level + 1 < levelOffsets.size(); level++)
+        {
+            auto begin = sorted.begin() + levelOffsets[level];
+            auto end = sorted.begin() + levelOffsets[level + 1];
+
+            // the previous level is final, so children can be grouped by their parent's node
+            if (level > 0)
+            {
+                for (auto it = begin; it != end; ++it)
+                {
+                    it->first = transforms.get(linkedParent(it->second)).graphNode;
+                }
+                std::sort(begin, end);
+            }
+
+            for (auto it = begin; it != end; ++it)
+            {
+                const size_t node = it - sorted.begin();
+                TransformComponent& transform = transforms.get(it->second);
+                transform.graphNode = static_cast<uint32_t>(node);
+                // force the local matrices to be recomputed so the node arrays get filled in
+                transform.cacheValid = false;
+                nodeEntities[node] = it->second;
+                nodeParents[node] = it->first;
+            }
+        }
+
+        nodeLocalMatrices.resize(nodeCount);
+        nodeLocalNormalMatrices.resize(nodeCount);
+        nodeWorldMatrices.resize(nodeCount);
+        nodeWorldNormalMatrices.resize(nodeCount);
+        nodeDirty.assign(nodeCount, 0);
+    }
+
+    void BETransformSystem::propagate(BEComponentPool<WorldTransformComponent>& worlds)
+    {
+        for (size_t level = 0; level + 1 < levelOffsets.size(); level++)
+        {
+            const size_t levelBegin = levelOffsets[level];
+            parallelFor(levelOffsets[level + 1] - levelBegin, PROPAGATION_GRAIN, [this, &worlds, level, levelBegin](size_t begin, size_t end)
+            {
+                for (size_t node = levelBegin + begin; node < levelBegin + end; node++)
+                {
+                    // a root's world matrices are its local ones, flush already stored them
+                    if (level > 0)
+                    {
+                        const uint32_t parent = nodeParents[node];
+                        if (!nodeDirty[node] && !nodeDirty[parent]) continue;
+
+                        // the inverse transpose distributes over the product, so normal matrices
+                        // chain the same way world matrices do
+                        nodeWorldMatrices[node] = nodeWorldMatrices[parent] * nodeLocalMatrices[node];
+                        nodeWorldNormalMatrices[node] = glm::mat3x4{
+                            glm::mat3{nodeWorldNormalMatrices[parent]} * glm::mat3{nodeLocalNormalMatrices[node]}};
+                        nodeDirty[node] = 1;
+                    }
+                    else if (!nodeDirty[node])
+                    {
+                        continue;
+                    }
+
+                    WorldTransformComponent& world = worlds.get(nodeEntities[node]);
+                    world.matrix = nodeWorldMatrices[node];
+                    world.normalMatrix = nodeWorldNormalMatrices[node];
+                }
+            });
+        }
+
+        for (size_t node = 0; node < nodeDirty.size(); node++)
+        {
+            if (nodeDirty[node])
+            {
+                movedEntities.push_back(nodeEntities[node]);
+                nodeDirty[node] = 0;
+            }
+        }
+    }
+
+    void BETransformSystem::flush(BEComponentPool<WorldTransformComponent>& worlds)
+    {
+        if (pendingEntities.empty()) return;
+
+        TransformBatch batch{
+            inputs[0].data(), inputs[1].data(), inputs[2].data(),
+            inputs[3].data(), inputs[4].data(), inputs[5].data(),
+            inputs[6].data(), inputs[7].data(), inputs[8].data(),
+            pendingEntities.size()
+        };
+        computeTransformMatrices(batch, localMatrices.data(), localNormalMatrices.data());
+
+        for (size_t i = 0; i < pendingEntities.size(); i++)
+        {
+            TransformComponent& transform = *pendingTransforms[i];
+            transform.markClean();
+
+            const uint32_t node = transform.graphNode;
+            if (node == TransformComponent::NO_GRAPH_NODE)
+            {
+                WorldTransformComponent& world = worlds.get(pendingEntities[i]);
+                world.matrix = localMatrices[i];
+                world.normalMatrix = localNormalMatrices[i];
+                movedEntities.push_back(pendingEntities[i]);
+                continue;
+            }
+
+            // the world matrices of nodes are worked out by propagate once every local one is known
+            nodeLocalMatrices[node] = localMatrices[i];
+            nodeLocalNormalMatrices[node] = localNormalMatrices[i];
+            if (nodeParents[node] == NO_PARENT)
+            {
+                nodeWorldMatrices[node] = localMatrices[i];
+                nodeWorldNormalMatrices[node] = localNormalMatrices[i];
+            }
+            nodeDirty[node] = 1;
+        }
+        pendingEntities.clear();
+        pendingTransforms.clear();
+    }
+}
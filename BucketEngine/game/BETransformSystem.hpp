@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "BEComponents.hpp"
+#include "../ecs/BERegistry.hpp"
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bucketengine
+{
+    // keeps the WorldTransformComponent of every TransformComponent up to date. run it once per
+    // frame after game logic has moved things and before anything reads the world matrices,
+    // transforms that didn't change since the last pass cost a compare and no trigonometry.
+    //
+    // entities linked with ParentComponent are kept in flat arrays sorted breadth first by depth,
+    // so a parent is always computed before its children. only subtrees below a changed transform
+    // are recomputed, and since nodes at the same depth never depend on each other each level is
+    // spread over the worker threads when it is big enough
+    class BETransformSystem
+    {
+    public:
+        // dirty transforms are gathered into chunks this size and computed with the simd batch kernel
+        static constexpr size_t BATCH_SIZE = 256;
+        // smallest number of nodes in one level worth handing to another thread
+        static constexpr size_t PROPAGATION_GRAIN = 4096;
+
+        BETransformSystem();
+
+        BETransformSystem(const BETransformSystem&) = delete;
+        BETransformSystem& operator=(const BETransformSystem&) = delete;
+
+        // returns the number of transforms whose local matrices had to be recomputed
+        size_t update(BERegistry& registry);
+
+        // every entity whose world matrices changed during the last update, children of moved
+        // parents included. lets other systems follow movement without scanning every transform
+        const std::vector<Entity>& getMovedEntities() const { return movedEntities; }
+
+        // number of transforms in the hierarchy, ie with a parent or children
+        size_t getHierarchySize() const { return nodeEntities.size(); }
+        size_t getHierarchyDepth() const { return levelOffsets.empty() ? 0 : levelOffsets.size() - 1; }
+
+    private:
+        static constexpr uint32_t NO_PARENT = ~uint32_t{0};
+
+        void addWorldTransforms(BERegistry& registry);
+        bool hierarchyChanged(BERegistry& registry) const;
+        void rebuildHierarchy(BERegistry& registry);
+        void propagate(BEComponentPool<WorldTransformComponent>& worlds);
+        void flush(BEComponentPool<WorldTransformComponent>& worlds);
+
+        std::vector<Entity> pendingEntities;
+        std::vector<TransformComponent*> pendingTransforms;
+        // structure of arrays copies of the pending transforms, translation xyz, rotation xyz, scale xyz
+        std::array<std::vector<float>, 9> inputs;
+        std::vector<glm::mat4> localMatrices;
+        std::vector<glm::mat3x4> localNormalMatrices;
+        std::vector<Entity> movedEntities;
+
+        // the hierarchy, node i's parent is always at a lower index. level d is the nodes in
+        // [levelOffsets[d], levelOffsets[d + 1]) and within a level siblings are next to each other
+        std::vector<Entity> nodeEntities;
+        std::vector<uint32_t> nodeParents;
+        std::vector<glm::mat4> nodeLocalMatrices;
+        std::vector<glm::mat3x4> nodeLocalNormalMatrices;
+        std::vector<glm::mat4> nodeWorldMatrices;
+        std::vector<glm::mat3x4> nodeWorldNormalMatrices;
+        std::vector<uint8_t> nodeDirty;
+        std::vector<size_t> levelOffsets;
+
+        // what the hierarchy was built from
+        uint64_t transformVersion = ~uint64_t{0};
+        uint64_t parentVersion = ~uint64_t{0};
+        std::vector<Entity> parentSnapshot;
+        bool rebuildNeeded = true;
+
+        // scratch space for rebuilding
+        BEComponentPool<uint32_t> depths;
+        std::vector<Entity> chain;
+    };
+}
@@ -2,7 +2,7 @@
 
 namespace bucketengine
 {
-    void BEKeyboardMovementController::moveInPlaneXZ(GLFWwindow* window, float deltaTime, BEGameObject& gameObject)
+    void BEKeyboardMovementController::moveInPlaneXZ(GLFWwindow* window, float deltaTime, TransformComponent& transform)
     {
         glm::vec3 rotate{0};
         if (glfwGetKey(window, keys.lookRight) == GLFW_PRESS) rotate.y += 1.f;
@@ -14,16 +14,16 @@ namespace bucketengine
         if (glm::dot(rotate, rotate) > std::numeric_limits<float>::epsilon())
         {
             // normalize is needed here so it doesn't exceed the range in the diagonals
-            gameObject.transform.rotation += lookSpeed * deltaTime * glm::normalize(rotate);            
+            transform.rotation += lookSpeed * deltaTime * glm::normalize(rotate);            
         }
 
         // limit the range of the rotation.x to prevent objects from going upside down for now
-        gameObject.transform.rotation.x = glm::clamp(gameObject.transform.rotation.x, -1.5f, 1.5f);
+        transform.rotation.x = glm::clamp(transform.rotation.x, -1.5f, 1.5f);
 
         // prevents repeated spinning in one direction causing the value to overflow
-        gameObject.transform.rotation.y = glm::mod(gameObject.transform.rotation.y, glm::two_pi<float>());
+        transform.rotation.y = glm::mod(transform.rotation.y, glm::two_pi<float>());
 
-        float yaw = gameObject.transform.rotation.y;
+        float yaw = transform.rotation.y;
         const glm::vec3 forwardDirection{sin(yaw), 0.f, cos(yaw)};
         const glm::vec3 rightDirection{forwardDirection.z, 0.f, -forwardDirection.x};
         const glm::vec3 upDirection{0.f, -1.f, 0.f};
@@ -40,7 +40,17 @@ namespace bucketengine
         // only update the position if the position input is non-zero
         if (glm::dot(moveDirection, moveDirection) > std::numeric_limits<float>::epsilon())
         {
-            gameObject.transform.translation += moveSpeed * deltaTime * glm::normalize(moveDirection);            
+            transform.translation += moveSpeed * deltaTime * glm::normalize(moveDirection);            
         }
     }
+
+    bool BEKeyboardMovementController::isMoving(GLFWwindow* window) const
+    {
+        for (int key : {keys.moveLeft, keys.moveRight, keys.moveForward, keys.moveBack, keys.moveUp, keys.moveDown,
+                        keys.lookLeft, keys.lookRight, keys.lookUp, keys.lookDown})
+        {
+            if (glfwGetKey(window, key) == GLFW_PRESS) return true;
+        }
+        return false;
+    }
 }
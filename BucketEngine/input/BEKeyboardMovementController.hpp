@@ -1,6 +1,6 @@
 ﻿#pragma once
 
-#include "../game/BEGameObject.hpp"
+#include "../game/BEComponents.hpp"
 #include "../BEWindow.hpp"
 
 namespace bucketengine
@@ -23,7 +23,10 @@ namespace bucketengine
         };
 
         // currently this will only support GLFW windowing system
-        void moveInPlaneXZ(GLFWwindow* window, float deltaTime, BEGameObject& gameObject);
+        void moveInPlaneXZ(GLFWwindow* window, float deltaTime, TransformComponent& transform);
+
+        // true while any of the mapped keys is held, ie the transform will keep moving
+        bool isMoving(GLFWwindow* window) const;
 
         KeyMappings keys{};
         float moveSpeed{3.f};
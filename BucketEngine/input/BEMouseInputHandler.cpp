@@ -6,19 +6,23 @@ namespace EditorInput
 {
     BEMouseInputHandler::BEMouseInputHandler(
         bucketengine::BEWindow& beWindow,
+        bucketengine::BERenderer& beRenderer,
         bucketengine::BECamera& camera,
-        bucketengine::BEGameObject& viewerObject,
-        bucketengine::BEGameObject::Map& gameObjects
+        bucketengine::TransformComponent& viewerTransform,
+        bucketengine::BERegistry& registry,
+        const bucketengine::BEBoundsSystem& boundsSystem
     )
-    : beWindow(beWindow), camera(camera), viewerObject(viewerObject), gameObjects(gameObjects)
+    : beWindow(beWindow), beRenderer(beRenderer), camera(camera), viewerTransform(viewerTransform), registry(registry), boundsSystem(boundsSystem)
     {
-        glfwSetWindowUserPointer(beWindow.getGLFWwindow(), this);
+        beWindow.setInputHandler(this);
         glfwSetMouseButtonCallback(beWindow.getGLFWwindow(), mouseButtonCallback);
         std::cout << "Mouse handler constructor";
     }
 
     BEMouseInputHandler::~BEMouseInputHandler()
     {
+        beWindow.setInputHandler(nullptr);
+        glfwSetMouseButtonCallback(beWindow.getGLFWwindow(), nullptr);
     }
 
     void BEMouseInputHandler::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
@@ -28,56 +32,78 @@ namespace EditorInput
             double xpos, ypos;
             glfwGetCursorPos(window, &xpos, &ypos);
 
-            BEMouseInputHandler* app = static_cast<BEMouseInputHandler*>(glfwGetWindowUserPointer(window));
+            auto beWindow = reinterpret_cast<bucketengine::BEWindow*>(glfwGetWindowUserPointer(window));
+            BEMouseInputHandler* app = static_cast<BEMouseInputHandler*>(beWindow->getInputHandler());
             if (app) {
                 app->pickObject(xpos, ypos);
             }
         }
     }
 
-    bucketengine::BEGameObject& BEMouseInputHandler::pickObject(double xpos, double ypos)
+    void BEMouseInputHandler::update()
     {
-        glm::vec3 rayOrigin = viewerObject.transform.translation;
+        bucketengine::Entity entity;
+        if (!beRenderer.pollPickedObject(entity)) return;
 
-        // hard coding width for now
-        glm::vec3 rayDirection  = screenToWorldRay(
+        if (entity != bucketengine::NULL_ENTITY)
+        {
+            std::cout << "Selected Object Id: " << entity << "\n";
+        } else
+        {
+            std::cout << "Nothing found... \n";
+        }
+    }
+
+    void BEMouseInputHandler::pickObject(double xpos, double ypos)
+    {
+        // the cursor is in screen coordinates, which only match framebuffer pixels without display scaling
+        VkExtent2D extent = beWindow.getExtent();
+        int windowWidth, windowHeight;
+        glfwGetWindowSize(beWindow.getGLFWwindow(), &windowWidth, &windowHeight);
+        if (extent.width == 0 || extent.height == 0 || windowWidth == 0 || windowHeight == 0 || xpos < 0 || ypos < 0)
+        {
+            return;
+        }
+
+        double pixelX = xpos * extent.width / windowWidth;
+        double pixelY = ypos * extent.height / windowHeight;
+
+        if (beRenderer.hasObjectIdAttachment())
+        {
+            beRenderer.requestObjectId(static_cast<uint32_t>(pixelX), static_cast<uint32_t>(pixelY));
+            return;
+        }
+
+        raycastObject(pixelX, pixelY, static_cast<int>(extent.width), static_cast<int>(extent.height));
+    }
+
+    bucketengine::Entity BEMouseInputHandler::raycastObject(double xpos, double ypos, int width, int height)
+    {
+        glm::vec3 rayOrigin = viewerTransform.translation;
+        glm::vec3 rayDirection = screenToWorldRay(
             xpos,
             ypos,
             camera.getView(),
             camera.getProjection(),
-            800,
-            600
+            width,
+            height
         );
 
-        bucketengine::BEGameObject* closestObject = nullptr;
-        float closestDistance = std::numeric_limits<float>::max();
-
-        for (auto& [id, obj]: gameObjects)
+        bucketengine::RaycastHit hit{};
+        if (boundsSystem.raycast(registry, rayOrigin, rayDirection, hit))
         {
-            glm::vec3 minBounds = obj.transform.translation - obj.transform.scale * 0.5f;
-            glm::vec3 maxBounds = obj.transform.translation + obj.transform.scale * 0.5f;
-
-            if (rayIntersectsAABB(rayOrigin, rayDirection, minBounds, maxBounds))
+            std::cout << "Selected Object Id: " << hit.entity;
+            if (hit.triangle != bucketengine::BEMeshBVH::NO_TRIANGLE)
             {
-                float distance = glm::length(obj.transform.translation - rayOrigin);
-                if (distance < closestDistance)
-                {
-                    closestDistance = distance;
-                    closestObject = &obj;
-                }
+                std::cout << " triangle: " << hit.triangle;
             }
-            // if the ray intersects get our distances
-        }
-
-        if (closestObject)
-        {
-            std::cout << "Selected Object Id: " << closestObject->getId() << "\n";
+            std::cout << "\n";
         } else
         {
             std::cout << "Nothing found... \n";
         }
 
-        return *closestObject;
+        return hit.entity;
     }
 
     glm::vec3 BEMouseInputHandler::screenToWorldRay(
@@ -89,41 +115,16 @@ namespace EditorInput
         int height
     )
     {
-        // normalize the device coords (-1.0 -> 1.0)
-        float x = (2.f * xpos) / width - 1.f;
-        float y = 1.f - (2.f * ypos) / height;
-        float z = 1.f;
-
-        // convert to homogeneous clip coords
-        glm::vec4 clipCoords = glm::vec4(x, y, -1.f, 1.f);
+        // normalize the device coords (-1.0 -> 1.0), vulkan's y axis points down like the cursor's
+        float x = static_cast<float>((2.0 * xpos) / width - 1.0);
+        float y = static_cast<float>((2.0 * ypos) / height - 1.0);
 
-        // convert to camera space
-        glm::vec4 eyeCoords = glm::inverse(projMatrix) * clipCoords;
-        eyeCoords = glm::vec4(eyeCoords.x, eyeCoords.y, -1.f, 0.f);
+        // unproject the point under the cursor on the near and far planes back into world space
+        glm::mat4 inverseViewProjection = glm::inverse(projMatrix * viewMatrix);
+        glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, 0.f, 1.f);
+        glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.f, 1.f);
 
-        // convert to world space
-        glm::vec3 worldRay = glm::vec3(glm::inverse(viewMatrix) * eyeCoords);
+        glm::vec3 worldRay = glm::vec3(farPoint) / farPoint.w - glm::vec3(nearPoint) / nearPoint.w;
         return glm::normalize(worldRay);
     }
-
-    bool BEMouseInputHandler::rayIntersectsAABB(
-        const glm::vec3& rayOrigin,
-        const glm::vec3& rayDirection,
-        const glm::vec3& minBounds,
-        const glm::vec3& maxBounds
-    )
-    {
-        glm::vec3 invDir = 1.f / rayDirection;
-        glm::vec3 t1 = (minBounds - rayOrigin) * invDir;
-        glm::vec3 t2 = (maxBounds - rayOrigin) * invDir;
-
-        glm::vec3 tMin = glm::min(t1, t2);
-        glm::vec3 tMax = glm::max(t1, t2);
-
-        float tNear = glm::max(glm::max(tMin.x, tMin.y), tMin.z);
-        float tFar = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
-
-        return tNear <= tFar && tFar > 0;
-    }
 }
-
@@ -1,7 +1,10 @@
 ﻿#pragma once
 
 #include "../BEWindow.hpp"
-#include "../game/BEGameObject.hpp"
+#include "../renderer/BERenderer.hpp"
+#include "../game/BEBoundsSystem.hpp"
+#include "../game/BEComponents.hpp"
+#include "../ecs/BERegistry.hpp"
 #include "../camera/BECamera.hpp"
 
 namespace EditorInput
@@ -11,22 +14,35 @@ namespace EditorInput
     public:
         BEMouseInputHandler(
             bucketengine::BEWindow& beWindow,
+            bucketengine::BERenderer& beRenderer,
             bucketengine::BECamera& camera,
-            bucketengine::BEGameObject& viewerObject,
-            bucketengine::BEGameObject::Map& gameObjects
+            bucketengine::TransformComponent& viewerTransform,
+            bucketengine::BERegistry& registry,
+            const bucketengine::BEBoundsSystem& boundsSystem
         );
         ~BEMouseInputHandler();
 
+        // call once per frame, reports the result of a pick made through the renderer's object id attachment
+        void update();
+
     private:
         bucketengine::BEWindow& beWindow;
+        bucketengine::BERenderer& beRenderer;
         bucketengine::BECamera& camera;
-        bucketengine::BEGameObject& viewerObject;
-        bucketengine::BEGameObject::Map& gameObjects;
+        bucketengine::TransformComponent& viewerTransform;
+        bucketengine::BERegistry& registry;
+        const bucketengine::BEBoundsSystem& boundsSystem;
         
         static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 
-        bucketengine::BEGameObject& pickObject(double xpos, double ypos);
+        // with the object id attachment the pick is sent to the gpu and reported by update, otherwise
+        // a ray is cast against the scene. xpos and ypos are the cursor in screen coordinates
+        void pickObject(double xpos, double ypos);
+
+        // xpos and ypos are framebuffer pixels, returns NULL_ENTITY when the ray hits nothing
+        bucketengine::Entity raycastObject(double xpos, double ypos, int width, int height);
 
+        // xpos and ypos are framebuffer pixels
         glm::vec3 screenToWorldRay(
             double xpos,
             double ypos,
@@ -35,12 +51,5 @@ namespace EditorInput
             int width,
             int height
         );
-
-        bool rayIntersectsAABB(
-            const glm::vec3& rayOrigin,
-            const glm::vec3& rayDirection,
-            const glm::vec3& minBounds,
-            const glm::vec3& maxBounds
-        );
     };
 }
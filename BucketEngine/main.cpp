@@ -1,12 +1,77 @@
 #include "App.hpp"
+#include "assets/BEAssetArchive.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-int main()
+int main(int argc, char** argv)
 {
-    bucketengine::App app{};
+    // --latency low|balanced|throughput, --fps <frames per second>, --present-wait, --continuous,
+    // --no-late-latch, --dynamic-rendering, --gpu-picking, --pack [archive path]
+    bucketengine::AppSettings settings{};
+    const char* packPath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--pack") == 0)
+        {
+            bool hasPath = i + 1 < argc && std::strncmp(argv[i + 1], "--", 2) != 0;
+            packPath = hasPath ? argv[++i] : bucketengine::App::ASSET_ARCHIVE_PATH;
+        }
+        else if (std::strcmp(argv[i], "--present-wait") == 0)
+        {
+            settings.presentWait = true;
+        }
+        else if (std::strcmp(argv[i], "--continuous") == 0)
+        {
+            settings.renderOnDemand = false;
+        }
+        else if (std::strcmp(argv[i], "--no-late-latch") == 0)
+        {
+            settings.lateLatch = false;
+        }
+        else if (std::strcmp(argv[i], "--dynamic-rendering") == 0)
+        {
+            settings.dynamicRendering = true;
+        }
+        else if (std::strcmp(argv[i], "--gpu-picking") == 0)
+        {
+            settings.gpuPicking = true;
+        }
+        else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+        {
+            settings.targetFrameRate = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+        {
+            const char* mode = argv[++i];
+            if (std::strcmp(mode, "low") == 0) settings.latencyMode = bucketengine::LatencyMode::Low;
+            else if (std::strcmp(mode, "throughput") == 0) settings.latencyMode = bucketengine::LatencyMode::Throughput;
+            else if (std::strcmp(mode, "balanced") != 0) std::cerr << "Unknown latency mode " << mode << '\n';
+        }
+    }
+
+    // packs the loose models, scenes and compiled shaders into the archive the app mounts when it finds one
+    if (packPath != nullptr)
+    {
+        try
+        {
+            bucketengine::BEAssetArchive::Writer writer{};
+            writer.addDirectory("models", {".obj"});
+            writer.addDirectory("scenes", {".bescene"});
+            writer.addDirectory("shaders", {".spv"});
+            writer.write(packPath);
+            std::cout << "packed " << writer.getEntryCount() << " files into " << packPath << '\n';
+        } catch (const std::exception &e)
+        {
+            std::cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    bucketengine::App app{settings};
 
     try
     {
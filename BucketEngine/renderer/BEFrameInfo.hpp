@@ -1,7 +1,6 @@
 ﻿#pragma once
 
-#include "../camera/BECamera.hpp"
-#include "../game/BEGameObject.hpp"
+#include "BERenderSnapshot.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
@@ -13,8 +12,7 @@ namespace bucketengine
         int frameIndex;
         float frameTime;
         VkCommandBuffer commandBuffer;
-        BECamera &camera;
         VkDescriptorSet globalDescriptorSet;
-        BEGameObject::Map &gameObjects;
+        const RenderSnapshot &snapshot;
     };
 }
@@ -0,0 +1,123 @@
+﻿#include "BEObjectPicker.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace bucketengine
+{
+    BEObjectPicker::BEObjectPicker(BEDevice& device, uint32_t framesInFlight)
+    {
+        readbacks.resize(framesInFlight);
+        for (Readback& readback : readbacks)
+        {
+            readback.buffer = std::make_unique<BEBuffer>(
+                device,
+                sizeof(uint32_t),
+                1,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            );
+            readback.buffer->map();
+        }
+    }
+
+    void BEObjectPicker::request(uint32_t x, uint32_t y)
+    {
+        requestedPixel.store(static_cast<uint64_t>(y) << 32 | x, std::memory_order_relaxed);
+    }
+
+    void BEObjectPicker::recordReadback(
+        VkCommandBuffer commandBuffer,
+        int frameIndex,
+        uint64_t frame,
+        VkImage objectIdImage,
+        VkExtent2D extent)
+    {
+        assert(frameIndex >= 0 && static_cast<size_t>(frameIndex) < readbacks.size() && "Frame index out of range");
+        assert(readbacks[frameIndex].frame == 0 && "Readback buffer reused before its frame was resolved");
+        if (extent.width == 0 || extent.height == 0) return;
+
+        uint64_t pixel = requestedPixel.exchange(NO_REQUEST, std::memory_order_relaxed);
+        if (pixel == NO_REQUEST) return;
+        uint32_t requestX = static_cast<uint32_t>(pixel);
+        uint32_t requestY = static_cast<uint32_t>(pixel >> 32);
+
+        // the window may have shrunk since the click
+        VkBufferImageCopy region{};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {
+            static_cast<int32_t>(std::min(requestX, extent.width - 1)),
+            static_cast<int32_t>(std::min(requestY, extent.height - 1)),
+            0
+        };
+        region.imageExtent = {1, 1, 1};
+
+        Readback& readback = readbacks[frameIndex];
+        vkCmdCopyImageToBuffer(
+            commandBuffer,
+            objectIdImage,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            readback.buffer->getBuffer(),
+            1,
+            &region
+        );
+
+        // the timeline only orders the copy before the cpu sees the frame finish, the write still has to be made visible to it
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr
+        );
+
+        readback.frame = frame;
+    }
+
+    void BEObjectPicker::resolve(uint64_t completedFrame)
+    {
+        // resolve in frame order so the newest pick is the one left for poll
+        for (;;)
+        {
+            Readback* oldest = nullptr;
+            for (Readback& readback : readbacks)
+            {
+                if (readback.frame != 0 && readback.frame <= completedFrame &&
+                    (oldest == nullptr || readback.frame < oldest->frame))
+                {
+                    oldest = &readback;
+                }
+            }
+            if (oldest == nullptr) return;
+
+            oldest->buffer->invalidate();
+            resolvedId.store(*static_cast<const uint32_t*>(oldest->buffer->getMappedMemory()), std::memory_order_relaxed);
+            oldest->frame = 0;
+        }
+    }
+
+    bool BEObjectPicker::poll(Entity& id)
+    {
+        uint64_t result = resolvedId.exchange(NO_RESULT, std::memory_order_relaxed);
+        if (result == NO_RESULT) return false;
+
+        id = static_cast<Entity>(result);
+        return true;
+    }
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "../BEDevice.hpp"
+#include "../BESwapChain.hpp"
+#include "../buffers/BEBuffer.hpp"
+#include "../ecs/BERegistry.hpp"
+
+// std
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace bucketengine
+{
+    // reads single texels back from the swap chain's object id attachment. the copy is recorded into
+    // the frame that was rendered and read once the frame timeline has passed that frame, so a pick
+    // resolves as soon as the gpu is done with it without ever stalling the cpu on the gpu.
+    // request and poll may be called from any thread, the rest from the thread recording frames
+    class BEObjectPicker
+    {
+    public:
+        // one readback buffer per frame in flight
+        BEObjectPicker(BEDevice& device, uint32_t framesInFlight);
+        ~BEObjectPicker() = default;
+
+        BEObjectPicker(const BEObjectPicker&) = delete;
+        BEObjectPicker& operator=(const BEObjectPicker&) = delete;
+
+        // x and y are framebuffer pixels, a newer request replaces one that hasn't been recorded yet
+        void request(uint32_t x, uint32_t y);
+
+        /**
+         * Records the copy of the requested texel, if there is one, into the frame's command buffer.
+         * Must be recorded after the render pass that wrote the ids has ended.
+         *
+         * @param commandBuffer The command buffer of the frame being recorded
+         * @param frameIndex The renderer's frame in flight index, selects the readback buffer
+         * @param frame The number the frame will have on the device's frame timeline
+         * @param objectIdImage The id attachment of the swap chain image rendered this frame
+         * @param extent The size of the id attachment, the requested pixel is clamped to it
+         */
+        void recordReadback(
+            VkCommandBuffer commandBuffer,
+            int frameIndex,
+            uint64_t frame,
+            VkImage objectIdImage,
+            VkExtent2D extent
+        );
+
+        // reads back every copy recorded in a frame up to and including completedFrame
+        void resolve(uint64_t completedFrame);
+
+        // true once when a requested id has been read back, id is NULL_ENTITY if nothing was under the pixel
+        bool poll(Entity& id);
+
+        // a request is waiting for a frame to record its copy into
+        bool hasRequest() const { return requestedPixel.load(std::memory_order_relaxed) != NO_REQUEST; }
+        // an id has been read back and not polled yet
+        bool hasResult() const { return resolvedId.load(std::memory_order_relaxed) != NO_RESULT; }
+
+    private:
+        struct Readback
+        {
+            std::unique_ptr<BEBuffer> buffer;
+            // the frame the copy was recorded in, zero when there is nothing to read
+            uint64_t frame = 0;
+        };
+
+        std::vector<Readback> readbacks;
+
+        // the pixel packed as y << 32 | x, or NO_REQUEST
+        static constexpr uint64_t NO_REQUEST = ~0ull;
+        std::atomic<uint64_t> requestedPixel{NO_REQUEST};
+
+        // the id read back, or NO_RESULT. ids are 32 bits so this can't collide with one
+        static constexpr uint64_t NO_RESULT = ~0ull;
+        std::atomic<uint64_t> resolvedId{NO_RESULT};
+    };
+}
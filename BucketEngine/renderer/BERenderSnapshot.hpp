@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include "../BEModel.hpp"
+#include "../ecs/BERegistry.hpp"
+#include "../utils/BEUtils.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace bucketengine
+{
+    // everything the renderer reads from the game for one frame, copied out of the registry by the
+    // game thread so the render thread never touches state that is being simulated
+    struct RenderSnapshot
+    {
+        struct ModelDraw
+        {
+            // shared so a model removed from the scene stays alive until the snapshot is refilled
+            std::shared_ptr<BEModel> model;
+            glm::mat4 modelMatrix{1.f};
+            glm::mat3x4 normalMatrix{1.f};
+            Entity entity = NULL_ENTITY;
+        };
+
+        struct PointLight
+        {
+            glm::vec3 position{0.f};
+            glm::vec3 color{1.f};
+            float intensity = 1.f;
+        };
+
+        glm::mat4 projection{1.f};
+        glm::mat4 view{1.f};
+        float frameTime = 0.f;
+        // when the input the snapshot was simulated from was polled
+        std::chrono::steady_clock::time_point inputTime{};
+
+        // only models that were ready when the snapshot was taken
+        std::vector<ModelDraw> draws;
+        std::vector<PointLight> pointLights;
+
+        // identifies what a frame drawn from the snapshot shows, snapshots with equal hashes draw the same
+        // image. the frame and input times are left out
+        uint64_t hashContents() const
+        {
+            uint64_t hash = hashBytes(&projection, sizeof(projection));
+            hash = hashBytes(&view, sizeof(view), hash);
+            for (const ModelDraw& draw : draws)
+            {
+                const BEModel* model = draw.model.get();
+                hash = hashBytes(&model, sizeof(model), hash);
+                hash = hashBytes(&draw.modelMatrix, sizeof(draw.modelMatrix), hash);
+                hash = hashBytes(&draw.entity, sizeof(draw.entity), hash);
+            }
+            // tightly packed floats, no padding to hash
+            return hashBytes(pointLights.data(), pointLights.size() * sizeof(PointLight), hash);
+        }
+
+        // keeps the vectors' capacity, snapshots are refilled every frame
+        void clear()
+        {
+            draws.clear();
+            pointLights.clear();
+        }
+    };
+}
@@ -5,7 +5,12 @@
 
 namespace bucketengine
 {
-    BERenderer::BERenderer(BEWindow& beWindow, BEDevice& beDevice) :beWindow{beWindow}, beDevice{beDevice}
+    BERenderer::BERenderer(BEWindow& beWindow, BEDevice& beDevice, const SwapChainSettings& settings)
+        : beWindow{beWindow},
+          beDevice{beDevice},
+          settings{settings},
+          requestedPresentMode{settings.presentMode},
+          objectPicker{beDevice, settings.framesInFlight}
     {
         recreateSwapChain();
         createCommandBuffers();
@@ -14,12 +19,29 @@ namespace bucketengine
     BERenderer::~BERenderer()
     {
         freeCommandBuffers();
+        vkDestroyCommandPool(beDevice.device(), commandPool, nullptr);
     }
 
     VkCommandBuffer BERenderer::beginFrame()
     {
         assert(!isFrameStarted && "Can't call beginFrame while already in progress");
-        
+
+        // nothing can be presented while the window is minimized
+        VkExtent2D extent = beWindow.getExtent();
+        if (extent.width == 0 || extent.height == 0)
+        {
+            return nullptr;
+        }
+
+        VkPresentModeKHR presentMode = requestedPresentMode.load(std::memory_order_relaxed);
+        bool resizeSettled = resizePending.load(std::memory_order_relaxed) &&
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - resizeTime).count() >= RESIZE_DEBOUNCE_SECONDS;
+        if (presentMode != settings.presentMode || resizeSettled)
+        {
+            settings.presentMode = presentMode;
+            recreateSwapChain();
+        }
+
         auto result = beSwapChain->acquireNextImage(&currentImageIndex);
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -36,6 +58,9 @@ namespace bucketengine
 
         isFrameStarted = true;
 
+        // acquiring waited for at least the frame that last used this frame index
+        collectCompletedFrames();
+
         auto commandBuffer = getCurrentCommandBuffer();
 
         VkCommandBufferBeginInfo beginInfo{};
@@ -60,19 +85,47 @@ namespace bucketengine
             throw std::runtime_error("Failed to end command buffer");
         }
 
-        auto result = beSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || beWindow.getFrameBufferResized())
+        auto runLateLatch = [](void* context)
         {
-            beWindow.resetWindowResizedFlag();
+            auto renderer = static_cast<BERenderer*>(context);
+            renderer->lateLatch(renderer->lateLatchContext, renderer->currentFrameIndex);
+        };
+        auto result = beSwapChain->submitCommandBuffers(
+            &commandBuffer,
+            &currentImageIndex,
+            lateLatch ? +runLateLatch : nullptr,
+            this
+        );
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // nothing can be presented to the old swap chain anymore, it can't wait for the resize to settle
             recreateSwapChain();
-        } else if (result != VK_SUCCESS)
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
         {
             throw std::runtime_error("Failed to submit command buffers");
+        } else if (beWindow.getFrameBufferResized() || (result == VK_SUBOPTIMAL_KHR && !resizePending.load(std::memory_order_relaxed)))
+        {
+            // every resize event starts the wait over, a suboptimal swap chain on its own doesn't, it stays
+            // suboptimal until it is rebuilt
+            beWindow.resetWindowResizedFlag();
+            resizeTime = std::chrono::steady_clock::now();
+            resizePending.store(true, std::memory_order_relaxed);
+        } else if (presentWait.load(std::memory_order_relaxed))
+        {
+            // bounded so a window that stops being shown can't hang the render thread
+            beSwapChain->waitForPresent(beDevice.frameTimeline().getSubmittedFrame() - 1, PRESENT_WAIT_TIMEOUT);
         }
         
         isFrameStarted = false;
 
-        currentImageIndex = (currentImageIndex + 1) % BESwapChain::MAX_FRAMES_IN_FLIGHT;
+        currentFrameIndex = (currentFrameIndex + 1) % settings.framesInFlight;
+    }
+
+    void BERenderer::setLateLatch(void (*lateLatch)(void* context, int frameIndex), void* context)
+    {
+        assert(!isFrameStarted && "Can't change the late latch while a frame is in progress");
+        this->lateLatch = lateLatch;
+        lateLatchContext = context;
     }
 
     void BERenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
@@ -80,21 +133,30 @@ namespace bucketengine
         assert(isFrameStarted && "Can't call beginSwapChain while frame not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = beSwapChain->getRenderPass();
-        renderPassInfo.framebuffer = beSwapChain->getFrameBuffer(currentImageIndex);
-
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = beSwapChain->getSwapChainExtent();
-
-        std::array<VkClearValue, 2> clearValues{};
+        std::array<VkClearValue, 3> clearValues{};
         clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
         clearValues[1].depthStencil = {1.0f, 0};
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+        clearValues[2].color.uint32[0] = NULL_ENTITY;
+
+        if (beSwapChain->usesDynamicRendering())
+        {
+            beginDynamicRendering(commandBuffer, clearValues);
+        }
+        else
+        {
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = beSwapChain->getRenderPass();
+            renderPassInfo.framebuffer = beSwapChain->getFrameBuffer(currentImageIndex);
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = beSwapChain->getSwapChainExtent();
+
+            renderPassInfo.clearValueCount = settings.objectIdAttachment ? 3 : 2;
+            renderPassInfo.pClearValues = clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        }
 
         // the viewport is a fixed function vertex post processing transformation
         // so this transformation is automatically applied following the vertex shader
@@ -119,17 +181,220 @@ namespace bucketengine
         assert(isFrameStarted && "Can't call endSwapChain while frame not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
         
-        vkCmdEndRenderPass(commandBuffer);
+        if (beSwapChain->usesDynamicRendering())
+        {
+            endDynamicRendering(commandBuffer);
+        }
+        else
+        {
+            vkCmdEndRenderPass(commandBuffer);
+        }
+
+        if (settings.objectIdAttachment)
+        {
+            objectPicker.recordReadback(
+                commandBuffer,
+                currentFrameIndex,
+                beDevice.frameTimeline().getSubmittedFrame() + 1,
+                beSwapChain->getObjectIdImage(currentImageIndex),
+                beSwapChain->getSwapChainExtent()
+            );
+        }
+    }
+
+    static VkImageMemoryBarrier imageBarrier(
+        VkImage image,
+        VkImageAspectFlags aspectMask,
+        VkImageLayout oldLayout,
+        VkImageLayout newLayout,
+        VkAccessFlags srcAccessMask,
+        VkAccessFlags dstAccessMask)
+    {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = aspectMask;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    void BERenderer::beginDynamicRendering(VkCommandBuffer commandBuffer, const std::array<VkClearValue, 3>& clearValues)
+    {
+        // without a render pass the layout transitions it made are recorded here, every attachment starts out
+        // undefined as its old contents are cleared anyway. the depth image may be shared with the frame before,
+        // so its clear waits for that frame's depth writes
+        VkFormat depthFormat = beSwapChain->getSwapChainDepthFormat();
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (depthFormat == VK_FORMAT_D32_SFLOAT_S8_UINT || depthFormat == VK_FORMAT_D24_UNORM_S8_UINT)
+        {
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+
+        std::array<VkImageMemoryBarrier, 3> barriers = {
+            imageBarrier(
+                beSwapChain->getImage(currentImageIndex),
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                0,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            ),
+            imageBarrier(
+                beSwapChain->getDepthImage(currentImageIndex),
+                depthAspect,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+            ),
+            // the last readback from the image has to be done before it is cleared
+            settings.objectIdAttachment ? imageBarrier(
+                beSwapChain->getObjectIdImage(currentImageIndex),
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                0,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            ) : VkImageMemoryBarrier{}
+        };
+
+        // colour writes wait on the acquire semaphore, which is waited on at the colour attachment output stage
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            settings.objectIdAttachment ? 3 : 2,
+            barriers.data()
+        );
+
+        std::array<VkRenderingAttachmentInfoKHR, 2> colorAttachments{};
+        colorAttachments[0].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        colorAttachments[0].imageView = beSwapChain->getImageView(currentImageIndex);
+        colorAttachments[0].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachments[0].resolveMode = VK_RESOLVE_MODE_NONE;
+        colorAttachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachments[0].clearValue = clearValues[0];
+
+        if (settings.objectIdAttachment)
+        {
+            colorAttachments[1].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+            colorAttachments[1].imageView = beSwapChain->getObjectIdImageView(currentImageIndex);
+            colorAttachments[1].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachments[1].resolveMode = VK_RESOLVE_MODE_NONE;
+            colorAttachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachments[1].clearValue = clearValues[2];
+        }
+
+        VkRenderingAttachmentInfoKHR depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depthAttachment.imageView = beSwapChain->getDepthImageView(currentImageIndex);
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue = clearValues[1];
+
+        VkRenderingInfoKHR renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = beSwapChain->getSwapChainExtent();
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = settings.objectIdAttachment ? 2 : 1;
+        renderingInfo.pColorAttachments = colorAttachments.data();
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        beDevice.cmdBeginRendering(commandBuffer, renderingInfo);
+    }
+
+    void BERenderer::endDynamicRendering(VkCommandBuffer commandBuffer)
+    {
+        beDevice.cmdEndRendering(commandBuffer);
+
+        // the image goes to presentation and the ids to the readback copy, like the render pass's final layouts
+        std::array<VkImageMemoryBarrier, 2> barriers = {
+            imageBarrier(
+                beSwapChain->getImage(currentImageIndex),
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                0
+            ),
+            settings.objectIdAttachment ? imageBarrier(
+                beSwapChain->getObjectIdImage(currentImageIndex),
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_TRANSFER_READ_BIT
+            ) : VkImageMemoryBarrier{}
+        };
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            settings.objectIdAttachment ? 2 : 1,
+            barriers.data()
+        );
+    }
+
+    void BERenderer::collectCompletedFrames()
+    {
+        assert(!isFrameStarted && "Can't collect completed frames while a frame is in progress");
+
+        uint64_t completedFrame = beDevice.frameTimeline().getCompletedFrame();
+        objectPicker.resolve(completedFrame);
+        beDevice.deletionQueue().collect(completedFrame);
+    }
+
+    void BERenderer::requestObjectId(uint32_t x, uint32_t y)
+    {
+        assert(settings.objectIdAttachment && "Can't request an object id without the object id attachment");
+        objectPicker.request(x, y);
     }
 
     void BERenderer::createCommandBuffers()
     {
-        commandBuffers.resize(BESwapChain::MAX_FRAMES_IN_FLIGHT);
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = beDevice.findPhysicalQueueFamilies().graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if (vkCreateCommandPool(beDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create renderer command pool");
+        }
+
+        commandBuffers.resize(settings.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = beDevice.getCommandPool();
+        allocInfo.commandPool = commandPool;
         allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
         if (vkAllocateCommandBuffers(beDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
@@ -142,7 +407,7 @@ namespace bucketengine
     {
         vkFreeCommandBuffers(
             beDevice.device(),
-            beDevice.getCommandPool(),
+            commandPool,
             static_cast<uint32_t>(commandBuffers.size()),
             commandBuffers.data()
         );
@@ -151,36 +416,36 @@ namespace bucketengine
 
     void BERenderer::recreateSwapChain()
     {
+        // cleared before the size is read, so a resize arriving while rebuilding isn't lost
+        beWindow.resetWindowResizedFlag();
         auto extent = beWindow.getExtent();
 
-        // if the width or the height are equal to zero, we wait
-        // this can occur when the window is minimized
-        while (extent.width == 0 || extent.height == 0)
+        // the width or the height are zero while the window is minimized. glfw can only wait for
+        // events on the main thread, which creates the first swap chain, later on the old swap chain
+        // is kept and frames are skipped until the window has a size again
+        if (extent.width == 0 || extent.height == 0)
         {
-            extent = beWindow.getExtent();
-            glfwWaitEvents();
-        }
+            if (beSwapChain != nullptr) return;
 
-        vkDeviceWaitIdle(beDevice.device());
+            while (extent.width == 0 || extent.height == 0)
+            {
+                extent = beWindow.getExtent();
+                glfwWaitEvents();
+            }
+        }
 
+        // frames in flight keep using the old resources, which the swap chain retires rather than waiting on them
         if (beSwapChain == nullptr)
         {
-            beSwapChain = std::make_unique<BESwapChain>(beDevice, extent);
+            beSwapChain = std::make_unique<BESwapChain>(beDevice, extent, settings);
         }
         else
         {
-            std::shared_ptr<BESwapChain> oldSwapChain = std::move(beSwapChain);
-            beSwapChain = std::make_unique<BESwapChain>(beDevice, extent, oldSwapChain);
-
-            if (!oldSwapChain->compareSwapFormats(*beSwapChain.get()))
-            {
-                // rather than throwing an error it would be better to
-                // set up a callback function to tell the app
-                // a new incompatable render pass has been created 
-                throw std::runtime_error("Swap chain image format has changed");
-            }
+            beSwapChain->recreate(extent, settings);
         }
-        
+
+        resizePending.store(false, std::memory_order_relaxed);
+        aspectRatio.store(beSwapChain->extentAspectRatio(), std::memory_order_relaxed);
         // createPipeline();
     }
 }
@@ -4,6 +4,7 @@
 #include "../BEDevice.hpp"
 #include "../BESwapChain.hpp"
 #include "../BEModel.hpp"
+#include "BEObjectPicker.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -12,7 +13,10 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -21,7 +25,15 @@ namespace bucketengine
     class BERenderer
     {
     public:
-        BERenderer(BEWindow& beWindow, BEDevice& beDevice);
+        // nanoseconds a frame waits at most for the previous one to be shown
+        static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100ull * 1000 * 1000;
+        // the window has to keep its size this long before the swap chain is rebuilt for it, frames keep
+        // going to the old swap chain in the meantime unless it stops being usable
+        static constexpr double RESIZE_DEBOUNCE_SECONDS = 0.05;
+
+        // the settings pick frames in flight, swap chain images and present mode, frames in flight are fixed
+        // for the renderer's lifetime since per frame resources elsewhere are sized from them
+        BERenderer(BEWindow& beWindow, BEDevice& beDevice, const SwapChainSettings& settings = {});
         ~BERenderer();
 
         BERenderer(const BERenderer &) = delete;
@@ -29,8 +41,36 @@ namespace bucketengine
 
         bool isFrameInProgress() const { return isFrameStarted; }
 
+        // null when the swap chain is drawn to with dynamic rendering
         VkRenderPass getSwapChainRenderPass() const { return beSwapChain->getRenderPass(); }
-        float getAspectRatio() const { return beSwapChain->extentAspectRatio(); }
+        // what pipelines drawing in the swap chain render pass are built for
+        RenderTargetInfo getSwapChainRenderTarget() const { return beSwapChain->getRenderTarget(); }
+        // moves on when the swap chain's render target changes, see BESwapChain::recreate
+        uint32_t getRenderTargetVersion() const { return beSwapChain->getRenderTargetVersion(); }
+        bool usesDynamicRendering() const { return beSwapChain->usesDynamicRendering(); }
+        BESwapChain::AttachmentMemoryUsage getAttachmentMemoryUsage() const
+        {
+            return beSwapChain->getAttachmentMemoryUsage();
+        }
+        // safe to call from any thread, the window was resized and the swap chain will be rebuilt once it settles
+        bool isResizePending() const { return resizePending.load(std::memory_order_relaxed); }
+        // safe to call from any thread, unlike the rest of the renderer
+        float getAspectRatio() const { return aspectRatio.load(std::memory_order_relaxed); }
+        bool hasObjectIdAttachment() const { return settings.objectIdAttachment; }
+        uint32_t getFramesInFlight() const { return settings.framesInFlight; }
+        // the present mode the swap chain ended up with
+        VkPresentModeKHR getPresentMode() const { return beSwapChain->getPresentMode(); }
+
+        // safe to call from any thread, the swap chain is recreated with the new mode at the start of the next frame
+        void setPresentMode(VkPresentModeKHR presentMode) { requestedPresentMode.store(presentMode, std::memory_order_relaxed); }
+        VkPresentModeKHR getRequestedPresentMode() const { return requestedPresentMode.load(std::memory_order_relaxed); }
+
+        // with present wait every frame waits until the one before it is on screen, which keeps at most one
+        // frame queued for the display. does nothing unless the device supports VK_KHR_present_wait
+        void setPresentWait(bool enabled) { presentWait.store(enabled, std::memory_order_relaxed); }
+        bool supportsPresentWait() const { return beDevice.supportsPresentWait(); }
+        // true once the frame, numbered on the device's frame timeline, is on screen, see BESwapChain::waitForPresent
+        bool waitForPresent(uint64_t frame, uint64_t timeout) { return beSwapChain->waitForPresent(frame, timeout); }
         VkCommandBuffer getCurrentCommandBuffer() const
         {
             assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
@@ -46,18 +86,62 @@ namespace bucketengine
         VkCommandBuffer beginFrame();
         void endFrame();
 
+        /**
+         * Sets a function run on every frame right before it is submitted, after recording and after any
+         * wait on the gpu. Lets the caller write data the recorded commands read, like the camera, as late
+         * as possible. Call from the thread recording frames.
+         *
+         * @param lateLatch Called with context and the frame index, nullptr to stop
+         * @param context Passed to lateLatch
+         */
+        void setLateLatch(void (*lateLatch)(void* context, int frameIndex), void* context);
+
         void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
         void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+        /**
+         * Asks for the id of the object drawn at a pixel of the next frame. The answer arrives through
+         * pollPickedObject a few frames later, requires the object id attachment.
+         *
+         * @param x Horizontal framebuffer pixel
+         * @param y Vertical framebuffer pixel
+         */
+        void requestObjectId(uint32_t x, uint32_t y);
+        // true once the requested id has been read back, entity is NULL_ENTITY when nothing was drawn there
+        bool pollPickedObject(Entity& entity) { return objectPicker.poll(entity); }
+        // safe to call from any thread, a requested id still needs a frame drawn before it can be read back
+        bool isObjectIdRequested() const { return objectPicker.hasRequest(); }
+        // safe to call from any thread, the next pollPickedObject will succeed
+        bool hasPickedObject() const { return objectPicker.hasResult(); }
+
+        // picks up readbacks and frees the resources of every frame the gpu has finished. beginFrame does
+        // this on its own, call it between frames so a renderer that has stopped drawing still lets go of them
+        void collectCompletedFrames();
         
     private:
         void createCommandBuffers();
         void freeCommandBuffers();
         void recreateSwapChain();
+        // the layout transitions and attachments the swap chain's render pass would otherwise take care of
+        void beginDynamicRendering(VkCommandBuffer commandBuffer, const std::array<VkClearValue, 3>& clearValues);
+        void endDynamicRendering(VkCommandBuffer commandBuffer);
         
         BEWindow& beWindow;
         BEDevice& beDevice;
         std::unique_ptr<BESwapChain> beSwapChain;
+        // separate from the device's pool, which one off uploads on other threads allocate from
+        VkCommandPool commandPool = VK_NULL_HANDLE;
         std::vector<VkCommandBuffer> commandBuffers;
+        std::atomic<float> aspectRatio{1.f};
+        SwapChainSettings settings;
+        std::atomic<VkPresentModeKHR> requestedPresentMode;
+        std::atomic<bool> presentWait{false};
+        std::atomic<bool> resizePending{false};
+        // when the window last changed size
+        std::chrono::steady_clock::time_point resizeTime{};
+        void (*lateLatch)(void* context, int frameIndex) = nullptr;
+        void* lateLatchContext = nullptr;
+        BEObjectPicker objectPicker;
 
         uint32_t currentImageIndex;
         int currentFrameIndex = 0;
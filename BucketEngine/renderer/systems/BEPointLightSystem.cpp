@@ -5,16 +5,17 @@
 
 namespace bucketengine
 {
-    BEPointLightSystem::BEPointLightSystem(BEDevice& device, VkRenderPass renderPass,
-                                           VkDescriptorSetLayout globalSetLayout) : beDevice{device}
+    BEPointLightSystem::BEPointLightSystem(BEDevice& device, const RenderTargetInfo& renderTarget,
+                                           VkDescriptorSetLayout globalSetLayout,
+                                           bool objectIdAttachment) : beDevice{device}, objectIdAttachment{objectIdAttachment}
     {
         createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        createPipeline(renderTarget, objectIdAttachment);
     }
 
     BEPointLightSystem::~BEPointLightSystem()
     {
-        vkDestroyPipelineLayout(beDevice.device(), pipelineLayout, nullptr);
+        beDevice.deletionQueue().retirePipelineLayout(pipelineLayout);
     }
 
     void BEPointLightSystem::render(FrameInfo& frameInfo)
@@ -35,6 +36,11 @@ namespace bucketengine
         vkCmdDraw(frameInfo.commandBuffer, 6, 1, 0, 0);
     }
 
+    void BEPointLightSystem::setRenderTarget(const RenderTargetInfo& renderTarget)
+    {
+        createPipeline(renderTarget, objectIdAttachment);
+    }
+
     void BEPointLightSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
     {
         // VkPushConstantRange pushConstantRange{};
@@ -57,17 +63,22 @@ namespace bucketengine
         }
     }
 
-    void BEPointLightSystem::createPipeline(VkRenderPass renderPass)
+    void BEPointLightSystem::createPipeline(const RenderTargetInfo& renderTarget, bool objectIdAttachment)
     {
         assert(pipelineLayout != nullptr && "Attempting to create pipeline with nullptr pipeline layout");
         PipelineConfigInfo pipelineConfigInfo{};
         BEPipeline::defaultPipelineConfigInfo(pipelineConfigInfo);
+        // the light billboards don't output ids, keep the ids of whatever is behind them
+        if (objectIdAttachment)
+        {
+            BEPipeline::addObjectIdAttachment(pipelineConfigInfo, false);
+        }
 
         // we dont need these values in our point light shaders
         pipelineConfigInfo.attributeDescriptions.clear();
         pipelineConfigInfo.bindingDescriptions.clear();
 
-        pipelineConfigInfo.renderPass = renderPass;
+        BEPipeline::setRenderTarget(pipelineConfigInfo, renderTarget);
         pipelineConfigInfo.pipelineLayout = pipelineLayout;
         bePipeline = std::make_unique<BEPipeline>(
             beDevice,
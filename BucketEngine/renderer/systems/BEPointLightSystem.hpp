@@ -2,7 +2,7 @@
 
 #include "../../BEWindow.hpp"
 #include "../../BEPipeline.hpp"
-#include "../../game/BEGameObject.hpp"
+#include "../../game/BEComponents.hpp"
 #include "../../BEDevice.hpp"
 #include "../../camera/BECamera.hpp"
 #include "../BEFrameInfo.hpp"
@@ -22,18 +22,29 @@ namespace bucketengine
     class BEPointLightSystem
     {
     public:
-        BEPointLightSystem(BEDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+        // objectIdAttachment must match the render target, see BESwapChain
+        BEPointLightSystem(
+            BEDevice &device,
+            const RenderTargetInfo& renderTarget,
+            VkDescriptorSetLayout globalSetLayout,
+            bool objectIdAttachment = false
+        );
         ~BEPointLightSystem();
 
         BEPointLightSystem(const BEPointLightSystem &) = delete;
         BEPointLightSystem &operator=(const BEPointLightSystem &) = delete;
 
         void render(FrameInfo &frameInfo);
+
+        // rebuilds the pipeline for a render target with a new render pass or new formats, the old pipeline is
+        // retired while frames may still use it
+        void setRenderTarget(const RenderTargetInfo& renderTarget);
     private:
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-        void createPipeline(VkRenderPass renderPass);
+        void createPipeline(const RenderTargetInfo& renderTarget, bool objectIdAttachment);
 
         BEDevice &beDevice;
+        bool objectIdAttachment;
 
         std::unique_ptr<BEPipeline> bePipeline;
         VkPipelineLayout pipelineLayout;
@@ -5,15 +5,19 @@
 
 namespace bucketengine
 {
-    BERenderSystem::BERenderSystem(BEDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : beDevice{device}
+    BERenderSystem::BERenderSystem(
+        BEDevice &device,
+        const RenderTargetInfo& renderTarget,
+        VkDescriptorSetLayout globalSetLayout,
+        bool objectIdAttachment) : beDevice{device}, objectIdAttachment{objectIdAttachment}
     {
         createPipelineLayout(globalSetLayout);
-        createPipeline(renderPass);
+        createPipeline(renderTarget, objectIdAttachment);
     }
 
     BERenderSystem::~BERenderSystem()
     {
-        vkDestroyPipelineLayout(beDevice.device(), pipelineLayout, nullptr);
+        beDevice.deletionQueue().retirePipelineLayout(pipelineLayout);
     }
 
     void BERenderSystem::renderGameObjects(FrameInfo &frameInfo)
@@ -31,13 +35,12 @@ namespace bucketengine
             nullptr
         );
 
-        for (auto& kv: frameInfo.gameObjects)
+        for (const RenderSnapshot::ModelDraw& draw : frameInfo.snapshot.draws)
         {
-            auto& obj = kv.second;
-            if (obj.model == nullptr) continue;
             SimplePushConstantData push{};
-            push.modelMatrix = obj.transform.mat4();
-            push.normalMatrix = obj.transform.normalMatrix();
+            push.modelMatrix = draw.modelMatrix;
+            push.normalMatrix = draw.normalMatrix;
+            push.objectId = draw.entity;
 
             vkCmdPushConstants(
                 frameInfo.commandBuffer,
@@ -48,11 +51,16 @@ namespace bucketengine
                 &push
             );
 
-            obj.model->bind(frameInfo.commandBuffer);
-            obj.model->draw(frameInfo.commandBuffer);
+            draw.model->bind(frameInfo.commandBuffer);
+            draw.model->draw(frameInfo.commandBuffer);
         }
     }
 
+    void BERenderSystem::setRenderTarget(const RenderTargetInfo& renderTarget)
+    {
+        createPipeline(renderTarget, objectIdAttachment);
+    }
+
     void BERenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
     {
         VkPushConstantRange pushConstantRange{};
@@ -75,12 +83,16 @@ namespace bucketengine
         }
     }
 
-    void BERenderSystem::createPipeline(VkRenderPass renderPass)
+    void BERenderSystem::createPipeline(const RenderTargetInfo& renderTarget, bool objectIdAttachment)
     {
         assert(pipelineLayout != nullptr && "Attempting to create pipeline with nullptr pipeline layout");
         PipelineConfigInfo pipelineConfigInfo{};
         BEPipeline::defaultPipelineConfigInfo(pipelineConfigInfo);
-        pipelineConfigInfo.renderPass = renderPass;
+        if (objectIdAttachment)
+        {
+            BEPipeline::addObjectIdAttachment(pipelineConfigInfo, true);
+        }
+        BEPipeline::setRenderTarget(pipelineConfigInfo, renderTarget);
         pipelineConfigInfo.pipelineLayout = pipelineLayout;
         bePipeline = std::make_unique<BEPipeline>(
             beDevice,
@@ -2,7 +2,7 @@
 
 #include "../../BEWindow.hpp"
 #include "../../BEPipeline.hpp"
-#include "../../game/BEGameObject.hpp"
+#include "../../game/BEComponents.hpp"
 #include "../../BEDevice.hpp"
 #include "../../camera/BECamera.hpp"
 #include "../BEFrameInfo.hpp"
@@ -23,27 +23,44 @@ namespace bucketengine
     // When using 32bit float precision, scalar float N = 4 bytes
     // therefore vec2 is 8 bytes
     // in device memory, we require the alignment to be explicit
+    // the normal matrix is a mat3 padded to three vec4 columns, which leaves room in the last column
+    // for the id written into the swap chain's object id attachment
     struct SimplePushConstantData
     {
         glm::mat4 modelMatrix{1.f};
-        glm::mat4 normalMatrix{1.f};
+        glm::mat3x4 normalMatrix{1.f};
+        uint32_t objectId = NULL_ENTITY;
+        uint32_t padding[3]{};
     };
+    // 128 bytes is the smallest push constant limit vulkan guarantees
+    static_assert(sizeof(SimplePushConstantData) == 128, "SimplePushConstantData must fit the guaranteed push constant size");
 
     class BERenderSystem
     {
     public:
-        BERenderSystem(BEDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+        // objectIdAttachment must match the render target, see BESwapChain
+        BERenderSystem(
+            BEDevice &device,
+            const RenderTargetInfo& renderTarget,
+            VkDescriptorSetLayout globalSetLayout,
+            bool objectIdAttachment = false
+        );
         ~BERenderSystem();
 
         BERenderSystem(const BERenderSystem &) = delete;
         BERenderSystem &operator=(const BERenderSystem &) = delete;
 
         void renderGameObjects(FrameInfo &frameInfo);
+
+        // rebuilds the pipeline for a render target with a new render pass or new formats, the old pipeline is
+        // retired while frames may still use it
+        void setRenderTarget(const RenderTargetInfo& renderTarget);
     private:
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-        void createPipeline(VkRenderPass renderPass);
+        void createPipeline(const RenderTargetInfo& renderTarget, bool objectIdAttachment);
 
         BEDevice &beDevice;
+        bool objectIdAttachment;
 
         std::unique_ptr<BEPipeline> bePipeline;
         VkPipelineLayout pipelineLayout;
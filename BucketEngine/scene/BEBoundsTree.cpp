@@ -0,0 +1,433 @@
+﻿#include "BEBoundsTree.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace bucketengine
+{
+    namespace
+    {
+        // bit i is set if ray i of the packet enters the bounds within its max distance
+        using PacketMaskFn = uint32_t (*)(const RayPacket& packet, const AABB& bounds);
+
+        uint32_t packetMaskScalar(const RayPacket& packet, const AABB& bounds)
+        {
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < packet.count; i++)
+            {
+                float distance;
+                if (bounds.intersectRay(
+                    glm::vec3{packet.originX[i], packet.originY[i], packet.originZ[i]},
+                    glm::vec3{packet.inverseDirectionX[i], packet.inverseDirectionY[i], packet.inverseDirectionZ[i]},
+                    packet.maxDistance[i],
+                    distance))
+                {
+                    mask |= 1u << i;
+                }
+            }
+            return mask;
+        }
+
+#ifdef BE_SIMD_X86
+        // the same slab test as AABB::intersectRay, four rays at a time
+        BE_TARGET_SSE4 uint32_t packetMaskSSE(const RayPacket& packet, const AABB& bounds)
+        {
+            const __m128 minX = _mm_set1_ps(bounds.min.x);
+            const __m128 minY = _mm_set1_ps(bounds.min.y);
+            const __m128 minZ = _mm_set1_ps(bounds.min.z);
+            const __m128 maxX = _mm_set1_ps(bounds.max.x);
+            const __m128 maxY = _mm_set1_ps(bounds.max.y);
+            const __m128 maxZ = _mm_set1_ps(bounds.max.z);
+
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < packet.count; i += 4)
+            {
+                const __m128 originX = _mm_load_ps(packet.originX + i);
+                const __m128 originY = _mm_load_ps(packet.originY + i);
+                const __m128 originZ = _mm_load_ps(packet.originZ + i);
+                const __m128 inverseX = _mm_load_ps(packet.inverseDirectionX + i);
+                const __m128 inverseY = _mm_load_ps(packet.inverseDirectionY + i);
+                const __m128 inverseZ = _mm_load_ps(packet.inverseDirectionZ + i);
+
+                const __m128 t1x = _mm_mul_ps(_mm_sub_ps(minX, originX), inverseX);
+                const __m128 t2x = _mm_mul_ps(_mm_sub_ps(maxX, originX), inverseX);
+                const __m128 t1y = _mm_mul_ps(_mm_sub_ps(minY, originY), inverseY);
+                const __m128 t2y = _mm_mul_ps(_mm_sub_ps(maxY, originY), inverseY);
+                const __m128 t1z = _mm_mul_ps(_mm_sub_ps(minZ, originZ), inverseZ);
+                const __m128 t2z = _mm_mul_ps(_mm_sub_ps(maxZ, originZ), inverseZ);
+
+                const __m128 enterDistance = _mm_max_ps(
+                    _mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)),
+                    _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+                const __m128 exitDistance = _mm_min_ps(
+                    _mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)),
+                    _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_load_ps(packet.maxDistance + i)));
+
+                mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(enterDistance, exitDistance))) << i;
+            }
+            return mask;
+        }
+
+        // the same slab test as AABB::intersectRay, a whole packet at once
+        BE_TARGET_AVX2 uint32_t packetMaskAVX(const RayPacket& packet, const AABB& bounds)
+        {
+            const __m256 originX = _mm256_load_ps(packet.originX);
+            const __m256 originY = _mm256_load_ps(packet.originY);
+            const __m256 originZ = _mm256_load_ps(packet.originZ);
+            const __m256 inverseX = _mm256_load_ps(packet.inverseDirectionX);
+            const __m256 inverseY = _mm256_load_ps(packet.inverseDirectionY);
+            const __m256 inverseZ = _mm256_load_ps(packet.inverseDirectionZ);
+
+            const __m256 t1x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.x), originX), inverseX);
+            const __m256 t2x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.max.x), originX), inverseX);
+            const __m256 t1y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.y), originY), inverseY);
+            const __m256 t2y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.max.y), originY), inverseY);
+            const __m256 t1z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.z), originZ), inverseZ);
+            const __m256 t2z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.max.z), originZ), inverseZ);
+
+            const __m256 enterDistance = _mm256_max_ps(
+                _mm256_max_ps(_mm256_min_ps(t1x, t2x), _mm256_min_ps(t1y, t2y)),
+                _mm256_max_ps(_mm256_min_ps(t1z, t2z), _mm256_setzero_ps()));
+            const __m256 exitDistance = _mm256_min_ps(
+                _mm256_min_ps(_mm256_max_ps(t1x, t2x), _mm256_max_ps(t1y, t2y)),
+                _mm256_min_ps(_mm256_max_ps(t1z, t2z), _mm256_load_ps(packet.maxDistance)));
+
+            return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(enterDistance, exitDistance, _CMP_LE_OQ)));
+        }
+#endif
+
+        PacketMaskFn selectPacketMask(SimdLevel level)
+        {
+#ifdef BE_SIMD_X86
+            // never run a path the cpu can't execute, even when asked to
+            level = std::min(level, getSimdLevel());
+            if (level == SimdLevel::AVX2) return packetMaskAVX;
+            if (level == SimdLevel::SSE4) return packetMaskSSE;
+#else
+            (void)level;
+#endif
+            return packetMaskScalar;
+        }
+    }
+
+    uint32_t BEBoundsTree::createProxy(const AABB& bounds, Entity entity)
+    {
+        uint32_t proxy = allocateNode();
+        nodes[proxy].bounds = bounds.inflated(FAT_MARGIN);
+        nodes[proxy].entity = entity;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        proxyCount++;
+        return proxy;
+    }
+
+    void BEBoundsTree::destroyProxy(uint32_t proxy)
+    {
+        assert(proxy < nodes.size() && nodes[proxy].isLeaf() && nodes[proxy].height == 0 && "Invalid bounds proxy");
+        removeLeaf(proxy);
+        freeNode(proxy);
+        proxyCount--;
+    }
+
+    bool BEBoundsTree::moveProxy(uint32_t proxy, const AABB& bounds)
+    {
+        assert(proxy < nodes.size() && nodes[proxy].isLeaf() && nodes[proxy].height == 0 && "Invalid bounds proxy");
+        if (nodes[proxy].bounds.contains(bounds)) return false;
+
+        removeLeaf(proxy);
+        nodes[proxy].bounds = bounds.inflated(FAT_MARGIN);
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void BEBoundsTree::clear()
+    {
+        nodes.clear();
+        root = NULL_NODE;
+        freeList = NULL_NODE;
+        proxyCount = 0;
+    }
+
+    uint32_t BEBoundsTree::allocateNode()
+    {
+        if (freeList == NULL_NODE)
+        {
+            nodes.emplace_back();
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+
+        uint32_t index = freeList;
+        freeList = nodes[index].parent;
+        nodes[index] = Node{};
+        return index;
+    }
+
+    void BEBoundsTree::freeNode(uint32_t index)
+    {
+        nodes[index] = Node{};
+        nodes[index].parent = freeList;
+        freeList = index;
+    }
+
+    void BEBoundsTree::insertLeaf(uint32_t leaf)
+    {
+        if (root == NULL_NODE)
+        {
+            root = leaf;
+            nodes[leaf].parent = NULL_NODE;
+            return;
+        }
+
+        // walk down to the sibling that adds the least surface area. making a new parent here costs
+        // the area of the combined box, and every ancestor above grows by the same amount
+        const AABB leafBounds = nodes[leaf].bounds;
+        uint32_t index = root;
+        while (!nodes[index].isLeaf())
+        {
+            const Node& node = nodes[index];
+            float area = node.bounds.surfaceArea();
+            float combinedArea = node.bounds.merged(leafBounds).surfaceArea();
+
+            float cost = 2.f * combinedArea;
+            float inheritedCost = 2.f * (combinedArea - area);
+
+            auto descendCost = [&](uint32_t child)
+            {
+                const AABB& childBounds = nodes[child].bounds;
+                float grownArea = childBounds.merged(leafBounds).surfaceArea();
+                return nodes[child].isLeaf()
+                    ? grownArea + inheritedCost
+                    : grownArea - childBounds.surfaceArea() + inheritedCost;
+            };
+            float cost1 = descendCost(node.child1);
+            float cost2 = descendCost(node.child2);
+
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        const uint32_t sibling = index;
+        const uint32_t oldParent = nodes[sibling].parent;
+        const uint32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].bounds = nodes[sibling].bounds.merged(leafBounds);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent == NULL_NODE)
+        {
+            root = newParent;
+        }
+        else if (nodes[oldParent].child1 == sibling)
+        {
+            nodes[oldParent].child1 = newParent;
+        }
+        else
+        {
+            nodes[oldParent].child2 = newParent;
+        }
+
+        // the new parent can be unbalanced already when the sibling was a tall subtree
+        refitAncestors(newParent);
+    }
+
+    void BEBoundsTree::removeLeaf(uint32_t leaf)
+    {
+        if (leaf == root)
+        {
+            root = NULL_NODE;
+            return;
+        }
+
+        // the leaf's parent goes away and the sibling takes its place
+        const uint32_t parent = nodes[leaf].parent;
+        const uint32_t grandParent = nodes[parent].parent;
+        const uint32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent == NULL_NODE)
+        {
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+            freeNode(parent);
+            return;
+        }
+
+        if (nodes[grandParent].child1 == parent)
+        {
+            nodes[grandParent].child1 = sibling;
+        }
+        else
+        {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        refitAncestors(grandParent);
+    }
+
+    void BEBoundsTree::refitAncestors(uint32_t index)
+    {
+        while (index != NULL_NODE)
+        {
+            index = balance(index);
+
+            Node& node = nodes[index];
+            const Node& child1 = nodes[node.child1];
+            const Node& child2 = nodes[node.child2];
+            node.height = 1 + std::max(child1.height, child2.height);
+            node.bounds = child1.bounds.merged(child2.bounds);
+
+            index = node.parent;
+        }
+    }
+
+    uint32_t BEBoundsTree::balance(uint32_t indexA)
+    {
+        Node& a = nodes[indexA];
+        if (a.isLeaf() || a.height < 2) return indexA;
+
+        const uint32_t indexB = a.child1;
+        const uint32_t indexC = a.child2;
+        Node& b = nodes[indexB];
+        Node& c = nodes[indexC];
+
+        // points a's parent, or the root, at the node replacing a
+        auto replaceInParent = [this, indexA](uint32_t replacement, uint32_t parent)
+        {
+            if (parent == NULL_NODE)
+            {
+                root = replacement;
+            }
+            else if (nodes[parent].child1 == indexA)
+            {
+                nodes[parent].child1 = replacement;
+            }
+            else
+            {
+                nodes[parent].child2 = replacement;
+            }
+        };
+
+        const int heightDifference = c.height - b.height;
+        if (heightDifference > 1)
+        {
+            // c moves up, a becomes its child and keeps the shorter of c's children
+            const uint32_t indexF = c.child1;
+            const uint32_t indexG = c.child2;
+            Node& f = nodes[indexF];
+            Node& g = nodes[indexG];
+
+            c.child1 = indexA;
+            c.parent = a.parent;
+            a.parent = indexC;
+            replaceInParent(indexC, c.parent);
+
+            if (f.height > g.height)
+            {
+                c.child2 = indexF;
+                a.child2 = indexG;
+                g.parent = indexA;
+                a.bounds = b.bounds.merged(g.bounds);
+                a.height = 1 + std::max(b.height, g.height);
+                c.bounds = a.bounds.merged(f.bounds);
+                c.height = 1 + std::max(a.height, f.height);
+            }
+            else
+            {
+                c.child2 = indexG;
+                a.child2 = indexF;
+                f.parent = indexA;
+                a.bounds = b.bounds.merged(f.bounds);
+                a.height = 1 + std::max(b.height, f.height);
+                c.bounds = a.bounds.merged(g.bounds);
+                c.height = 1 + std::max(a.height, g.height);
+            }
+            return indexC;
+        }
+
+        if (heightDifference < -1)
+        {
+            // b moves up, mirrored
+            const uint32_t indexD = b.child1;
+            const uint32_t indexE = b.child2;
+            Node& d = nodes[indexD];
+            Node& e = nodes[indexE];
+
+            b.child1 = indexA;
+            b.parent = a.parent;
+            a.parent = indexB;
+            replaceInParent(indexB, b.parent);
+
+            if (d.height > e.height)
+            {
+                b.child2 = indexD;
+                a.child1 = indexE;
+                e.parent = indexA;
+                a.bounds = c.bounds.merged(e.bounds);
+                a.height = 1 + std::max(c.height, e.height);
+                b.bounds = a.bounds.merged(d.bounds);
+                b.height = 1 + std::max(a.height, d.height);
+            }
+            else
+            {
+                b.child2 = indexE;
+                a.child1 = indexD;
+                d.parent = indexA;
+                a.bounds = c.bounds.merged(d.bounds);
+                a.height = 1 + std::max(c.height, d.height);
+                b.bounds = a.bounds.merged(e.bounds);
+                b.height = 1 + std::max(a.height, e.height);
+            }
+            return indexB;
+        }
+
+        return indexA;
+    }
+
+    void BEBoundsTree::raycastPacketWith(RayPacket& packet, void* context, PacketLeafFn fn, SimdLevel level) const
+    {
+        if (root == NULL_NODE || packet.count == 0) return;
+
+        // the kernels read all MAX_RAYS lanes, RayPacket::clear keeps the unused ones from hitting
+        const PacketMaskFn packetMask = selectPacketMask(level);
+        const uint32_t activeRays = (1u << packet.count) - 1;
+
+        // a balanced tree over 32bit proxy ids is far shallower than this
+        std::array<uint32_t, 128> stack;
+        size_t stackSize = 0;
+        stack[stackSize++] = root;
+        while (stackSize > 0)
+        {
+            const Node& node = nodes[stack[--stackSize]];
+            uint32_t mask = packetMask(packet, node.bounds) & activeRays;
+            if (mask == 0) continue;
+
+            if (node.isLeaf())
+            {
+                for (; mask != 0; mask &= mask - 1)
+                {
+                    uint32_t ray = 0;
+                    while ((mask & (1u << ray)) == 0) ray++;
+                    packet.maxDistance[ray] = fn(context, ray, node.entity, packet.maxDistance[ray]);
+                }
+                continue;
+            }
+
+            // push the child the lead ray reaches later first, so the nearer one is visited first
+            // and its hits can cull the other
+            const AABB& bounds1 = nodes[node.child1].bounds;
+            const AABB& bounds2 = nodes[node.child2].bounds;
+            const bool child1First = glm::dot(bounds2.min + bounds2.max - bounds1.min - bounds1.max, packet.leadDirection) > 0.f;
+
+            assert(stackSize + 2 <= stack.size() && "Bounds tree is too deep");
+            stack[stackSize++] = child1First ? node.child2 : node.child1;
+            stack[stackSize++] = child1First ? node.child1 : node.child2;
+        }
+    }
+}
@@ -0,0 +1,214 @@
+﻿#pragma once
+
+#include "../ecs/BERegistry.hpp"
+#include "../utils/BEBounds.hpp"
+#include "../utils/BESimd.hpp"
+
+// std
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace bucketengine
+{
+    // up to MAX_RAYS rays in structure of arrays form, so BEBoundsTree::raycastPacket can test all
+    // of them against a node at once. lanes past count never hit anything
+    struct RayPacket
+    {
+        static constexpr uint32_t MAX_RAYS = 8;
+
+        alignas(32) float originX[MAX_RAYS];
+        alignas(32) float originY[MAX_RAYS];
+        alignas(32) float originZ[MAX_RAYS];
+        alignas(32) float inverseDirectionX[MAX_RAYS];
+        alignas(32) float inverseDirectionY[MAX_RAYS];
+        alignas(32) float inverseDirectionZ[MAX_RAYS];
+        // shrinks to the closest hit of each ray during the traversal
+        alignas(32) float maxDistance[MAX_RAYS];
+        // children are visited in the order the first ray reaches them
+        glm::vec3 leadDirection{};
+        uint32_t count = 0;
+
+        void clear()
+        {
+            for (uint32_t i = 0; i < MAX_RAYS; i++)
+            {
+                originX[i] = originY[i] = originZ[i] = 0.f;
+                inverseDirectionX[i] = inverseDirectionY[i] = inverseDirectionZ[i] = 0.f;
+                maxDistance[i] = -1.f;
+            }
+            count = 0;
+        }
+
+        // returns the ray's lane
+        uint32_t add(const glm::vec3& origin, const glm::vec3& direction, float distance)
+        {
+            assert(count < MAX_RAYS && "Ray packet is full");
+            if (count == 0) leadDirection = direction;
+
+            originX[count] = origin.x;
+            originY[count] = origin.y;
+            originZ[count] = origin.z;
+            inverseDirectionX[count] = 1.f / direction.x;
+            inverseDirectionY[count] = 1.f / direction.y;
+            inverseDirectionZ[count] = 1.f / direction.z;
+            maxDistance[count] = distance;
+            return count++;
+        }
+    };
+
+    // dynamic bounding volume hierarchy over entity bounds. leaves store the bounds inflated by
+    // FAT_MARGIN so small movements don't touch the tree at all, and when an object does leave its
+    // fat bounds only its leaf is removed and reinserted. insertion picks the sibling that grows the
+    // total surface area least and the tree is kept height balanced with AVL style rotations, so
+    // queries stay logarithmic however the objects move
+    class BEBoundsTree
+    {
+    public:
+        static constexpr uint32_t NULL_NODE = ~uint32_t{0};
+        static constexpr float FAT_MARGIN = 0.1f;
+
+        BEBoundsTree() = default;
+
+        BEBoundsTree(const BEBoundsTree&) = delete;
+        BEBoundsTree& operator=(const BEBoundsTree&) = delete;
+
+        // returns a proxy id that stays valid until destroyProxy
+        uint32_t createProxy(const AABB& bounds, Entity entity);
+        void destroyProxy(uint32_t proxy);
+        // returns true if the proxy left its fat bounds and had to be reinserted
+        bool moveProxy(uint32_t proxy, const AABB& bounds);
+        void clear();
+
+        Entity getEntity(uint32_t proxy) const { return nodes[proxy].entity; }
+        const AABB& getFatBounds(uint32_t proxy) const { return nodes[proxy].bounds; }
+        size_t getProxyCount() const { return proxyCount; }
+        int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+        /**
+         * Visit the leaves whose fat bounds the ray passes through, nearest first.
+         *
+         * Subtrees further away than the closest hit so far are skipped, so a ray through a dense
+         * scene only looks at a handful of leaves.
+         *
+         * @param origin Start of the ray
+         * @param direction Direction of the ray, distances are in multiples of its length
+         * @param maxDistance Ignore anything further along the ray than this
+         * @param fn Called as float fn(Entity entity, float maxDistance), returns the distance of the
+         *           hit with that entity if it is closer than maxDistance and maxDistance otherwise
+         */
+        template <typename Fn>
+        void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn&& fn) const
+        {
+            if (root == NULL_NODE) return;
+
+            const glm::vec3 inverseDirection = 1.f / direction;
+            float distance;
+            if (!nodes[root].bounds.intersectRay(origin, inverseDirection, maxDistance, distance)) return;
+
+            // nodes are pushed with the distance the ray enters them at, nearer child on top
+            std::vector<std::pair<uint32_t, float>> stack{};
+            stack.reserve(64);
+            stack.push_back({root, distance});
+            while (!stack.empty())
+            {
+                auto [index, enter] = stack.back();
+                stack.pop_back();
+                if (enter > maxDistance) continue;
+
+                const Node& node = nodes[index];
+                if (node.isLeaf())
+                {
+                    maxDistance = fn(node.entity, maxDistance);
+                    continue;
+                }
+
+                float enter1;
+                float enter2;
+                bool hit1 = nodes[node.child1].bounds.intersectRay(origin, inverseDirection, maxDistance, enter1);
+                bool hit2 = nodes[node.child2].bounds.intersectRay(origin, inverseDirection, maxDistance, enter2);
+                if (hit1 && hit2)
+                {
+                    if (enter1 < enter2)
+                    {
+                        stack.push_back({node.child2, enter2});
+                        stack.push_back({node.child1, enter1});
+                    }
+                    else
+                    {
+                        stack.push_back({node.child1, enter1});
+                        stack.push_back({node.child2, enter2});
+                    }
+                }
+                else if (hit1)
+                {
+                    stack.push_back({node.child1, enter1});
+                }
+                else if (hit2)
+                {
+                    stack.push_back({node.child2, enter2});
+                }
+            }
+        }
+
+        // type erased leaf function for raycastPacket, keeps the simd kernels out of the header
+        using PacketLeafFn = float (*)(void* context, uint32_t ray, Entity entity, float maxDistance);
+        void raycastPacketWith(RayPacket& packet, void* context, PacketLeafFn fn, SimdLevel level) const;
+
+        /**
+         * Visit the leaves a packet of rays passes through, each node is tested against every ray of
+         * the packet in one go with the widest simd path available.
+         *
+         * Rays that start close together and point the same way share most of their path through
+         * the tree, which is where packets pay off. Incoherent packets are still correct, they just
+         * visit the union of the rays' paths.
+         *
+         * @param packet The rays, packet.maxDistance holds each ray's closest hit afterwards
+         * @param fn Called as float fn(uint32_t ray, Entity entity, float maxDistance) for every ray
+         *           whose path reaches the entity's leaf, returns the ray's new max distance like
+         *           raycast's fn
+         * @param level (Optional) Forces a code path, levels the cpu doesn't support fall back
+         */
+        template <typename Fn>
+        void raycastPacket(RayPacket& packet, Fn&& fn, SimdLevel level = getSimdLevel()) const
+        {
+            raycastPacketWith(packet, &fn, [](void* context, uint32_t ray, Entity entity, float maxDistance)
+            {
+                return (*static_cast<std::remove_reference_t<Fn>*>(context))(ray, entity, maxDistance);
+            }, level);
+        }
+
+    private:
+        struct Node
+        {
+            AABB bounds{};
+            // doubles as the next free node while the node is on the free list
+            uint32_t parent = NULL_NODE;
+            uint32_t child1 = NULL_NODE;
+            uint32_t child2 = NULL_NODE;
+            // leaves are 0, free nodes -1
+            int height = -1;
+            Entity entity = NULL_ENTITY;
+
+            bool isLeaf() const { return child1 == NULL_NODE; }
+        };
+
+        uint32_t allocateNode();
+        void freeNode(uint32_t index);
+
+        void insertLeaf(uint32_t leaf);
+        void removeLeaf(uint32_t leaf);
+        // refits bounds and heights from index up to the root, rebalancing on the way
+        void refitAncestors(uint32_t index);
+        // rotates the taller grandchild of index up if its children differ in height by more than one,
+        // returns the node now in index's place
+        uint32_t balance(uint32_t index);
+
+        std::vector<Node> nodes{};
+        uint32_t root = NULL_NODE;
+        uint32_t freeList = NULL_NODE;
+        size_t proxyCount = 0;
+    };
+}
@@ -0,0 +1,312 @@
+﻿#include "BEMeshBVH.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+namespace bucketengine
+{
+    BEMeshBVH::BEMeshBVH(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+    {
+        const size_t triangleCount = indices.empty() ? positions.size() / 3 : indices.size() / 3;
+        auto vertex = [&](size_t triangle, size_t corner) -> const glm::vec3&
+        {
+            return indices.empty() ? positions[triangle * 3 + corner] : positions[indices[triangle * 3 + corner]];
+        };
+
+        std::vector<BuildTriangle> buildTriangles(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            AABB triangleBounds{};
+            triangleBounds.expand(vertex(i, 0));
+            triangleBounds.expand(vertex(i, 1));
+            triangleBounds.expand(vertex(i, 2));
+            buildTriangles[i] = {triangleBounds, triangleBounds.center()};
+        }
+
+        std::vector<uint32_t> order(triangleCount);
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            order[i] = static_cast<uint32_t>(i);
+        }
+
+        build(buildTriangles, order);
+
+        // copy the triangles into leaf order
+        triangles.resize(triangleCount);
+        triangleIds = std::move(order);
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            const glm::vec3& v0 = vertex(triangleIds[i], 0);
+            triangles[i] = {v0, vertex(triangleIds[i], 1) - v0, vertex(triangleIds[i], 2) - v0};
+        }
+    }
+
+    void BEMeshBVH::build(const std::vector<BuildTriangle>& buildTriangles, std::vector<uint32_t>& order)
+    {
+        nodes.clear();
+        if (order.empty()) return;
+
+        // a binary tree with n leaves has 2n - 1 nodes, and leaves hold at least one triangle
+        nodes.reserve(order.size() * 2);
+        nodes.push_back(Node{});
+        nodes[0].leftOrFirst = 0;
+        nodes[0].triangleCount = static_cast<uint32_t>(order.size());
+
+        struct BuildEntry
+        {
+            uint32_t node;
+            uint32_t depth;
+        };
+
+        std::vector<BuildEntry> stack{{0, 0}};
+        while (!stack.empty())
+        {
+            const uint32_t index = stack.back().node;
+            const uint32_t depth = stack.back().depth;
+            stack.pop_back();
+
+            // fit the node around its triangles
+            AABB nodeBounds{};
+            const uint32_t first = nodes[index].leftOrFirst;
+            const uint32_t count = nodes[index].triangleCount;
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                nodeBounds = nodeBounds.merged(buildTriangles[order[i]].bounds);
+            }
+            nodes[index].min = nodeBounds.min;
+            nodes[index].max = nodeBounds.max;
+
+            if (count <= MAX_LEAF_TRIANGLES || depth >= MAX_DEPTH) continue;
+
+            int axis;
+            float position;
+            const float splitCost = findSplit(nodes[index], buildTriangles, order, axis, position);
+            // a leaf costs one intersection test per triangle for every ray that reaches it
+            const float leafCost = static_cast<float>(count) * nodeBounds.surfaceArea();
+            if (splitCost >= leafCost) continue;
+
+            // partition the triangles around the split plane
+            uint32_t i = first;
+            uint32_t j = first + count;
+            while (i < j)
+            {
+                if (buildTriangles[order[i]].centroid[axis] < position)
+                {
+                    i++;
+                }
+                else
+                {
+                    std::swap(order[i], order[--j]);
+                }
+            }
+
+            const uint32_t leftCount = i - first;
+            if (leftCount == 0 || leftCount == count) continue;
+
+            const uint32_t left = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(Node{glm::vec3{}, first, glm::vec3{}, leftCount});
+            nodes.push_back(Node{glm::vec3{}, i, glm::vec3{}, count - leftCount});
+            nodes[index].leftOrFirst = left;
+            nodes[index].triangleCount = 0;
+
+            stack.push_back({left + 1, depth + 1});
+            stack.push_back({left, depth + 1});
+        }
+
+        bounds = AABB{nodes[0].min, nodes[0].max};
+        nodes.shrink_to_fit();
+    }
+
+    float BEMeshBVH::findSplit(
+        const Node& node,
+        const std::vector<BuildTriangle>& buildTriangles,
+        const std::vector<uint32_t>& order,
+        int& axis,
+        float& position
+    ) const
+    {
+        struct Bin
+        {
+            AABB bounds{};
+            uint32_t count = 0;
+        };
+
+        const uint32_t first = node.leftOrFirst;
+        const uint32_t count = node.triangleCount;
+
+        float bestCost = std::numeric_limits<float>::infinity();
+        for (int a = 0; a < 3; a++)
+        {
+            // bin by centroid, the node bounds can be much wider than the centroids
+            float centroidMin = std::numeric_limits<float>::max();
+            float centroidMax = -std::numeric_limits<float>::max();
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                float centroid = buildTriangles[order[i]].centroid[a];
+                centroidMin = std::min(centroidMin, centroid);
+                centroidMax = std::max(centroidMax, centroid);
+            }
+            if (centroidMax <= centroidMin) continue;
+
+            std::array<Bin, SAH_BINS> bins{};
+            const float scale = SAH_BINS / (centroidMax - centroidMin);
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                const BuildTriangle& triangle = buildTriangles[order[i]];
+                uint32_t bin = std::min(SAH_BINS - 1, static_cast<uint32_t>((triangle.centroid[a] - centroidMin) * scale));
+                bins[bin].count++;
+                bins[bin].bounds = bins[bin].bounds.merged(triangle.bounds);
+            }
+
+            // sweep from both ends so every plane between bins is evaluated in linear time
+            std::array<float, SAH_BINS - 1> leftArea{};
+            std::array<float, SAH_BINS - 1> rightArea{};
+            std::array<uint32_t, SAH_BINS - 1> leftCount{};
+            std::array<uint32_t, SAH_BINS - 1> rightCount{};
+            AABB leftBounds{};
+            AABB rightBounds{};
+            uint32_t leftSum = 0;
+            uint32_t rightSum = 0;
+            for (uint32_t i = 0; i < SAH_BINS - 1; i++)
+            {
+                leftSum += bins[i].count;
+                leftCount[i] = leftSum;
+                leftBounds = leftBounds.merged(bins[i].bounds);
+                leftArea[i] = leftSum > 0 ? leftBounds.surfaceArea() : 0.f;
+
+                rightSum += bins[SAH_BINS - 1 - i].count;
+                rightCount[SAH_BINS - 2 - i] = rightSum;
+                rightBounds = rightBounds.merged(bins[SAH_BINS - 1 - i].bounds);
+                rightArea[SAH_BINS - 2 - i] = rightSum > 0 ? rightBounds.surfaceArea() : 0.f;
+            }
+
+            for (uint32_t i = 0; i < SAH_BINS - 1; i++)
+            {
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    axis = a;
+                    position = centroidMin + (i + 1) / scale;
+                }
+            }
+        }
+        return bestCost;
+    }
+
+    bool BEMeshBVH::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, MeshRayHit& hit) const
+    {
+        if (nodes.empty()) return false;
+
+        const glm::vec3 inverseDirection = 1.f / direction;
+        auto enterDistance = [&](const Node& node, float limit)
+        {
+            float distance;
+            return AABB{node.min, node.max}.intersectRay(origin, inverseDirection, limit, distance)
+                ? distance
+                : std::numeric_limits<float>::infinity();
+        };
+
+        if (std::isinf(enterDistance(nodes[0], maxDistance))) return false;
+
+        struct StackEntry
+        {
+            uint32_t node;
+            float distance;
+        };
+
+        // at most one entry is pushed per level above the current node, and only interior nodes push,
+        // which are never deeper than MAX_DEPTH - 1
+        std::array<StackEntry, MAX_DEPTH> stack;
+        size_t stackSize = 0;
+        uint32_t index = 0;
+        uint32_t closest = NO_TRIANGLE;
+        glm::vec2 closestBarycentrics{};
+        while (true)
+        {
+            const Node& node = nodes[index];
+            if (node.triangleCount > 0)
+            {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.triangleCount; i++)
+                {
+                    // Möller Trumbore
+                    const Triangle& triangle = triangles[i];
+                    const glm::vec3 p = glm::cross(direction, triangle.edge2);
+                    const float determinant = glm::dot(triangle.edge1, p);
+                    if (std::abs(determinant) < 1e-12f) continue;
+
+                    const float inverseDeterminant = 1.f / determinant;
+                    const glm::vec3 s = origin - triangle.vertex0;
+                    const float u = glm::dot(s, p) * inverseDeterminant;
+                    if (u < 0.f || u > 1.f) continue;
+
+                    const glm::vec3 q = glm::cross(s, triangle.edge1);
+                    const float v = glm::dot(direction, q) * inverseDeterminant;
+                    if (v < 0.f || u + v > 1.f) continue;
+
+                    const float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+                    if (t >= 0.f && t < maxDistance)
+                    {
+                        maxDistance = t;
+                        closest = i;
+                        closestBarycentrics = glm::vec2{u, v};
+                    }
+                }
+            }
+            else
+            {
+                // visit the nearer child first, the further one only if it's still in range after
+                uint32_t nearChild = node.leftOrFirst;
+                uint32_t farChild = node.leftOrFirst + 1;
+                float nearDistance = enterDistance(nodes[nearChild], maxDistance);
+                float farDistance = enterDistance(nodes[farChild], maxDistance);
+                if (farDistance < nearDistance)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearDistance, farDistance);
+                }
+
+                if (!std::isinf(nearDistance))
+                {
+                    if (!std::isinf(farDistance))
+                    {
+                        assert(stackSize < stack.size() && "Mesh BVH is too deep");
+                        stack[stackSize++] = {farChild, farDistance};
+                    }
+                    index = nearChild;
+                    continue;
+                }
+            }
+
+            // pop the next subtree that can still contain something closer, a hit found since it
+            // was pushed may already be in front of it
+            bool found = false;
+            while (stackSize > 0)
+            {
+                const StackEntry& entry = stack[--stackSize];
+                if (entry.distance <= maxDistance)
+                {
+                    index = entry.node;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) break;
+        }
+
+        if (closest == NO_TRIANGLE) return false;
+
+        hit.distance = maxDistance;
+        hit.triangle = triangleIds[closest];
+        hit.barycentrics = closestBarycentrics;
+        return true;
+    }
+
+    size_t BEMeshBVH::getMemorySize() const
+    {
+        return nodes.size() * sizeof(Node) + triangles.size() * sizeof(Triangle) + triangleIds.size() * sizeof(uint32_t);
+    }
+}
@@ -0,0 +1,101 @@
+﻿#pragma once
+
+#include "../utils/BEBounds.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace bucketengine
+{
+    struct MeshRayHit
+    {
+        float distance = std::numeric_limits<float>::max();
+        // index of the triangle in the mesh's index buffer order, ie indices[3 * triangle]
+        uint32_t triangle = ~uint32_t{0};
+        // weights of the triangle's second and third vertex, the first one's is 1 - x - y
+        glm::vec2 barycentrics{};
+    };
+
+    // bounding volume hierarchy over the triangles of one mesh, for exact ray queries in model
+    // space. built top down with binned surface area heuristic splits and flattened depth first
+    // into 32 byte nodes whose children sit next to each other, and the triangles are copied
+    // into leaf order with their edges precomputed so a leaf is one contiguous read
+    class BEMeshBVH
+    {
+    public:
+        static constexpr uint32_t NO_TRIANGLE = ~uint32_t{0};
+        static constexpr uint32_t MAX_LEAF_TRIANGLES = 4;
+        static constexpr uint32_t SAH_BINS = 16;
+        // nodes this deep are left as leaves however many triangles they hold, which bounds the
+        // traversal stack no matter how skewed the mesh is
+        static constexpr uint32_t MAX_DEPTH = 64;
+
+        // indices is a triangle list, when empty every three positions make a triangle
+        BEMeshBVH(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+        BEMeshBVH(const BEMeshBVH&) = delete;
+        BEMeshBVH& operator=(const BEMeshBVH&) = delete;
+
+        /**
+         * Find the closest triangle a ray hits, triangles are hit from both sides.
+         *
+         * @param origin Start of the ray in model space
+         * @param direction Direction of the ray, distances are in multiples of its length
+         * @param maxDistance Ignore hits further along the ray than this
+         * @param hit Receives the closest hit, untouched when nothing is hit
+         *
+         * @return true if a triangle was hit within maxDistance
+         */
+        bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, MeshRayHit& hit) const;
+
+        const AABB& getBounds() const { return bounds; }
+        size_t getTriangleCount() const { return triangles.size(); }
+        size_t getNodeCount() const { return nodes.size(); }
+        size_t getMemorySize() const;
+
+    private:
+        struct Node
+        {
+            glm::vec3 min;
+            // first triangle for leaves, the left child for interior nodes. the right child is always left + 1
+            uint32_t leftOrFirst;
+            glm::vec3 max;
+            // zero for interior nodes
+            uint32_t triangleCount;
+        };
+        static_assert(sizeof(Node) == 32, "Mesh BVH nodes should fill half a cache line");
+
+        // everything Möller Trumbore needs
+        struct Triangle
+        {
+            glm::vec3 vertex0;
+            glm::vec3 edge1;
+            glm::vec3 edge2;
+        };
+
+        struct BuildTriangle
+        {
+            AABB bounds;
+            glm::vec3 centroid;
+        };
+
+        void build(const std::vector<BuildTriangle>& buildTriangles, std::vector<uint32_t>& order);
+        // returns the best split's cost, or infinity if no split beats the node's own bounds
+        float findSplit(
+            const Node& node,
+            const std::vector<BuildTriangle>& buildTriangles,
+            const std::vector<uint32_t>& order,
+            int& axis,
+            float& position
+        ) const;
+
+        std::vector<Node> nodes;
+        std::vector<Triangle> triangles;
+        // original triangle index of triangles[i]
+        std::vector<uint32_t> triangleIds;
+        AABB bounds{};
+    };
+}
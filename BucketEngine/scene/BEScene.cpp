@@ -0,0 +1,567 @@
+﻿#include "BEScene.hpp"
+
+#include "../assets/BEFileSystem.hpp"
+
+// std
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr char BINARY_MAGIC[4] = {'B', 'E', 'S', 'C'};
+        constexpr char TEXT_MAGIC[] = "bescene";
+
+        constexpr uint32_t MODEL_DEDUPLICATE_VERTICES = 1u << 0;
+        constexpr uint32_t MODEL_BUILD_RAY_BVH = 1u << 1;
+        constexpr uint32_t OBJECT_POINT_LIGHT = 1u << 0;
+
+        // the binary and text forms share the same model flags
+        uint32_t modelFlags(const BEModel::ImportSettings& settings)
+        {
+            return (settings.deduplicateVertices ? MODEL_DEDUPLICATE_VERTICES : 0)
+                | (settings.buildRayBVH ? MODEL_BUILD_RAY_BVH : 0);
+        }
+
+        BEModel::ImportSettings modelSettings(uint32_t flags)
+        {
+            BEModel::ImportSettings settings{};
+            settings.deduplicateVertices = (flags & MODEL_DEDUPLICATE_VERTICES) != 0;
+            settings.buildRayBVH = (flags & MODEL_BUILD_RAY_BVH) != 0;
+            return settings;
+        }
+
+        struct Header
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t modelCount;
+            uint32_t objectCount;
+            uint64_t pathsSize;
+        };
+
+        struct ModelRecord
+        {
+            uint32_t pathOffset;
+            uint32_t pathLength;
+            uint32_t flags;
+            uint32_t reserved;
+        };
+
+        struct ObjectRecord
+        {
+            int32_t model;      // index into the model records, -1 for none
+            uint32_t flags;
+            float translation[3];
+            float rotation[3];
+            float scale[3];
+            float color[3];
+            float lightIntensity;
+        };
+
+        // the part of the scene file that is the same for both formats
+        struct SceneModel
+        {
+            std::string path;
+            BEModel::ImportSettings settings;
+        };
+
+        // reserves every pool a scene writes to so creating the objects never reallocates
+        void reserveScene(BERegistry& registry, size_t objectCount)
+        {
+            registry.reserve(registry.size() + objectCount);
+            registry.reserve<TransformComponent>(registry.pool<TransformComponent>().size() + objectCount);
+            registry.reserve<ColorComponent>(registry.pool<ColorComponent>().size() + objectCount);
+            registry.reserve<ModelComponent>(registry.pool<ModelComponent>().size() + objectCount);
+        }
+
+        void createObject(
+            BERegistry& registry,
+            const ObjectRecord& record,
+            const std::vector<std::shared_ptr<BEModel>>& models)
+        {
+            Entity entity = registry.create();
+
+            TransformComponent& transform = registry.emplace<TransformComponent>(entity);
+            transform.translation = {record.translation[0], record.translation[1], record.translation[2]};
+            transform.rotation = {record.rotation[0], record.rotation[1], record.rotation[2]};
+            transform.scale = {record.scale[0], record.scale[1], record.scale[2]};
+
+            registry.emplace<ColorComponent>(entity, glm::vec3{record.color[0], record.color[1], record.color[2]});
+
+            if (record.model >= 0)
+            {
+                registry.emplace<ModelComponent>(entity, models[static_cast<size_t>(record.model)]);
+            }
+            if (record.flags & OBJECT_POINT_LIGHT)
+            {
+                registry.emplace<PointLightComponent>(entity, record.lightIntensity);
+            }
+        }
+
+        ObjectRecord makeRecord(const BERegistry& registry, Entity entity, int32_t model)
+        {
+            ObjectRecord record{};
+            record.model = model;
+            const TransformComponent& transform = registry.get<TransformComponent>(entity);
+            const ColorComponent* color = registry.tryGet<ColorComponent>(entity);
+            for (int i = 0; i < 3; i++)
+            {
+                record.translation[i] = transform.translation[i];
+                record.rotation[i] = transform.rotation[i];
+                record.scale[i] = transform.scale[i];
+                record.color[i] = color ? color->color[i] : 0.f;
+            }
+            if (const PointLightComponent* pointLight = registry.tryGet<PointLightComponent>(entity))
+            {
+                record.flags |= OBJECT_POINT_LIGHT;
+                record.lightIntensity = pointLight->lightIntensity;
+            }
+            return record;
+        }
+
+        std::vector<std::shared_ptr<BEModel>> requestModels(
+            const std::vector<SceneModel>& sceneModels,
+            BEAssetManager& assetManager)
+        {
+            std::vector<std::shared_ptr<BEModel>> models;
+            models.reserve(sceneModels.size());
+            for (const auto& sceneModel : sceneModels)
+            {
+                models.push_back(assetManager.loadModelAsync(sceneModel.path, sceneModel.settings));
+            }
+            return models;
+        }
+
+        void loadBinary(
+            const std::string& filePath,
+            const BEFileData& file,
+            BEAssetManager& assetManager,
+            BERegistry& registry)
+        {
+            const char* data = file.data();
+            const size_t size = file.size();
+
+            Header header;
+            if (size < sizeof(header))
+            {
+                throw std::runtime_error("Scene file is truncated: " + filePath);
+            }
+            std::memcpy(&header, data, sizeof(header));
+            if (header.version != BEScene::VERSION)
+            {
+                throw std::runtime_error("Unsupported scene version: " + filePath);
+            }
+
+            const uint64_t modelsOffset = sizeof(Header);
+            const uint64_t pathsOffset = modelsOffset + uint64_t{header.modelCount} * sizeof(ModelRecord);
+            const uint64_t objectsOffset = pathsOffset + header.pathsSize;
+            const uint64_t endOffset = objectsOffset + uint64_t{header.objectCount} * sizeof(ObjectRecord);
+            if (header.pathsSize > size || endOffset > size)
+            {
+                throw std::runtime_error("Scene file is truncated: " + filePath);
+            }
+
+            std::vector<SceneModel> sceneModels(header.modelCount);
+            for (uint32_t i = 0; i < header.modelCount; i++)
+            {
+                ModelRecord record;
+                std::memcpy(&record, data + modelsOffset + i * sizeof(ModelRecord), sizeof(record));
+                if (uint64_t{record.pathOffset} + record.pathLength > header.pathsSize)
+                {
+                    throw std::runtime_error("Scene model path is out of range: " + filePath);
+                }
+                sceneModels[i].path.assign(data + pathsOffset + record.pathOffset, record.pathLength);
+                sceneModels[i].settings = modelSettings(record.flags);
+            }
+
+            std::vector<std::shared_ptr<BEModel>> models = requestModels(sceneModels, assetManager);
+
+            reserveScene(registry, header.objectCount);
+
+            const char* objects = data + objectsOffset;
+            for (uint32_t i = 0; i < header.objectCount; i++)
+            {
+                ObjectRecord record;
+                std::memcpy(&record, objects + i * sizeof(ObjectRecord), sizeof(record));
+                if (record.model >= static_cast<int32_t>(models.size()))
+                {
+                    throw std::runtime_error("Scene object references a missing model: " + filePath);
+                }
+
+                createObject(registry, record, models);
+            }
+        }
+
+        // splits the text form into whitespace separated tokens, one line at a time, without
+        // copying anything out of the file
+        class TextReader
+        {
+        public:
+            TextReader(const std::string& filePath, const char* begin, const char* end)
+                : filePath{filePath}, cursor{begin}, end{end} {}
+
+            // moves to the next line that isn't blank or a comment, false at the end of the file
+            bool nextLine()
+            {
+                while (cursor < end)
+                {
+                    lineNumber++;
+                    const char* lineEnd = static_cast<const char*>(std::memchr(cursor, '\n', static_cast<size_t>(end - cursor)));
+                    if (lineEnd == nullptr)
+                    {
+                        lineEnd = end;
+                    }
+                    lineCursor = cursor;
+                    this->lineEnd = lineEnd;
+                    cursor = lineEnd < end ? lineEnd + 1 : end;
+
+                    const char* comment = static_cast<const char*>(std::memchr(lineCursor, '#', static_cast<size_t>(lineEnd - lineCursor)));
+                    if (comment != nullptr)
+                    {
+                        this->lineEnd = comment;
+                    }
+
+                    skipSpace();
+                    if (lineCursor < this->lineEnd)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            std::string_view token()
+            {
+                skipSpace();
+                const char* start = lineCursor;
+                while (lineCursor < lineEnd && !isSpace(*lineCursor))
+                {
+                    lineCursor++;
+                }
+                if (start == lineCursor)
+                {
+                    fail("missing value");
+                }
+                return std::string_view(start, static_cast<size_t>(lineCursor - start));
+            }
+
+            // everything left on the line with surrounding whitespace removed
+            std::string_view rest()
+            {
+                skipSpace();
+                const char* restEnd = lineEnd;
+                while (restEnd > lineCursor && isSpace(restEnd[-1]))
+                {
+                    restEnd--;
+                }
+                if (restEnd == lineCursor)
+                {
+                    fail("missing value");
+                }
+                std::string_view value(lineCursor, static_cast<size_t>(restEnd - lineCursor));
+                lineCursor = lineEnd;
+                return value;
+            }
+
+            template <typename T>
+            T number()
+            {
+                std::string_view text = token();
+                T value{};
+                auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+                if (result.ec != std::errc{} || result.ptr != text.data() + text.size())
+                {
+                    fail("expected a number but found '" + std::string(text) + "'");
+                }
+                return value;
+            }
+
+            void numbers(float* values, int count)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    values[i] = number<float>();
+                }
+            }
+
+            // true once every value on the line has been read
+            bool atLineEnd()
+            {
+                skipSpace();
+                return lineCursor == lineEnd;
+            }
+
+            void endLine()
+            {
+                skipSpace();
+                if (lineCursor != lineEnd)
+                {
+                    fail("unexpected trailing values");
+                }
+            }
+
+            [[noreturn]] void fail(const std::string& message) const
+            {
+                throw std::runtime_error(filePath + ":" + std::to_string(lineNumber) + ": " + message);
+            }
+
+        private:
+            static bool isSpace(char c)
+            {
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            void skipSpace()
+            {
+                while (lineCursor < lineEnd && isSpace(*lineCursor))
+                {
+                    lineCursor++;
+                }
+            }
+
+            const std::string& filePath;
+            const char* cursor;
+            const char* end;
+            const char* lineCursor = nullptr;
+            const char* lineEnd = nullptr;
+            size_t lineNumber = 0;
+        };
+
+        void loadText(
+            const std::string& filePath,
+            const BEFileData& file,
+            BEAssetManager& assetManager,
+            BERegistry& registry)
+        {
+            TextReader reader{filePath, file.data(), file.data() + file.size()};
+
+            if (!reader.nextLine() || reader.token() != TEXT_MAGIC)
+            {
+                throw std::runtime_error("Not a scene file: " + filePath);
+            }
+            if (reader.number<uint32_t>() != BEScene::VERSION)
+            {
+                reader.fail("unsupported scene version");
+            }
+            reader.endLine();
+
+            // parse everything before creating any object, the model table has to be complete
+            // before it is resolved and the object count is needed to size the pools
+            std::vector<SceneModel> sceneModels;
+            std::vector<ObjectRecord> records;
+            while (reader.nextLine())
+            {
+                std::string_view kind = reader.token();
+                if (kind == "model")
+                {
+                    SceneModel sceneModel;
+                    sceneModel.settings = modelSettings(reader.number<uint32_t>());
+                    sceneModel.path = std::string(reader.rest());
+                    sceneModels.push_back(std::move(sceneModel));
+                }
+                else if (kind == "object" || kind == "light")
+                {
+                    ObjectRecord record{};
+                    record.model = -1;
+                    if (kind == "object")
+                    {
+                        record.model = reader.number<int32_t>();
+                    }
+                    else
+                    {
+                        record.flags |= OBJECT_POINT_LIGHT;
+                        record.lightIntensity = reader.number<float>();
+                    }
+                    reader.numbers(record.translation, 3);
+                    reader.numbers(record.rotation, 3);
+                    reader.numbers(record.scale, 3);
+                    reader.numbers(record.color, 3);
+                    // a light may also carry a model, written after its colour
+                    if (kind == "light" && !reader.atLineEnd())
+                    {
+                        record.model = reader.number<int32_t>();
+                    }
+                    if (record.model >= static_cast<int32_t>(sceneModels.size()))
+                    {
+                        reader.fail(std::string(kind) + " references model " + std::to_string(record.model) + " before it is declared");
+                    }
+                    reader.endLine();
+                    records.push_back(record);
+                }
+                else
+                {
+                    reader.fail("unknown record '" + std::string(kind) + "'");
+                }
+            }
+
+            std::vector<std::shared_ptr<BEModel>> models = requestModels(sceneModels, assetManager);
+
+            reserveScene(registry, records.size());
+            for (const ObjectRecord& record : records)
+            {
+                createObject(registry, record, models);
+            }
+        }
+
+        // writes floats with the fewest digits that still read back to the same value
+        void writeFloats(std::ostream& out, const float* values, int count)
+        {
+            char buffer[32];
+            for (int i = 0; i < count; i++)
+            {
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), values[i]);
+                out << ' ';
+                out.write(buffer, result.ptr - buffer);
+            }
+        }
+    }
+
+    void BEScene::load(
+        const std::string& filePath,
+        BEAssetManager& assetManager,
+        BERegistry& registry)
+    {
+        BEFileData file = BEFileSystem::readFile(filePath);
+
+        if (file.size() >= sizeof(BINARY_MAGIC) && std::memcmp(file.data(), BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0)
+        {
+            loadBinary(filePath, file, assetManager, registry);
+        }
+        else
+        {
+            loadText(filePath, file, assetManager, registry);
+        }
+    }
+
+    void BEScene::save(
+        const std::string& filePath,
+        const BERegistry& registry,
+        const BEAssetManager& assetManager,
+        Format format)
+    {
+        // one pass to number the distinct models, objects are written straight from the registry after
+        std::vector<SceneModel> sceneModels;
+        std::unordered_map<const BEModel*, int32_t> modelIndices;
+        for (Entity entity : registry.entities())
+        {
+            const ModelComponent* modelComponent = registry.tryGet<ModelComponent>(entity);
+            const BEModel* model = modelComponent ? modelComponent->model.get() : nullptr;
+            if (model == nullptr || modelIndices.count(model) != 0)
+            {
+                continue;
+            }
+
+            BEAssetManager::ModelSource source;
+            if (!assetManager.getModelSource(model, source))
+            {
+                std::cerr << "Scene object " << entity << " uses a model that can't be saved by path\n";
+                modelIndices.emplace(model, -1);
+                continue;
+            }
+            modelIndices.emplace(model, static_cast<int32_t>(sceneModels.size()));
+            sceneModels.push_back({std::move(source.path), source.settings});
+        }
+
+        auto modelIndex = [&registry, &modelIndices](Entity entity)
+        {
+            const ModelComponent* modelComponent = registry.tryGet<ModelComponent>(entity);
+            return modelComponent && modelComponent->model ? modelIndices.at(modelComponent->model.get()) : -1;
+        };
+
+        auto savedEntities = [&registry](auto&& fn)
+        {
+            for (Entity entity : registry.entities())
+            {
+                if (registry.has<TransformComponent>(entity))
+                {
+                    fn(entity);
+                }
+            }
+        };
+
+        std::ofstream file{filePath, std::ios::binary | std::ios::trunc};
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Failed to create scene file: " + filePath);
+        }
+
+        if (format == Format::Binary)
+        {
+            Header header{};
+            std::memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+            header.version = VERSION;
+            header.modelCount = static_cast<uint32_t>(sceneModels.size());
+            savedEntities([&header](Entity) { header.objectCount++; });
+            for (const auto& sceneModel : sceneModels)
+            {
+                header.pathsSize += sceneModel.path.size();
+            }
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+            uint32_t pathOffset = 0;
+            for (const auto& sceneModel : sceneModels)
+            {
+                ModelRecord record{};
+                record.pathOffset = pathOffset;
+                record.pathLength = static_cast<uint32_t>(sceneModel.path.size());
+                record.flags = modelFlags(sceneModel.settings);
+                file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+                pathOffset += record.pathLength;
+            }
+            for (const auto& sceneModel : sceneModels)
+            {
+                file.write(sceneModel.path.data(), static_cast<std::streamsize>(sceneModel.path.size()));
+            }
+
+            savedEntities([&](Entity entity)
+            {
+                ObjectRecord record = makeRecord(registry, entity, modelIndex(entity));
+                file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+            });
+        }
+        else
+        {
+            file << TEXT_MAGIC << ' ' << VERSION << '\n';
+            for (const auto& sceneModel : sceneModels)
+            {
+                file << "model " << modelFlags(sceneModel.settings) << ' ' << sceneModel.path << '\n';
+            }
+
+            savedEntities([&](Entity entity)
+            {
+                ObjectRecord record = makeRecord(registry, entity, modelIndex(entity));
+                if (record.flags & OBJECT_POINT_LIGHT)
+                {
+                    file << "light";
+                    writeFloats(file, &record.lightIntensity, 1);
+                }
+                else
+                {
+                    file << "object " << record.model;
+                }
+                writeFloats(file, record.translation, 3);
+                writeFloats(file, record.rotation, 3);
+                writeFloats(file, record.scale, 3);
+                writeFloats(file, record.color, 3);
+                if ((record.flags & OBJECT_POINT_LIGHT) && record.model >= 0)
+                {
+                    file << ' ' << record.model;
+                }
+                file << '\n';
+            });
+        }
+
+        if (!file)
+        {
+            throw std::runtime_error("Failed to write scene file: " + filePath);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+
+#include "../assets/BEAssetManager.hpp"
+#include "../ecs/BERegistry.hpp"
+#include "../game/BEComponents.hpp"
+
+// std
+#include <string>
+
+namespace bucketengine
+{
+    // reads and writes the entities making up a scene: their transforms, colours, model
+    // references and point lights. scenes come in a compact binary form and a line based text
+    // form meant for editing by hand, load tells them apart by their first bytes.
+    //
+    // binary layout, all integers little endian:
+    //   Header | ModelRecord[modelCount] | model paths | ObjectRecord[objectCount]
+    //
+    // text layout, one record per line, # starts a comment:
+    //   bescene <version>
+    //   model <flags> <path>, flags: 1 deduplicate vertices, 2 build a ray bvh
+    //   object <model index or -1> <translation xyz> <rotation xyz> <scale xyz> <color rgb>
+    //   light <intensity> <translation xyz> <rotation xyz> <scale xyz> <color rgb> [model index]
+    class BEScene
+    {
+    public:
+        enum class Format
+        {
+            Binary,
+            Text,
+        };
+
+        static constexpr uint32_t VERSION = 1;
+
+        // adds the scene's objects to the registry. every model is requested from the asset
+        // manager once, up front, so objects sharing a model share the cached handle
+        static void load(
+            const std::string& filePath,
+            BEAssetManager& assetManager,
+            BERegistry& registry
+        );
+
+        // every entity with a transform is saved. models that weren't loaded through the asset
+        // manager can't be referenced by path, objects using them are saved without a model
+        static void save(
+            const std::string& filePath,
+            const BERegistry& registry,
+            const BEAssetManager& assetManager,
+            Format format = Format::Binary
+        );
+    };
+}
@@ -5,6 +5,8 @@ layout(location = 1) in vec3 fragPosWorld;
 layout(location = 2) in vec3 fragNormalWorld;
 
 layout(location = 0) out vec4 outColor;
+// only present when the render pass was created with the object id attachment
+layout(location = 1) out uint outObjectId;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projection;
@@ -16,7 +18,8 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
 
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
-    mat4 normalMatrix;
+    mat3x4 normalMatrix;
+    uint objectId;
 } push;
 
 void main() {
@@ -29,4 +32,5 @@ void main() {
     vec3 diffuseLight = lightColor * max(dot(normalize(fragNormalWorld), normalize(directionToLight)), 0);
 
     outColor = vec4((diffuseLight + ambientLight) * fragColor, 1.0);
+    outObjectId = push.objectId;
 }
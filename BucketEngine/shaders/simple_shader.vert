@@ -17,10 +17,12 @@ layout(set = 0, binding = 0) uniform GlobalUbo {
     vec4 lightColor;
 } ubo;
 
-// normal matrix is actually mat3, but we're using 4 here for alignment reasons
+// normal matrix is actually mat3, but its columns are padded to vec4 for alignment reasons,
+// the fragment shader reads the object id that follows it
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
-    mat4 normalMatrix;
+    mat3x4 normalMatrix;
+    uint objectId;
 } push;
 
 void main() {
@@ -0,0 +1,98 @@
+﻿#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <limits>
+
+namespace bucketengine
+{
+    // axis aligned bounding box, an empty box has min > max so merging anything into it gives that thing
+    struct AABB
+    {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{-std::numeric_limits<float>::max()};
+
+        bool isEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+        glm::vec3 center() const { return (min + max) * 0.5f; }
+        glm::vec3 extents() const { return (max - min) * 0.5f; }
+
+        void expand(const glm::vec3& point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        AABB merged(const AABB& other) const
+        {
+            return AABB{glm::min(min, other.min), glm::max(max, other.max)};
+        }
+
+        bool contains(const AABB& other) const
+        {
+            return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+                && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+        }
+
+        AABB inflated(float margin) const
+        {
+            return AABB{min - glm::vec3{margin}, max + glm::vec3{margin}};
+        }
+
+        // the cost metric for bounding volume hierarchies, how likely a random ray is to hit the box
+        float surfaceArea() const
+        {
+            glm::vec3 size = max - min;
+            return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        // the smallest box around this one after transforming it, without visiting all 8 corners
+        AABB transformed(const glm::mat4& matrix) const
+        {
+            glm::vec3 worldCenter{matrix * glm::vec4{center(), 1.f}};
+            glm::vec3 localExtents = extents();
+            glm::vec3 worldExtents{};
+            for (int axis = 0; axis < 3; axis++)
+            {
+                worldExtents[axis] = std::abs(matrix[0][axis]) * localExtents.x
+                    + std::abs(matrix[1][axis]) * localExtents.y
+                    + std::abs(matrix[2][axis]) * localExtents.z;
+            }
+            return AABB{worldCenter - worldExtents, worldCenter + worldExtents};
+        }
+
+        /**
+         * Slab test against a ray.
+         *
+         * @param origin Start of the ray
+         * @param inverseDirection 1 / the ray direction, computed once per ray
+         * @param maxDistance Hits further along the ray than this are ignored
+         * @param distance Receives the distance along the ray where it enters the box, 0 if it starts inside
+         *
+         * @return true if the ray hits the box within maxDistance
+         */
+        bool intersectRay(
+            const glm::vec3& origin,
+            const glm::vec3& inverseDirection,
+            float maxDistance,
+            float& distance
+        ) const
+        {
+            glm::vec3 t1 = (min - origin) * inverseDirection;
+            glm::vec3 t2 = (max - origin) * inverseDirection;
+            glm::vec3 tMin = glm::min(t1, t2);
+            glm::vec3 tMax = glm::max(t1, t2);
+
+            float tNear = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.f));
+            float tFar = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+
+            distance = tNear;
+            return tNear <= tFar;
+        }
+    };
+}
@@ -0,0 +1,261 @@
+﻿#include "BECompression.hpp"
+
+// std
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace lz4
+    {
+        namespace
+        {
+            constexpr std::size_t MIN_MATCH = 4;
+            // the format requires the last 5 bytes to be literals and the last match to start
+            // at least 12 bytes before the end of the block
+            constexpr std::size_t LAST_LITERALS = 5;
+            constexpr std::size_t MATCH_SAFE_DISTANCE = 12;
+            constexpr std::size_t MAX_OFFSET = 65535;
+            constexpr int HASH_BITS = 16;
+
+            uint32_t read32(const unsigned char* p)
+            {
+                uint32_t value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+
+            uint32_t hashSequence(uint32_t sequence)
+            {
+                return (sequence * 2654435761U) >> (32 - HASH_BITS);
+            }
+
+            // lengths of 15 and above spill into extra bytes of 255 terminated by a smaller byte
+            unsigned char* writeLength(unsigned char* out, std::size_t length)
+            {
+                while (length >= 255)
+                {
+                    *out++ = 255;
+                    length -= 255;
+                }
+                *out++ = static_cast<unsigned char>(length);
+                return out;
+            }
+
+            unsigned char* writeSequence(
+                unsigned char* out,
+                const unsigned char* literals,
+                std::size_t literalLength,
+                std::size_t offset,
+                std::size_t matchLength)
+            {
+                unsigned char* token = out++;
+                *token = static_cast<unsigned char>((literalLength >= 15 ? 15 : literalLength) << 4);
+                if (literalLength >= 15)
+                {
+                    out = writeLength(out, literalLength - 15);
+                }
+                if (literalLength > 0)
+                {
+                    std::memcpy(out, literals, literalLength);
+                    out += literalLength;
+                }
+
+                // the final sequence is literals only
+                if (matchLength == 0)
+                {
+                    return out;
+                }
+
+                *out++ = static_cast<unsigned char>(offset & 0xFF);
+                *out++ = static_cast<unsigned char>(offset >> 8);
+
+                std::size_t matchCode = matchLength - MIN_MATCH;
+                *token |= static_cast<unsigned char>(matchCode >= 15 ? 15 : matchCode);
+                if (matchCode >= 15)
+                {
+                    out = writeLength(out, matchCode - 15);
+                }
+                return out;
+            }
+
+            bool readLength(const unsigned char*& in, const unsigned char* inEnd, std::size_t& length)
+            {
+                unsigned char byte;
+                do
+                {
+                    if (in >= inEnd)
+                    {
+                        return false;
+                    }
+                    byte = *in++;
+                    length += byte;
+                } while (byte == 255);
+                return true;
+            }
+        }
+
+        std::size_t compressBound(std::size_t inputSize)
+        {
+            return inputSize + inputSize / 255 + 16;
+        }
+
+        std::size_t maxDecompressedSize(std::size_t inputSize)
+        {
+            constexpr std::size_t MAX_EXPANSION = 255;
+            if (inputSize > std::numeric_limits<std::size_t>::max() / MAX_EXPANSION)
+            {
+                return std::numeric_limits<std::size_t>::max();
+            }
+            return inputSize * MAX_EXPANSION;
+        }
+
+        std::size_t compress(const void* input, std::size_t inputSize, void* output)
+        {
+            const auto* in = static_cast<const unsigned char*>(input);
+            auto* out = static_cast<unsigned char*>(output);
+
+            const unsigned char* anchor = in;
+            const unsigned char* const inEnd = in + inputSize;
+
+            if (inputSize > MATCH_SAFE_DISTANCE)
+            {
+                // positions are stored relative to the start of the input, 0 doubles as empty since
+                // a match against the first byte is simply missed
+                std::vector<uint32_t> table(std::size_t{1} << HASH_BITS, 0);
+
+                const unsigned char* const matchLimit = inEnd - LAST_LITERALS;
+                const unsigned char* const searchLimit = inEnd - MATCH_SAFE_DISTANCE;
+
+                const unsigned char* ip = in + 1;
+                while (ip < searchLimit)
+                {
+                    uint32_t sequence = read32(ip);
+                    uint32_t& slot = table[hashSequence(sequence)];
+                    const unsigned char* candidate = in + slot;
+                    slot = static_cast<uint32_t>(ip - in);
+
+                    if (candidate == in
+                        || static_cast<std::size_t>(ip - candidate) > MAX_OFFSET
+                        || read32(candidate) != sequence)
+                    {
+                        ip++;
+                        continue;
+                    }
+
+                    // extend the match backwards over bytes still pending as literals
+                    while (ip > anchor && candidate > in && ip[-1] == candidate[-1])
+                    {
+                        ip--;
+                        candidate--;
+                    }
+
+                    const unsigned char* matchEnd = ip + MIN_MATCH;
+                    const unsigned char* candidateEnd = candidate + MIN_MATCH;
+                    while (matchEnd < matchLimit && *matchEnd == *candidateEnd)
+                    {
+                        matchEnd++;
+                        candidateEnd++;
+                    }
+
+                    out = writeSequence(
+                        out,
+                        anchor,
+                        static_cast<std::size_t>(ip - anchor),
+                        static_cast<std::size_t>(ip - candidate),
+                        static_cast<std::size_t>(matchEnd - ip)
+                    );
+
+                    ip = matchEnd;
+                    anchor = ip;
+                    if (ip - 2 > in && ip < searchLimit)
+                    {
+                        // seed the table inside the match so the next search can find it
+                        table[hashSequence(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - in);
+                    }
+                }
+            }
+
+            out = writeSequence(out, anchor, static_cast<std::size_t>(inEnd - anchor), 0, 0);
+            return static_cast<std::size_t>(out - static_cast<unsigned char*>(output));
+        }
+
+        bool decompress(const void* input, std::size_t inputSize, void* output, std::size_t outputSize)
+        {
+            const auto* in = static_cast<const unsigned char*>(input);
+            const unsigned char* const inEnd = in + inputSize;
+            auto* out = static_cast<unsigned char*>(output);
+            unsigned char* const outStart = out;
+            unsigned char* const outEnd = out + outputSize;
+
+            while (in < inEnd)
+            {
+                unsigned char token = *in++;
+
+                std::size_t literalLength = token >> 4;
+                if (literalLength == 15 && !readLength(in, inEnd, literalLength))
+                {
+                    return false;
+                }
+                if (literalLength > static_cast<std::size_t>(inEnd - in)
+                    || literalLength > static_cast<std::size_t>(outEnd - out))
+                {
+                    return false;
+                }
+                if (literalLength > 0)
+                {
+                    std::memcpy(out, in, literalLength);
+                    in += literalLength;
+                    out += literalLength;
+                }
+
+                // the last sequence has no match part
+                if (in == inEnd)
+                {
+                    break;
+                }
+
+                if (inEnd - in < 2)
+                {
+                    return false;
+                }
+                std::size_t offset = static_cast<std::size_t>(in[0]) | (static_cast<std::size_t>(in[1]) << 8);
+                in += 2;
+                if (offset == 0 || offset > static_cast<std::size_t>(out - outStart))
+                {
+                    return false;
+                }
+
+                std::size_t matchLength = token & 0x0F;
+                if (matchLength == 15 && !readLength(in, inEnd, matchLength))
+                {
+                    return false;
+                }
+                matchLength += MIN_MATCH;
+                if (matchLength > static_cast<std::size_t>(outEnd - out))
+                {
+                    return false;
+                }
+
+                // matches may overlap their own output (offset < length) so copy forwards byte
+                // by byte in that case, otherwise one memcpy
+                const unsigned char* match = out - offset;
+                if (offset >= matchLength)
+                {
+                    std::memcpy(out, match, matchLength);
+                    out += matchLength;
+                }
+                else
+                {
+                    for (std::size_t i = 0; i < matchLength; i++)
+                    {
+                        *out++ = *match++;
+                    }
+                }
+            }
+
+            return out == outEnd;
+        }
+    }
+}
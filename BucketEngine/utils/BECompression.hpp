@@ -0,0 +1,46 @@
+﻿#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+
+namespace bucketengine
+{
+    // byte compatible with the lz4 block format, a block written here can be decoded by the
+    // reference implementation and vice versa. there is no frame format, the caller has to store
+    // the uncompressed size alongside the block
+    namespace lz4
+    {
+        // the largest block compress can produce for an input of the given size
+        std::size_t compressBound(std::size_t inputSize);
+        // the most a block of the given size can decode to. every length byte adds at most 255
+        // bytes of output, so no valid block expands by more than 255 times
+        std::size_t maxDecompressedSize(std::size_t inputSize);
+
+        /**
+         * Compress a buffer into a single lz4 block.
+         *
+         * @param input Bytes to compress
+         * @param inputSize Number of bytes in input
+         * @param output Destination, must hold at least compressBound(inputSize) bytes
+         *
+         * @return Number of bytes written to output
+         */
+        std::size_t compress(const void* input, std::size_t inputSize, void* output);
+
+        /**
+         * Decode a single lz4 block.
+         *
+         * Every read and write is bounds checked so a truncated or corrupt block fails instead of
+         * reading or writing out of range.
+         *
+         * @param input The compressed block
+         * @param inputSize Size of the compressed block in bytes
+         * @param output Destination for the decoded bytes
+         * @param outputSize Exact size of the decoded data
+         *
+         * @return true if the block decoded to exactly outputSize bytes
+         */
+        bool decompress(const void* input, std::size_t inputSize, void* output, std::size_t outputSize);
+    }
+}
@@ -0,0 +1,90 @@
+﻿#include "BEDeletionQueue.hpp"
+
+#include "../BEDevice.hpp"
+
+// std
+#include <cassert>
+
+namespace bucketengine
+{
+    BEDeletionQueue::BEDeletionQueue(BEDevice& device) : beDevice{device} {}
+
+    BEDeletionQueue::~BEDeletionQueue()
+    {
+        assert(retired.empty() && "Deletion queue must be flushed before the device is destroyed");
+    }
+
+    void BEDeletionQueue::retire(VkObjectType type, uint64_t handle)
+    {
+        if (handle == 0) return;
+
+        std::lock_guard<std::mutex> lock{mutex};
+        // the frame after the last submitted one may be being recorded with the handle right now
+        retired.push_back({type, handle, beDevice.frameTimeline().getSubmittedFrame() + 1});
+    }
+
+    size_t BEDeletionQueue::getRetiredCount() const
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        return retired.size();
+    }
+
+    void BEDeletionQueue::collect(uint64_t completedFrame)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            while (!retired.empty() && retired.front().frame <= completedFrame)
+            {
+                collecting.push_back(retired.front());
+                retired.pop_front();
+            }
+        }
+
+        for (const Retired& handle : collecting)
+        {
+            destroy(handle);
+        }
+        collecting.clear();
+    }
+
+    void BEDeletionQueue::destroy(const Retired& retired)
+    {
+        VkDevice device = beDevice.device();
+        switch (retired.type)
+        {
+        case VK_OBJECT_TYPE_BUFFER:
+            vkDestroyBuffer(device, reinterpret_cast<VkBuffer>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+            vkFreeMemory(device, reinterpret_cast<VkDeviceMemory>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE:
+            vkDestroyImage(device, reinterpret_cast<VkImage>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+            vkDestroyImageView(device, reinterpret_cast<VkImageView>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE:
+            vkDestroyPipeline(device, reinterpret_cast<VkPipeline>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+            vkDestroyPipelineLayout(device, reinterpret_cast<VkPipelineLayout>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            vkDestroyShaderModule(device, reinterpret_cast<VkShaderModule>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+            vkDestroyFramebuffer(device, reinterpret_cast<VkFramebuffer>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_RENDER_PASS:
+            vkDestroyRenderPass(device, reinterpret_cast<VkRenderPass>(retired.handle), nullptr);
+            break;
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+            vkDestroySwapchainKHR(device, reinterpret_cast<VkSwapchainKHR>(retired.handle), nullptr);
+            break;
+        default:
+            assert(false && "Retired an object type the deletion queue can't destroy");
+            break;
+        }
+    }
+}
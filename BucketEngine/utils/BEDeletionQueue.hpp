@@ -0,0 +1,74 @@
+﻿#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace bucketengine
+{
+    class BEDevice;
+
+    // holds on to vulkan handles that were released while frames that may still use them are in flight,
+    // and destroys them once the device's frame timeline has passed those frames. any thread can retire
+    // handles, so assets can be unloaded while the game keeps running without waiting on the device
+    class BEDeletionQueue
+    {
+    public:
+        explicit BEDeletionQueue(BEDevice& device);
+        ~BEDeletionQueue();
+
+        BEDeletionQueue(const BEDeletionQueue&) = delete;
+        BEDeletionQueue& operator=(const BEDeletionQueue&) = delete;
+
+        // null handles are ignored
+        void retireBuffer(VkBuffer buffer) { retire(VK_OBJECT_TYPE_BUFFER, reinterpret_cast<uint64_t>(buffer)); }
+        void retireMemory(VkDeviceMemory memory) { retire(VK_OBJECT_TYPE_DEVICE_MEMORY, reinterpret_cast<uint64_t>(memory)); }
+        void retireImage(VkImage image) { retire(VK_OBJECT_TYPE_IMAGE, reinterpret_cast<uint64_t>(image)); }
+        void retireImageView(VkImageView view) { retire(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(view)); }
+        void retirePipeline(VkPipeline pipeline) { retire(VK_OBJECT_TYPE_PIPELINE, reinterpret_cast<uint64_t>(pipeline)); }
+        void retirePipelineLayout(VkPipelineLayout layout) { retire(VK_OBJECT_TYPE_PIPELINE_LAYOUT, reinterpret_cast<uint64_t>(layout)); }
+        void retireShaderModule(VkShaderModule module) { retire(VK_OBJECT_TYPE_SHADER_MODULE, reinterpret_cast<uint64_t>(module)); }
+        void retireFramebuffer(VkFramebuffer framebuffer) { retire(VK_OBJECT_TYPE_FRAMEBUFFER, reinterpret_cast<uint64_t>(framebuffer)); }
+        void retireRenderPass(VkRenderPass renderPass) { retire(VK_OBJECT_TYPE_RENDER_PASS, reinterpret_cast<uint64_t>(renderPass)); }
+        // the swap chain must have been passed as oldSwapchain to its replacement, or not presented to again
+        void retireSwapchain(VkSwapchainKHR swapchain) { retire(VK_OBJECT_TYPE_SWAPCHAIN_KHR, reinterpret_cast<uint64_t>(swapchain)); }
+
+        /**
+         * Destroys every handle no frame up to and including completedFrame can still use.
+         * Only one thread may collect or flush at a time.
+         *
+         * @param completedFrame A frame of the device's frame timeline known to have finished on the gpu
+         */
+        void collect(uint64_t completedFrame);
+        // destroys everything that is left, the device has to be idle
+        void flush() { collect(UINT64_MAX); }
+
+        size_t getRetiredCount() const;
+
+    private:
+        struct Retired
+        {
+            VkObjectType type;
+            uint64_t handle;
+            // the last frame that may have used the handle
+            uint64_t frame;
+        };
+
+        void retire(VkObjectType type, uint64_t handle);
+        void destroy(const Retired& retired);
+
+        BEDevice& beDevice;
+
+        mutable std::mutex mutex;
+        // ordered by frame, as the timeline only moves forward and is read under the mutex
+        std::deque<Retired> retired;
+
+        // only touched by the collecting thread, so the handles are destroyed outside of the lock
+        std::vector<Retired> collecting;
+    };
+}
@@ -0,0 +1,179 @@
+﻿#include "BEFramePacer.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+
+// windows 10 1803 and later, older sdks don't define it
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+namespace bucketengine
+{
+    // older sleep samples are weighted down past this many, so the estimate follows changes in system load
+    static constexpr uint64_t MAX_SLEEP_SAMPLES = 1000;
+    // the most of a wait that is ever spun, however badly the os has been sleeping
+    static constexpr double MAX_SPIN_SECONDS = 0.002;
+
+    BEFramePacer::BEFramePacer(double targetFrameRate)
+    {
+        setTargetFrameRate(targetFrameRate);
+
+#ifdef _WIN32
+        timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (timer == nullptr)
+        {
+            // older windows, sleep_for lands on the system tick which timeBeginPeriod shortens to 1ms
+            raisedTimerResolution = timeBeginPeriod(1) == TIMERR_NOERROR;
+        }
+#endif
+    }
+
+    BEFramePacer::~BEFramePacer()
+    {
+#ifdef _WIN32
+        if (timer != nullptr)
+        {
+            CloseHandle(static_cast<HANDLE>(timer));
+        }
+        if (raisedTimerResolution)
+        {
+            timeEndPeriod(1);
+        }
+#endif
+    }
+
+    void BEFramePacer::setTargetFrameRate(double framesPerSecond)
+    {
+        targetFrameRate = framesPerSecond > 0.0 ? framesPerSecond : 0.0;
+        period = targetFrameRate > 0.0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFrameRate))
+            : Clock::duration{0};
+        // the new rate starts counting from the next frame
+        started = false;
+    }
+
+    void BEFramePacer::waitForNextFrame()
+    {
+        Clock::time_point now = Clock::now();
+        if (period == Clock::duration{0})
+        {
+            recordFrameStart(now, now);
+            return;
+        }
+
+        if (!started)
+        {
+            nextFrame = now;
+            started = true;
+        }
+        nextFrame += period;
+
+        // a frame that ran long moves the schedule instead of the next frames rushing to catch up
+        if (nextFrame < now)
+        {
+            nextFrame = now;
+        }
+
+        sleepUntil(nextFrame);
+        recordFrameStart(Clock::now(), nextFrame);
+    }
+
+    void BEFramePacer::restart()
+    {
+        started = false;
+        lastFrameStart = Clock::time_point{};
+    }
+
+    void BEFramePacer::sleepUntil(Clock::time_point deadline)
+    {
+        for (;;)
+        {
+            Clock::time_point start = Clock::now();
+            double spinWindow = std::min(sleepEstimate, MAX_SPIN_SECONDS);
+            if (std::chrono::duration<double>(deadline - start).count() <= spinWindow) break;
+
+            sleepOnce();
+            double slept = std::chrono::duration<double>(Clock::now() - start).count();
+
+            // welford's running variance
+            sleepCount = std::min(sleepCount + 1, MAX_SLEEP_SAMPLES);
+            double delta = slept - sleepMean;
+            sleepMean += delta / sleepCount;
+            sleepM2 += delta * (slept - sleepMean);
+            if (sleepCount == MAX_SLEEP_SAMPLES)
+            {
+                sleepM2 *= static_cast<double>(MAX_SLEEP_SAMPLES - 1) / MAX_SLEEP_SAMPLES;
+            }
+            sleepEstimate = sleepMean + std::sqrt(sleepM2 / (sleepCount - 1));
+        }
+
+        while (Clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void BEFramePacer::sleepOnce()
+    {
+#ifdef _WIN32
+        if (timer != nullptr)
+        {
+            // relative due time in 100ns units
+            LARGE_INTEGER dueTime{};
+            dueTime.QuadPart = -10000;
+            if (SetWaitableTimerEx(static_cast<HANDLE>(timer), &dueTime, 0, nullptr, nullptr, nullptr, 0))
+            {
+                WaitForSingleObject(static_cast<HANDLE>(timer), INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    void BEFramePacer::recordFrameStart(Clock::time_point start, Clock::time_point deadline)
+    {
+        if (lastFrameStart != Clock::time_point{})
+        {
+            double interval = std::chrono::duration<double>(start - lastFrameStart).count();
+            intervals++;
+            intervalSum += interval;
+            intervalSquareSum += interval * interval;
+        }
+        lastFrameStart = start;
+        worstLate = std::max(worstLate, std::chrono::duration<double>(start - deadline).count());
+    }
+
+    BEFramePacer::Stats BEFramePacer::getStats() const
+    {
+        Stats stats{};
+        stats.frames = intervals;
+        stats.worstLateSeconds = worstLate;
+        if (intervals == 0) return stats;
+
+        stats.averageIntervalSeconds = intervalSum / intervals;
+        double variance = intervalSquareSum / intervals - stats.averageIntervalSeconds * stats.averageIntervalSeconds;
+        stats.jitterSeconds = std::sqrt(std::max(variance, 0.0));
+        return stats;
+    }
+
+    void BEFramePacer::resetStats()
+    {
+        lastFrameStart = Clock::time_point{};
+        intervals = 0;
+        intervalSum = 0.0;
+        intervalSquareSum = 0.0;
+        worstLate = 0.0;
+    }
+}
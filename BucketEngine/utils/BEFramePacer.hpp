@@ -0,0 +1,77 @@
+﻿#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+
+namespace bucketengine
+{
+    // holds a loop to a target frame rate. the os is only trusted to sleep for as long as it has been
+    // seen to sleep so far, the rest of the wait spins, which keeps frame starts within a fraction of a
+    // millisecond of their deadline while the thread still sleeps through most of the frame. on windows
+    // the sleeps use a high resolution waitable timer, or raise the timer resolution to 1ms where
+    // those aren't available, since the default 15.6ms tick would leave most of the frame to the spin.
+    // not thread safe, the loop being paced owns it
+    class BEFramePacer
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        struct Stats
+        {
+            uint64_t frames = 0;
+            double averageIntervalSeconds = 0.0;
+            // standard deviation of the time between frame starts
+            double jitterSeconds = 0.0;
+            // the furthest a frame started past its deadline
+            double worstLateSeconds = 0.0;
+        };
+
+        // a target of zero or less leaves the loop unlimited
+        explicit BEFramePacer(double targetFrameRate = 0.0);
+        ~BEFramePacer();
+
+        BEFramePacer(const BEFramePacer&) = delete;
+        BEFramePacer& operator=(const BEFramePacer&) = delete;
+
+        void setTargetFrameRate(double framesPerSecond);
+        double getTargetFrameRate() const { return targetFrameRate; }
+
+        // blocks until the next frame is due, call once at the start of every frame
+        void waitForNextFrame();
+        // the loop stopped for a while, schedules from the next call instead of counting the pause as a long frame
+        void restart();
+
+        Stats getStats() const;
+        void resetStats();
+
+    private:
+        void sleepUntil(Clock::time_point deadline);
+        // sleeps for about a millisecond, as close to it as the os allows
+        void sleepOnce();
+        void recordFrameStart(Clock::time_point start, Clock::time_point deadline);
+
+        double targetFrameRate = 0.0;
+        Clock::duration period{0};
+        Clock::time_point nextFrame{};
+        bool started = false;
+
+        // running mean and variance of how long a one millisecond sleep takes, the last stretch of a
+        // wait shorter than mean plus one deviation, and never more than 2ms, is spun instead
+        double sleepMean = 0.001;
+        double sleepM2 = 0.0;
+        uint64_t sleepCount = 1;
+        double sleepEstimate = 0.001;
+
+#ifdef _WIN32
+        void* timer = nullptr;
+        bool raisedTimerResolution = false;
+#endif
+
+        Clock::time_point lastFrameStart{};
+        uint64_t intervals = 0;
+        double intervalSum = 0.0;
+        double intervalSquareSum = 0.0;
+        double worstLate = 0.0;
+    };
+}
@@ -0,0 +1,119 @@
+﻿#include "BEImageMemoryPool.hpp"
+
+#include "../BEDevice.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace bucketengine
+{
+    BEImageMemoryPool::BEImageMemoryPool(BEDevice& device) : beDevice{device} {}
+
+    BEImageMemoryPool::~BEImageMemoryPool()
+    {
+        // images bound to the used blocks may still be waiting in the deletion queue themselves
+        for (const Block& block : usedBlocks)
+        {
+            beDevice.deletionQueue().retireMemory(block.memory);
+        }
+        for (const Block& block : freeBlocks)
+        {
+            beDevice.deletionQueue().retireMemory(block.memory);
+        }
+    }
+
+    void BEImageMemoryPool::createImage(
+        const VkImageCreateInfo& imageInfo,
+        VkMemoryPropertyFlags properties,
+        VkImage& image,
+        VkDeviceMemory& imageMemory)
+    {
+        if (vkCreateImage(beDevice.device(), &imageInfo, nullptr, &image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create image");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(beDevice.device(), image, &memRequirements);
+        uint32_t memoryType = beDevice.findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        // the smallest block the gpu is done with that fits, blocks always start at offset zero which
+        // satisfies any alignment
+        uint64_t completedFrame = beDevice.frameTimeline().getCompletedFrame();
+        auto best = freeBlocks.end();
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            if (it->frame <= completedFrame && it->memoryType == memoryType && it->size >= memRequirements.size &&
+                (best == freeBlocks.end() || it->size < best->size))
+            {
+                best = it;
+            }
+        }
+
+        Block block{};
+        if (best != freeBlocks.end())
+        {
+            block = *best;
+            freeBlocks.erase(best);
+            stats.reuses++;
+        }
+        else
+        {
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size + memRequirements.size * HEADROOM_PERCENT / 100;
+            allocInfo.memoryTypeIndex = memoryType;
+
+            if (vkAllocateMemory(beDevice.device(), &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+            {
+                vkDestroyImage(beDevice.device(), image, nullptr);
+                throw std::runtime_error("Failed to allocate image memory");
+            }
+            block.size = allocInfo.allocationSize;
+            block.memoryType = memoryType;
+            stats.allocations++;
+            stats.allocatedBytes += block.size;
+        }
+
+        if (vkBindImageMemory(beDevice.device(), image, block.memory, 0) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to bind image memory");
+        }
+
+        usedBlocks.push_back(block);
+        imageMemory = block.memory;
+
+        // free blocks the gpu is done with that were too small for this image are unlikely to fit the
+        // next one either, a window is usually resized in one direction at a time
+        auto tooSmall = std::remove_if(freeBlocks.begin(), freeBlocks.end(), [&](const Block& freeBlock)
+        {
+            return freeBlock.frame <= completedFrame && freeBlock.memoryType == memoryType &&
+                freeBlock.size < memRequirements.size;
+        });
+        for (auto it = tooSmall; it != freeBlocks.end(); ++it)
+        {
+            stats.allocatedBytes -= it->size;
+            vkFreeMemory(beDevice.device(), it->memory, nullptr);
+        }
+        freeBlocks.erase(tooSmall, freeBlocks.end());
+    }
+
+    void BEImageMemoryPool::releaseImage(VkImage image, VkDeviceMemory imageMemory)
+    {
+        auto it = std::find_if(usedBlocks.begin(), usedBlocks.end(), [imageMemory](const Block& block)
+        {
+            return block.memory == imageMemory;
+        });
+        assert(it != usedBlocks.end() && "Released image memory that didn't come from this pool");
+
+        beDevice.deletionQueue().retireImage(image);
+
+        // the same frame the deletion queue waits for before destroying the image
+        Block block = *it;
+        usedBlocks.erase(it);
+        block.frame = beDevice.frameTimeline().getSubmittedFrame() + 1;
+        freeBlocks.push_back(block);
+    }
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace bucketengine
+{
+    class BEDevice;
+
+    // keeps the memory of images that are recreated over and over, like the swap chain's depth
+    // attachments, so a new image can be bound to memory an old one no longer uses instead of every
+    // resize allocating afresh. released memory is only handed out again once the device's frame
+    // timeline has passed every frame that could still be using the old image
+    class BEImageMemoryPool
+    {
+    public:
+        // blocks are allocated this much larger than asked for, so a window being dragged bigger fits
+        // the next few sizes into the memory it already has
+        static constexpr uint32_t HEADROOM_PERCENT = 25;
+
+        struct Stats
+        {
+            uint64_t allocations = 0;
+            uint64_t reuses = 0;
+            VkDeviceSize allocatedBytes = 0;
+        };
+
+        explicit BEImageMemoryPool(BEDevice& device);
+        ~BEImageMemoryPool();
+
+        BEImageMemoryPool(const BEImageMemoryPool&) = delete;
+        BEImageMemoryPool& operator=(const BEImageMemoryPool&) = delete;
+
+        /**
+         * Creates an image and binds it to pooled memory, reusing a released block that is big enough
+         * and no longer in use before allocating a new one.
+         *
+         * @param imageInfo Describes the image to create
+         * @param properties The memory properties the image needs
+         * @param image Set to the new image
+         * @param imageMemory Set to the memory the image is bound to, hand it back with releaseImage
+         */
+        void createImage(
+            const VkImageCreateInfo& imageInfo,
+            VkMemoryPropertyFlags properties,
+            VkImage& image,
+            VkDeviceMemory& imageMemory
+        );
+
+        // retires the image through the device's deletion queue and returns its memory to the pool
+        void releaseImage(VkImage image, VkDeviceMemory imageMemory);
+
+        Stats getStats() const { return stats; }
+
+    private:
+        struct Block
+        {
+            VkDeviceMemory memory;
+            VkDeviceSize size;
+            uint32_t memoryType;
+            // the last frame that may use the image the block was bound to
+            uint64_t frame;
+        };
+
+        BEDevice& beDevice;
+        std::vector<Block> usedBlocks;
+        std::vector<Block> freeBlocks;
+        Stats stats{};
+    };
+}
@@ -0,0 +1,495 @@
+﻿#include "BEJobSystem.hpp"
+
+// std
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace bucketengine
+{
+    namespace
+    {
+        // index of the deque owned by the calling thread
+        thread_local uint32_t threadIndex = EXTERNAL_JOB_THREAD;
+
+        std::atomic<size_t> requestedThreadCount{0};
+
+        // failed attempts to find a job before a worker goes to sleep
+        constexpr int IDLE_SPINS_BEFORE_SLEEP = 64;
+
+        // hooks are read on every job, so each one is loaded on its own instead of locking
+        struct AtomicHooks
+        {
+            std::atomic<void*> context{nullptr};
+            std::atomic<void (*)(void*, uint32_t)> jobBegin{nullptr};
+            std::atomic<void (*)(void*, uint32_t)> jobEnd{nullptr};
+            std::atomic<void (*)(void*, uint32_t)> workerSleep{nullptr};
+            std::atomic<void (*)(void*, uint32_t)> workerWake{nullptr};
+        };
+        AtomicHooks hooks{};
+
+        void callHook(const std::atomic<void (*)(void*, uint32_t)>& hook, uint32_t index)
+        {
+            if (auto fn = hook.load(std::memory_order_relaxed))
+            {
+                fn(hooks.context.load(std::memory_order_relaxed), index);
+            }
+        }
+
+        struct QueuedJob
+        {
+            JobDecl job;
+            JobCounter* counter;
+        };
+
+        // chase-lev deque with a fixed capacity, callers fall back to the shared queue when it is
+        // full. the owning thread pushes and pops at the bottom, any other thread steals from the top.
+        // slots are relaxed atomics so a thief reading one the owner is reusing loses the race on
+        // top instead of reading a torn job
+        class WorkStealingDeque
+        {
+        public:
+            static constexpr int64_t CAPACITY = 4096;
+
+            bool push(const QueuedJob& job)
+            {
+                int64_t b = bottom.load(std::memory_order_relaxed);
+                int64_t t = top.load(std::memory_order_acquire);
+                if (b - t >= CAPACITY) return false;
+
+                Slot& slot = slots[b & (CAPACITY - 1)];
+                slot.fn.store(job.job.fn, std::memory_order_relaxed);
+                slot.context.store(job.job.context, std::memory_order_relaxed);
+                slot.counter.store(job.counter, std::memory_order_relaxed);
+                // a release store rather than a fence, thieves acquire bottom and thread sanitizer
+                // only sees the ordering when it is on the atomic itself
+                bottom.store(b + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool pop(QueuedJob& job)
+            {
+                int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+                bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top.load(std::memory_order_relaxed);
+
+                if (t > b)
+                {
+                    bottom.store(b + 1, std::memory_order_release);
+                    return false;
+                }
+
+                read(b, job);
+                if (t != b) return true;
+
+                // the last job, a thief may be taking it at the same time
+                bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom.store(b + 1, std::memory_order_release);
+                return won;
+            }
+
+            bool steal(QueuedJob& job)
+            {
+                int64_t t = top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t b = bottom.load(std::memory_order_acquire);
+                if (t >= b) return false;
+
+                read(t, job);
+                return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            }
+
+            bool empty() const
+            {
+                return top.load(std::memory_order_relaxed) >= bottom.load(std::memory_order_relaxed);
+            }
+
+        private:
+            struct Slot
+            {
+                std::atomic<JobFn> fn;
+                std::atomic<void*> context;
+                std::atomic<JobCounter*> counter;
+            };
+
+            void read(int64_t index, QueuedJob& job) const
+            {
+                const Slot& slot = slots[index & (CAPACITY - 1)];
+                job.job.fn = slot.fn.load(std::memory_order_relaxed);
+                job.job.context = slot.context.load(std::memory_order_relaxed);
+                job.counter = slot.counter.load(std::memory_order_relaxed);
+            }
+
+            // kept on separate cache lines, thieves hammer top while the owner works on bottom
+            alignas(64) std::atomic<int64_t> top{0};
+            alignas(64) std::atomic<int64_t> bottom{0};
+            std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(CAPACITY);
+        };
+
+        struct alignas(64) ThreadState
+        {
+            WorkStealingDeque deque;
+            std::atomic<uint64_t> jobsExecuted{0};
+            std::atomic<uint64_t> jobsStolen{0};
+            uint32_t randomState = 1;
+        };
+    }
+
+    // one thread per core, each with a deque. jobs are pushed onto the submitting thread's deque and
+    // idle threads steal from the others, threads outside the job system go through a shared queue
+    class BEJobSystem
+    {
+    public:
+        explicit BEJobSystem(size_t threadCount)
+        {
+            threads.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; i++)
+            {
+                threads.push_back(std::make_unique<ThreadState>());
+                threads.back()->randomState = static_cast<uint32_t>(i) * 0x9E3779B9u + 1u;
+            }
+
+            // the thread starting the job system, the main thread in practice, works from deque 0
+            threadIndex = 0;
+            for (size_t i = 1; i < threadCount; i++)
+            {
+                workers.emplace_back(&BEJobSystem::workerLoop, this, static_cast<uint32_t>(i));
+            }
+        }
+
+        ~BEJobSystem()
+        {
+            {
+                std::lock_guard<std::mutex> lock{sleepMutex};
+                stopping.store(true, std::memory_order_relaxed);
+            }
+            sleepCondition.notify_all();
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        BEJobSystem(const BEJobSystem&) = delete;
+        BEJobSystem& operator=(const BEJobSystem&) = delete;
+
+        size_t threadCount() const { return threads.size(); }
+
+        void submit(const JobDecl* jobs, size_t count, JobCounter* counter, JobCounter* dependency)
+        {
+            if (count == 0) return;
+
+            if (counter != nullptr)
+            {
+                counter->pending.fetch_add(static_cast<uint32_t>(count), std::memory_order_relaxed);
+            }
+
+            if (dependency != nullptr)
+            {
+                std::lock_guard<std::mutex> lock{dependency->mutex};
+                if (dependency->pending.load(std::memory_order_acquire) != 0)
+                {
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        dependency->continuations.push_back({jobs[i], counter});
+                    }
+                    return;
+                }
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                push({jobs[i], counter});
+            }
+            wakeWorkers(count);
+        }
+
+        void wait(JobCounter& counter)
+        {
+            uint32_t self = threadIndex;
+            while (!counter.isDone())
+            {
+                // the jobs left are running elsewhere, give their threads the core if we share one
+                if (!runOne(self))
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            // the thread that finished the last job may still be releasing continuations
+            std::lock_guard<std::mutex> lock{counter.mutex};
+        }
+
+        JobSystemStats stats() const
+        {
+            JobSystemStats result{};
+            for (const auto& thread : threads)
+            {
+                result.jobsExecuted += thread->jobsExecuted.load(std::memory_order_relaxed);
+                result.jobsStolen += thread->jobsStolen.load(std::memory_order_relaxed);
+            }
+            result.jobsExecuted += externalJobsExecuted.load(std::memory_order_relaxed);
+            result.jobsStolen += externalJobsStolen.load(std::memory_order_relaxed);
+            result.jobsInjected = jobsInjected.load(std::memory_order_relaxed);
+            result.workerSleeps = workerSleeps.load(std::memory_order_relaxed);
+            return result;
+        }
+
+    private:
+        void push(const QueuedJob& job)
+        {
+            if (threadIndex != EXTERNAL_JOB_THREAD && threads[threadIndex]->deque.push(job)) return;
+
+            std::lock_guard<std::mutex> lock{injectionMutex};
+            injectionQueue.push_back(job);
+            injectionSize.fetch_add(1, std::memory_order_relaxed);
+            jobsInjected.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        bool popInjected(QueuedJob& job)
+        {
+            if (injectionSize.load(std::memory_order_relaxed) == 0) return false;
+
+            std::lock_guard<std::mutex> lock{injectionMutex};
+            if (injectionQueue.empty()) return false;
+            job = injectionQueue.front();
+            injectionQueue.pop_front();
+            injectionSize.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool steal(uint32_t self, QueuedJob& job)
+        {
+            // start at a random victim so thieves spread out instead of all hitting deque 0
+            uint32_t start = 0;
+            if (self != EXTERNAL_JOB_THREAD)
+            {
+                uint32_t& state = threads[self]->randomState;
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                start = state;
+            }
+
+            uint32_t count = static_cast<uint32_t>(threads.size());
+            for (uint32_t i = 0; i < count; i++)
+            {
+                uint32_t victim = (start + i) % count;
+                if (victim != self && threads[victim]->deque.steal(job)) return true;
+            }
+            return false;
+        }
+
+        bool runOne(uint32_t self)
+        {
+            // own jobs first since they are the most recent and the most likely to still be in cache
+            QueuedJob job;
+            bool stolen = false;
+            bool found = (self != EXTERNAL_JOB_THREAD && threads[self]->deque.pop(job)) || popInjected(job);
+            if (!found)
+            {
+                found = stolen = steal(self, job);
+            }
+            if (!found) return false;
+
+            execute(job, self, stolen);
+            return true;
+        }
+
+        void execute(const QueuedJob& job, uint32_t self, bool stolen)
+        {
+            callHook(hooks.jobBegin, self);
+            job.job.fn(job.job.context);
+            callHook(hooks.jobEnd, self);
+
+            std::atomic<uint64_t>& executed = self != EXTERNAL_JOB_THREAD ? threads[self]->jobsExecuted : externalJobsExecuted;
+            executed.fetch_add(1, std::memory_order_relaxed);
+            if (stolen)
+            {
+                std::atomic<uint64_t>& stolenCount = self != EXTERNAL_JOB_THREAD ? threads[self]->jobsStolen : externalJobsStolen;
+                stolenCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (job.counter != nullptr)
+            {
+                finish(*job.counter);
+            }
+        }
+
+        void finish(JobCounter& counter)
+        {
+            // only the decrement that may reach zero takes the lock
+            uint32_t pending = counter.pending.load(std::memory_order_relaxed);
+            while (pending > 1)
+            {
+                if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+                {
+                    return;
+                }
+            }
+
+            std::vector<JobCounter::Continuation> released;
+            {
+                std::lock_guard<std::mutex> lock{counter.mutex};
+                if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    released.swap(counter.continuations);
+                }
+            }
+            // the counter may be gone from here on, its waiter only needed the lock released
+
+            for (const auto& continuation : released)
+            {
+                push({continuation.job, continuation.counter});
+            }
+            wakeWorkers(released.size());
+        }
+
+        void wakeWorkers(size_t count)
+        {
+            if (count == 0) return;
+
+            // pairs with the fence in sleep, either the sleeper sees the job or we see the sleeper
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepingWorkers.load(std::memory_order_relaxed) == 0) return;
+
+            {
+                std::lock_guard<std::mutex> lock{sleepMutex};
+                wakeSignals += count;
+            }
+            if (count == 1)
+            {
+                sleepCondition.notify_one();
+            } else
+            {
+                sleepCondition.notify_all();
+            }
+        }
+
+        bool hasQueuedJobs() const
+        {
+            if (injectionSize.load(std::memory_order_relaxed) != 0) return true;
+            for (const auto& thread : threads)
+            {
+                if (!thread->deque.empty()) return true;
+            }
+            return false;
+        }
+
+        void sleep(uint32_t self)
+        {
+            std::unique_lock<std::mutex> lock{sleepMutex};
+            sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!hasQueuedJobs() && !stopping.load(std::memory_order_relaxed))
+            {
+                workerSleeps.fetch_add(1, std::memory_order_relaxed);
+                callHook(hooks.workerSleep, self);
+                sleepCondition.wait(lock, [this]()
+                {
+                    return wakeSignals > 0 || stopping.load(std::memory_order_relaxed);
+                });
+                if (wakeSignals > 0) wakeSignals--;
+                callHook(hooks.workerWake, self);
+            }
+
+            sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void workerLoop(uint32_t index)
+        {
+            threadIndex = index;
+            int idleSpins = 0;
+            while (!stopping.load(std::memory_order_relaxed))
+            {
+                if (runOne(index))
+                {
+                    idleSpins = 0;
+                    continue;
+                }
+
+                if (++idleSpins < IDLE_SPINS_BEFORE_SLEEP)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                idleSpins = 0;
+                sleep(index);
+            }
+        }
+
+        std::vector<std::unique_ptr<ThreadState>> threads;
+        std::vector<std::thread> workers;
+
+        std::mutex injectionMutex;
+        std::deque<QueuedJob> injectionQueue;
+        std::atomic<size_t> injectionSize{0};
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        std::atomic<uint32_t> sleepingWorkers{0};
+        size_t wakeSignals = 0;
+        std::atomic<bool> stopping{false};
+
+        std::atomic<uint64_t> externalJobsExecuted{0};
+        std::atomic<uint64_t> externalJobsStolen{0};
+        std::atomic<uint64_t> jobsInjected{0};
+        std::atomic<uint64_t> workerSleeps{0};
+    };
+
+    namespace
+    {
+        BEJobSystem& jobSystem()
+        {
+            static BEJobSystem system{[]()
+            {
+                size_t count = requestedThreadCount.load();
+                if (count == 0)
+                {
+                    count = std::max(1u, std::thread::hardware_concurrency());
+                }
+                return count;
+            }()};
+            return system;
+        }
+    }
+
+    void setJobThreadCount(size_t threadCount)
+    {
+        requestedThreadCount.store(threadCount);
+    }
+
+    size_t jobThreadCount()
+    {
+        return jobSystem().threadCount();
+    }
+
+    void submitJobs(const JobDecl* jobs, size_t count, JobCounter* counter, JobCounter* dependency)
+    {
+        jobSystem().submit(jobs, count, counter, dependency);
+    }
+
+    void waitForCounter(JobCounter& counter)
+    {
+        jobSystem().wait(counter);
+    }
+
+    void setJobSystemHooks(const JobSystemHooks& newHooks)
+    {
+        hooks.context.store(newHooks.context, std::memory_order_relaxed);
+        hooks.jobBegin.store(newHooks.jobBegin, std::memory_order_relaxed);
+        hooks.jobEnd.store(newHooks.jobEnd, std::memory_order_relaxed);
+        hooks.workerSleep.store(newHooks.workerSleep, std::memory_order_relaxed);
+        hooks.workerWake.store(newHooks.workerWake, std::memory_order_relaxed);
+    }
+
+    JobSystemStats getJobSystemStats()
+    {
+        return jobSystem().stats();
+    }
+}
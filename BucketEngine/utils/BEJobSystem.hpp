@@ -0,0 +1,124 @@
+﻿#pragma once
+
+// std
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace bucketengine
+{
+    class BEJobSystem;
+
+    // type erased job, context has to stay alive until the counter the job was submitted with is done
+    using JobFn = void (*)(void* context);
+
+    struct JobDecl
+    {
+        JobFn fn = nullptr;
+        void* context = nullptr;
+    };
+
+    // counts the jobs submitted against it that haven't finished, and holds jobs waiting for it to
+    // reach zero. a counter can be reused once it is done, but must be waited on with waitForCounter
+    // before it is destroyed so the thread that finished its last job has let go of it
+    class JobCounter
+    {
+    public:
+        JobCounter() = default;
+        ~JobCounter() = default;
+
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class BEJobSystem;
+
+        struct Continuation
+        {
+            JobDecl job;
+            JobCounter* counter;
+        };
+
+        std::atomic<uint32_t> pending{0};
+        // guards the last decrement as well as continuations, so dependents can't be added after
+        // the counter has released them
+        std::mutex mutex;
+        std::vector<Continuation> continuations;
+    };
+
+    // thread index reported to the hooks for threads that don't belong to the job system
+    constexpr uint32_t EXTERNAL_JOB_THREAD = ~0u;
+
+    // optional callbacks for profilers, set while no jobs are running. threadIndex is in
+    // [0, jobThreadCount()) or EXTERNAL_JOB_THREAD, null callbacks are skipped
+    struct JobSystemHooks
+    {
+        void* context = nullptr;
+        void (*jobBegin)(void* context, uint32_t threadIndex) = nullptr;
+        void (*jobEnd)(void* context, uint32_t threadIndex) = nullptr;
+        // a worker ran out of jobs and is about to sleep, and woke up again
+        void (*workerSleep)(void* context, uint32_t threadIndex) = nullptr;
+        void (*workerWake)(void* context, uint32_t threadIndex) = nullptr;
+    };
+
+    // running totals since startup
+    struct JobSystemStats
+    {
+        uint64_t jobsExecuted = 0;
+        // jobs taken from another thread's deque
+        uint64_t jobsStolen = 0;
+        // jobs that went through the shared queue, because they came from an external thread,
+        // the submitting deque was full, or they were released by a counter
+        uint64_t jobsInjected = 0;
+        uint64_t workerSleeps = 0;
+    };
+
+    /**
+     * Sets the number of threads running jobs, including the thread that owns deque 0. Only has an
+     * effect before the first job is submitted.
+     *
+     * @param threadCount 0 uses one thread per hardware thread
+     */
+    void setJobThreadCount(size_t threadCount);
+    size_t jobThreadCount();
+
+    /**
+     * Queue jobs on the calling thread's deque, idle workers steal them from there.
+     *
+     * @param jobs Jobs to run, copied before this returns
+     * @param count Number of jobs
+     * @param counter Incremented by count now and decremented as each job finishes, may be null
+     * @param dependency The jobs are held back until this counter is done, may be null
+     */
+    void submitJobs(const JobDecl* jobs, size_t count, JobCounter* counter, JobCounter* dependency = nullptr);
+
+    // runs other jobs on the calling thread until the counter is done, so waiting inside a job can't deadlock
+    void waitForCounter(JobCounter& counter);
+
+    void setJobSystemHooks(const JobSystemHooks& hooks);
+    JobSystemStats getJobSystemStats();
+
+    /**
+     * Submit a callable as a job.
+     *
+     * @param fn Called as fn(), not copied, so it has to outlive the job
+     * @param counter Decremented once fn has returned, may be null
+     * @param dependency fn only runs once this counter is done, may be null
+     */
+    template <typename Fn>
+    void submitJob(Fn& fn, JobCounter* counter, JobCounter* dependency = nullptr)
+    {
+        JobDecl job{};
+        job.context = &fn;
+        job.fn = [](void* context)
+        {
+            (*static_cast<std::remove_reference_t<Fn>*>(context))();
+        };
+        submitJobs(&job, 1, counter, dependency);
+    }
+}
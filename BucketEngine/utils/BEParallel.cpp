@@ -0,0 +1,71 @@
+﻿#include "BEParallel.hpp"
+#include "BEJobSystem.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        struct ParallelJob
+        {
+            void* context;
+            ParallelRangeFn fn;
+            size_t count;
+            size_t grainSize;
+            size_t rangeCount;
+            std::atomic<size_t> nextRange{0};
+        };
+
+        // every thread taking part claims ranges from the shared counter until there are none left,
+        // so a slow range doesn't hold up the ones queued behind it
+        void work(void* context)
+        {
+            ParallelJob& job = *static_cast<ParallelJob*>(context);
+            size_t range;
+            while ((range = job.nextRange.fetch_add(1)) < job.rangeCount)
+            {
+                size_t begin = range * job.grainSize;
+                size_t end = std::min(begin + job.grainSize, job.count);
+                job.fn(job.context, begin, end);
+            }
+        }
+    }
+
+    size_t parallelThreadCount()
+    {
+        return jobThreadCount();
+    }
+
+    void parallelForRanges(size_t count, size_t grainSize, void* context, ParallelRangeFn fn)
+    {
+        if (count == 0) return;
+
+        grainSize = std::max<size_t>(grainSize, 1);
+        if (count <= grainSize || parallelThreadCount() == 1)
+        {
+            fn(context, 0, count);
+            return;
+        }
+
+        ParallelJob job{};
+        job.context = context;
+        job.fn = fn;
+        job.count = count;
+        job.grainSize = grainSize;
+        job.rangeCount = (count + grainSize - 1) / grainSize;
+
+        // one helper for each other thread that could take part, helpers that start after the
+        // ranges ran out return straight away
+        size_t helperCount = std::min(job.rangeCount, parallelThreadCount()) - 1;
+        std::vector<JobDecl> helpers(helperCount, JobDecl{work, &job});
+
+        JobCounter counter{};
+        submitJobs(helpers.data(), helpers.size(), &counter);
+        work(&job);
+        waitForCounter(counter);
+    }
+}
@@ -0,0 +1,35 @@
+﻿#pragma once
+
+// std
+#include <cstddef>
+#include <type_traits>
+
+namespace bucketengine
+{
+    // number of threads parallelFor spreads work over, including the calling thread
+    size_t parallelThreadCount();
+
+    // type erased range function, keeps the job system out of the header
+    using ParallelRangeFn = void (*)(void* context, size_t begin, size_t end);
+    void parallelForRanges(size_t count, size_t grainSize, void* context, ParallelRangeFn fn);
+
+    /**
+     * Split [0, count) into contiguous ranges and call fn(begin, end) for each of them on the job
+     * system's threads, the calling thread works on ranges too and returns once all are done.
+     *
+     * Runs everything on the calling thread when count fits in a single grain or when the job system
+     * has a single thread. Can be nested and called from jobs, waiting threads run other jobs.
+     *
+     * @param count Number of items
+     * @param grainSize Smallest number of items worth handing to another thread
+     * @param fn Called as fn(size_t begin, size_t end), ranges never overlap
+     */
+    template <typename Fn>
+    void parallelFor(size_t count, size_t grainSize, Fn&& fn)
+    {
+        parallelForRanges(count, grainSize, &fn, [](void* context, size_t begin, size_t end)
+        {
+            (*static_cast<std::remove_reference_t<Fn>*>(context))(begin, end);
+        });
+    }
+}
@@ -0,0 +1,43 @@
+﻿#include "BESimd.hpp"
+
+#if defined(BE_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace bucketengine
+{
+    namespace
+    {
+        SimdLevel detectSimdLevel()
+        {
+#if defined(BE_SIMD_X86) && defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            const bool sse41 = (info[2] & (1 << 19)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            // the os has to save the upper halves of the ymm registers on context switches
+            const bool osSavesYmm = osxsave && avx && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] & (1 << 5)) != 0;
+            if (avx2 && osSavesYmm) return SimdLevel::AVX2;
+            if (sse41) return SimdLevel::SSE4;
+            return SimdLevel::Scalar;
+#elif defined(BE_SIMD_X86)
+            // also checks the os supports the ymm state
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+            if (__builtin_cpu_supports("sse4.1")) return SimdLevel::SSE4;
+            return SimdLevel::Scalar;
+#else
+            return SimdLevel::Scalar;
+#endif
+        }
+    }
+
+    SimdLevel getSimdLevel()
+    {
+        static const SimdLevel level = detectSimdLevel();
+        return level;
+    }
+}
@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// gcc and clang only emit wider instructions inside functions that ask for them, msvc always can
+#if defined(BE_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BE_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define BE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BE_TARGET_SSE4
+#define BE_TARGET_AVX2
+#endif
+
+// helpers taking vector arguments have to be inlined into their kernels or the vectors go through
+// the stack. gcc refuses to inline them into functions compiled for a narrower target
+#if defined(_MSC_VER)
+#define BE_FORCE_INLINE __forceinline
+#else
+#define BE_FORCE_INLINE __attribute__((always_inline)) inline
+#endif
+
+namespace bucketengine
+{
+    enum class SimdLevel
+    {
+        Scalar,
+        SSE4,
+        AVX2,
+    };
+
+    // the widest instruction set both the cpu and the os support, detected once
+    SimdLevel getSimdLevel();
+}
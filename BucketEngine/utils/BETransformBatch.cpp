@@ -0,0 +1,372 @@
+﻿#include "BETransformBatch.hpp"
+
+// std
+#include <cmath>
+#include <cstdint>
+
+namespace bucketengine
+{
+    namespace
+    {
+        void computeScalar(const TransformBatch& batch, size_t begin, glm::mat4* modelMatrices, glm::mat3x4* normalMatrices)
+        {
+            for (size_t i = begin; i < batch.count; i++)
+            {
+                const float c3 = std::cos(batch.rotationZ[i]);
+                const float s3 = std::sin(batch.rotationZ[i]);
+                const float c2 = std::cos(batch.rotationX[i]);
+                const float s2 = std::sin(batch.rotationX[i]);
+                const float c1 = std::cos(batch.rotationY[i]);
+                const float s1 = std::sin(batch.rotationY[i]);
+
+                const glm::vec3 column0{c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1};
+                const glm::vec3 column1{c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3};
+                const glm::vec3 column2{c2 * s1, -s2, c1 * c2};
+
+                if (modelMatrices != nullptr)
+                {
+                    modelMatrices[i] = glm::mat4{
+                        glm::vec4{column0 * batch.scaleX[i], 0.f},
+                        glm::vec4{column1 * batch.scaleY[i], 0.f},
+                        glm::vec4{column2 * batch.scaleZ[i], 0.f},
+                        glm::vec4{batch.translationX[i], batch.translationY[i], batch.translationZ[i], 1.f}};
+                }
+                if (normalMatrices != nullptr)
+                {
+                    normalMatrices[i] = glm::mat3x4{
+                        glm::vec4{column0 * (1.f / batch.scaleX[i]), 0.f},
+                        glm::vec4{column1 * (1.f / batch.scaleY[i]), 0.f},
+                        glm::vec4{column2 * (1.f / batch.scaleZ[i]), 0.f}};
+                }
+            }
+        }
+
+#ifdef BE_SIMD_X86
+        // cephes single precision sincos constants, range reduction is done in three steps so the
+        // reduced angle stays accurate far beyond 2pi
+        constexpr float FOUR_OVER_PI = 1.27323954473516f;
+        constexpr float MINUS_DP1 = -0.78515625f;
+        constexpr float MINUS_DP2 = -2.4187564849853515625e-4f;
+        constexpr float MINUS_DP3 = -3.77489497744594108e-8f;
+        constexpr float COS_P0 = 2.443315711809948e-5f;
+        constexpr float COS_P1 = -1.388731625493765e-3f;
+        constexpr float COS_P2 = 4.166664568298827e-2f;
+        constexpr float SIN_P0 = -1.9515295891e-4f;
+        constexpr float SIN_P1 = 8.3321608736e-3f;
+        constexpr float SIN_P2 = -1.6666654611e-1f;
+
+        BE_FORCE_INLINE BE_TARGET_SSE4 void sincosSSE(__m128 x, __m128& sinOut, __m128& cosOut)
+        {
+            const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+
+            __m128 signSin = _mm_and_ps(x, signMask);
+            x = _mm_andnot_ps(signMask, x);
+
+            // octant of the angle, rounded up to even so the reduced angle is in [-pi/4, pi/4]
+            __m128i quadrant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+            quadrant = _mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+            __m128 y = _mm_cvtepi32_ps(quadrant);
+
+            __m128 swapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(4)), 29));
+            __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+            __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(
+                _mm_andnot_si128(_mm_sub_epi32(quadrant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+            signSin = _mm_xor_ps(signSin, swapSignSin);
+
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP1)));
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP2)));
+            x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP3)));
+            __m128 z = _mm_mul_ps(x, x);
+
+            __m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1));
+            cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(COS_P2));
+            cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+            cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+            cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.f));
+
+            __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1));
+            sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SIN_P2));
+            sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+            // in odd quadrant pairs sine and cosine swap polynomials
+            sinOut = _mm_xor_ps(_mm_blendv_ps(cosPoly, sinPoly, polyMask), signSin);
+            cosOut = _mm_xor_ps(_mm_blendv_ps(sinPoly, cosPoly, polyMask), signCos);
+        }
+
+        // writes four matrices of Columns vec4 columns from registers that each hold one entry of all four
+        template <typename Matrix, int Columns>
+        BE_FORCE_INLINE BE_TARGET_SSE4 void storeMatricesSSE(__m128 (&entries)[16], Matrix* matrices)
+        {
+            for (int column = 0; column < Columns; column++)
+            {
+                __m128 r0 = entries[column * 4 + 0];
+                __m128 r1 = entries[column * 4 + 1];
+                __m128 r2 = entries[column * 4 + 2];
+                __m128 r3 = entries[column * 4 + 3];
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                _mm_storeu_ps(&matrices[0][column][0], r0);
+                _mm_storeu_ps(&matrices[1][column][0], r1);
+                _mm_storeu_ps(&matrices[2][column][0], r2);
+                _mm_storeu_ps(&matrices[3][column][0], r3);
+            }
+        }
+
+        BE_TARGET_SSE4 size_t computeSSE(const TransformBatch& batch, glm::mat4* modelMatrices, glm::mat3x4* normalMatrices)
+        {
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.f);
+
+            size_t i = 0;
+            for (; i + 4 <= batch.count; i += 4)
+            {
+                __m128 s1, c1, s2, c2, s3, c3;
+                sincosSSE(_mm_loadu_ps(batch.rotationY + i), s1, c1);
+                sincosSSE(_mm_loadu_ps(batch.rotationX + i), s2, c2);
+                sincosSSE(_mm_loadu_ps(batch.rotationZ + i), s3, c3);
+
+                const __m128 s1s2 = _mm_mul_ps(s1, s2);
+                const __m128 c1s2 = _mm_mul_ps(c1, s2);
+                const __m128 rotation[9] = {
+                    _mm_add_ps(_mm_mul_ps(c1, c3), _mm_mul_ps(s1s2, s3)),
+                    _mm_mul_ps(c2, s3),
+                    _mm_sub_ps(_mm_mul_ps(c1s2, s3), _mm_mul_ps(c3, s1)),
+                    _mm_sub_ps(_mm_mul_ps(c3, s1s2), _mm_mul_ps(c1, s3)),
+                    _mm_mul_ps(c2, c3),
+                    _mm_add_ps(_mm_mul_ps(c1s2, c3), _mm_mul_ps(s1, s3)),
+                    _mm_mul_ps(c2, s1),
+                    _mm_sub_ps(zero, s2),
+                    _mm_mul_ps(c1, c2),
+                };
+
+                const __m128 scale[3] = {
+                    _mm_loadu_ps(batch.scaleX + i),
+                    _mm_loadu_ps(batch.scaleY + i),
+                    _mm_loadu_ps(batch.scaleZ + i),
+                };
+
+                __m128 entries[16];
+                if (modelMatrices != nullptr)
+                {
+                    for (int column = 0; column < 3; column++)
+                    {
+                        for (int row = 0; row < 3; row++)
+                        {
+                            entries[column * 4 + row] = _mm_mul_ps(rotation[column * 3 + row], scale[column]);
+                        }
+                        entries[column * 4 + 3] = zero;
+                    }
+                    entries[12] = _mm_loadu_ps(batch.translationX + i);
+                    entries[13] = _mm_loadu_ps(batch.translationY + i);
+                    entries[14] = _mm_loadu_ps(batch.translationZ + i);
+                    entries[15] = one;
+                    storeMatricesSSE<glm::mat4, 4>(entries, modelMatrices + i);
+                }
+                if (normalMatrices != nullptr)
+                {
+                    for (int column = 0; column < 3; column++)
+                    {
+                        const __m128 inverseScale = _mm_div_ps(one, scale[column]);
+                        for (int row = 0; row < 3; row++)
+                        {
+                            entries[column * 4 + row] = _mm_mul_ps(rotation[column * 3 + row], inverseScale);
+                        }
+                        entries[column * 4 + 3] = zero;
+                    }
+                    storeMatricesSSE<glm::mat3x4, 3>(entries, normalMatrices + i);
+                }
+            }
+            return i;
+        }
+
+        BE_FORCE_INLINE BE_TARGET_AVX2 void sincosAVX(__m256 x, __m256& sinOut, __m256& cosOut)
+        {
+            const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000u)));
+
+            __m256 signSin = _mm256_and_ps(x, signMask);
+            x = _mm256_andnot_ps(signMask, x);
+
+            __m256i quadrant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+            quadrant = _mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+            __m256 y = _mm256_cvtepi32_ps(quadrant);
+
+            __m256 swapSignSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(4)), 29));
+            __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                _mm256_and_si256(quadrant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+            __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+                _mm256_andnot_si256(_mm256_sub_epi32(quadrant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+            signSin = _mm256_xor_ps(signSin, swapSignSin);
+
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP1)));
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP2)));
+            x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP3)));
+            __m256 z = _mm256_mul_ps(x, x);
+
+            __m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_P0), z), _mm256_set1_ps(COS_P1));
+            cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(COS_P2));
+            cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+            cosPoly = _mm256_sub_ps(cosPoly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+            cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.f));
+
+            __m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_P0), z), _mm256_set1_ps(SIN_P1));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(SIN_P2));
+            sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, z), x), x);
+
+            sinOut = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, polyMask), signSin);
+            cosOut = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, polyMask), signCos);
+        }
+
+        // transposes 8 registers of 8 lanes so register i holds lane i of every input
+        BE_FORCE_INLINE BE_TARGET_AVX2 void transpose8(__m256 (&r)[8])
+        {
+            __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+            __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+            __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+            __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+            __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+            __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+            __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+            __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+            __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+            __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+            __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+            r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+            r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+            r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+            r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+            r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+            r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+            r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+            r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+        }
+
+        // writes eight matrices of Columns vec4 columns from registers that each hold one entry of all
+        // eight, two columns at a time. a column left over is transposed with zeros in place of the next
+        template <typename Matrix, int Columns>
+        BE_FORCE_INLINE BE_TARGET_AVX2 void storeMatricesAVX(__m256 (&entries)[16], Matrix* matrices)
+        {
+            for (int pair = 0; pair < (Columns + 1) / 2; pair++)
+            {
+                const bool single = pair * 2 + 1 == Columns;
+                __m256 rows[8];
+                for (int j = 0; j < 8; j++)
+                {
+                    rows[j] = single && j >= 4 ? _mm256_setzero_ps() : entries[pair * 8 + j];
+                }
+                transpose8(rows);
+                for (int j = 0; j < 8; j++)
+                {
+                    if (single)
+                    {
+                        _mm_storeu_ps(&matrices[j][pair * 2][0], _mm256_castps256_ps128(rows[j]));
+                    } else
+                    {
+                        _mm256_storeu_ps(&matrices[j][pair * 2][0], rows[j]);
+                    }
+                }
+            }
+        }
+
+        BE_TARGET_AVX2 size_t computeAVX(const TransformBatch& batch, glm::mat4* modelMatrices, glm::mat3x4* normalMatrices)
+        {
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 one = _mm256_set1_ps(1.f);
+
+            size_t i = 0;
+            for (; i + 8 <= batch.count; i += 8)
+            {
+                __m256 s1, c1, s2, c2, s3, c3;
+                sincosAVX(_mm256_loadu_ps(batch.rotationY + i), s1, c1);
+                sincosAVX(_mm256_loadu_ps(batch.rotationX + i), s2, c2);
+                sincosAVX(_mm256_loadu_ps(batch.rotationZ + i), s3, c3);
+
+                const __m256 s1s2 = _mm256_mul_ps(s1, s2);
+                const __m256 c1s2 = _mm256_mul_ps(c1, s2);
+                const __m256 rotation[9] = {
+                    _mm256_add_ps(_mm256_mul_ps(c1, c3), _mm256_mul_ps(s1s2, s3)),
+                    _mm256_mul_ps(c2, s3),
+                    _mm256_sub_ps(_mm256_mul_ps(c1s2, s3), _mm256_mul_ps(c3, s1)),
+                    _mm256_sub_ps(_mm256_mul_ps(c3, s1s2), _mm256_mul_ps(c1, s3)),
+                    _mm256_mul_ps(c2, c3),
+                    _mm256_add_ps(_mm256_mul_ps(c1s2, c3), _mm256_mul_ps(s1, s3)),
+                    _mm256_mul_ps(c2, s1),
+                    _mm256_sub_ps(zero, s2),
+                    _mm256_mul_ps(c1, c2),
+                };
+
+                const __m256 scale[3] = {
+                    _mm256_loadu_ps(batch.scaleX + i),
+                    _mm256_loadu_ps(batch.scaleY + i),
+                    _mm256_loadu_ps(batch.scaleZ + i),
+                };
+
+                __m256 entries[16];
+                if (modelMatrices != nullptr)
+                {
+                    for (int column = 0; column < 3; column++)
+                    {
+                        for (int row = 0; row < 3; row++)
+                        {
+                            entries[column * 4 + row] = _mm256_mul_ps(rotation[column * 3 + row], scale[column]);
+                        }
+                        entries[column * 4 + 3] = zero;
+                    }
+                    entries[12] = _mm256_loadu_ps(batch.translationX + i);
+                    entries[13] = _mm256_loadu_ps(batch.translationY + i);
+                    entries[14] = _mm256_loadu_ps(batch.translationZ + i);
+                    entries[15] = one;
+                    storeMatricesAVX<glm::mat4, 4>(entries, modelMatrices + i);
+                }
+                if (normalMatrices != nullptr)
+                {
+                    for (int column = 0; column < 3; column++)
+                    {
+                        const __m256 inverseScale = _mm256_div_ps(one, scale[column]);
+                        for (int row = 0; row < 3; row++)
+                        {
+                            entries[column * 4 + row] = _mm256_mul_ps(rotation[column * 3 + row], inverseScale);
+                        }
+                        entries[column * 4 + 3] = zero;
+                    }
+                    storeMatricesAVX<glm::mat3x4, 3>(entries, normalMatrices + i);
+                }
+            }
+            return i;
+        }
+#endif
+    }
+
+    void computeTransformMatrices(
+        const TransformBatch& batch,
+        glm::mat4* modelMatrices,
+        glm::mat3x4* normalMatrices,
+        SimdLevel level)
+    {
+        size_t done = 0;
+#ifdef BE_SIMD_X86
+        // never run a path the cpu can't execute, even when asked to
+        if (level > getSimdLevel())
+        {
+            level = getSimdLevel();
+        }
+        if (level == SimdLevel::AVX2)
+        {
+            done = computeAVX(batch, modelMatrices, normalMatrices);
+        }
+        else if (level == SimdLevel::SSE4)
+        {
+            done = computeSSE(batch, modelMatrices, normalMatrices);
+        }
+#else
+        (void)level;
+#endif
+        // whatever doesn't fill a full simd register
+        computeScalar(batch, done, modelMatrices, normalMatrices);
+    }
+}
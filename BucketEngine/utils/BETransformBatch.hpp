@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "BESimd.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+
+namespace bucketengine
+{
+    // structure of arrays input for computeTransformMatrices, element i of every array
+    // describes transform i. the layout matches TransformComponent::mat4
+    struct TransformBatch
+    {
+        const float* translationX;
+        const float* translationY;
+        const float* translationZ;
+        const float* rotationX;
+        const float* rotationY;
+        const float* rotationZ;
+        const float* scaleX;
+        const float* scaleY;
+        const float* scaleZ;
+        size_t count;
+    };
+
+    /**
+     * Compute model and normal matrices for a batch of transforms.
+     *
+     * Results match TransformComponent::mat4 and normalMatrix to within a few ulp, the simd paths
+     * use a polynomial sincos that is accurate to about 1e-7 for angles up to a few thousand radians.
+     *
+     * @param batch The transforms to compute
+     * @param modelMatrices Receives batch.count model matrices, may be nullptr
+     * @param normalMatrices Receives batch.count normal matrices, the mat3 padded to three vec4 columns
+     * the push constant uses, may be nullptr
+     * @param level (Optional) Forces a code path, levels the cpu doesn't support fall back to scalar
+     */
+    void computeTransformMatrices(
+        const TransformBatch& batch,
+        glm::mat4* modelMatrices,
+        glm::mat3x4* normalMatrices,
+        SimdLevel level = getSimdLevel()
+    );
+}
@@ -0,0 +1,63 @@
+﻿#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace bucketengine
+{
+    // lock free handoff of a value from one producer thread to one consumer thread. the producer
+    // fills back() and publishes it, the consumer picks up the most recently published value with
+    // acquire(). neither side ever waits on the other, a value published before the consumer got
+    // to the previous one replaces it
+    template <typename T>
+    class BETripleBuffer
+    {
+    public:
+        BETripleBuffer() = default;
+
+        BETripleBuffer(const BETripleBuffer&) = delete;
+        BETripleBuffer& operator=(const BETripleBuffer&) = delete;
+
+        // producer only, the value being filled. its contents are whatever it held three publishes ago
+        T& back() { return slots[backIndex]; }
+
+        // producer only, hands back() to the consumer and takes a free slot as the new back()
+        void publish()
+        {
+            uint8_t previous = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+            backIndex = previous & INDEX_MASK;
+        }
+
+        // producer only, true while the last published value hasn't been acquired yet
+        bool hasPending() const
+        {
+            return (middle.load(std::memory_order_acquire) & FRESH_BIT) != 0;
+        }
+
+        // consumer only, returns true and moves front() to the latest value if one was published
+        // since the last call, front() is left alone otherwise
+        bool acquire()
+        {
+            if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+
+            uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+            frontIndex = previous & INDEX_MASK;
+            return true;
+        }
+
+        // consumer only, stays untouched by the producer until the next acquire
+        const T& front() const { return slots[frontIndex]; }
+
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3;
+        static constexpr uint8_t FRESH_BIT = 0x4;
+
+        std::array<T, 3> slots{};
+        // each side owns one slot, the third sits in middle waiting to be swapped with either
+        alignas(64) uint8_t backIndex = 0;
+        alignas(64) uint8_t frontIndex = 1;
+        alignas(64) std::atomic<uint8_t> middle{2};
+    };
+}
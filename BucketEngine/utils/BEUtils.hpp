@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <functional>
 
 namespace bucketengine
@@ -10,4 +12,84 @@ namespace bucketengine
         seed ^= std::hash<T>{}(v) + 0x9e3779b9 + (seed << 6) + (seed >> 21);
         (hashCombine(seed, rest), ...);
     }
+
+    inline std::uint64_t rotateLeft(std::uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    /**
+     * Hash a block of raw bytes.
+     *
+     * The input is consumed in 32 byte stripes spread over four independent 64bit lanes so the
+     * compiler can keep them in flight together (xxHash64 style), this is much faster than
+     * hashing a struct member by member with hashCombine.
+     *
+     * @param data Pointer to the bytes to hash
+     * @param size Number of bytes to hash
+     * @param seed (Optional) Seed value
+     *
+     * @return 64bit hash of the bytes
+     */
+    inline std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t seed = 0)
+    {
+        constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+        constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        const std::uint64_t length = size;
+
+        std::uint64_t lanes[4] = {seed + prime1 + prime2, seed + prime2, seed, seed - prime1};
+        while (size >= 32)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, bytes + i * 8, sizeof(word));
+                lanes[i] = rotateLeft(lanes[i] + word * prime2, 31) * prime1;
+            }
+            bytes += 32;
+            size -= 32;
+        }
+
+        std::uint64_t hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7)
+            + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18) + length;
+
+        while (size >= 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            hash ^= rotateLeft(word * prime2, 31) * prime1;
+            hash = rotateLeft(hash, 27) * prime1 + prime3;
+            bytes += 8;
+            size -= 8;
+        }
+
+        if (size >= 4)
+        {
+            std::uint32_t word;
+            std::memcpy(&word, bytes, sizeof(word));
+            hash ^= static_cast<std::uint64_t>(word) * prime1;
+            hash = rotateLeft(hash, 23) * prime2 + prime3;
+            bytes += 4;
+            size -= 4;
+        }
+
+        while (size > 0)
+        {
+            hash ^= static_cast<std::uint64_t>(*bytes) * prime3;
+            hash = rotateLeft(hash, 11) * prime1;
+            bytes++;
+            size--;
+        }
+
+        // final avalanche so every input bit affects the low bits we use for bucket selection
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
 }
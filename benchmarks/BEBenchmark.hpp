@@ -0,0 +1,44 @@
+﻿#pragma once
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+namespace bucketengine
+{
+    // each benchmark prints its own results, main picks which ones run
+    void runDedupBenchmark();
+    void runSceneBenchmark();
+    void runRegistryBenchmark();
+    void runRaycastBenchmark();
+    void runTransformBenchmark();
+
+    // fastest of several runs, so one slow run from the os scheduling something else doesn't count.
+    // the first run doubles as the warm up
+    template <typename Fn>
+    double measureSeconds(int runs, Fn&& fn)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    inline void reportTime(const char* name, double seconds)
+    {
+        std::printf("  %-48s %10.3f ms\n", name, seconds * 1000.0);
+    }
+
+    // items per second in millions, e.g. unit "Mrays/s"
+    inline void reportRate(const char* name, double seconds, double items, const char* unit)
+    {
+        std::printf("  %-48s %10.3f ms %10.2f %s\n", name, seconds * 1000.0, items / seconds / 1e6, unit);
+    }
+}
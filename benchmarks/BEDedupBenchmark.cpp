@@ -0,0 +1,159 @@
+﻿#include "BEBenchmark.hpp"
+
+#include "BEModel.hpp"
+#include "utils/BEUtils.hpp"
+
+// libs
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+// std
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace std
+{
+    // the hash the loader used before the open addressing table, kept to compare against
+    template <>
+    struct hash<bucketengine::BEModel::Vertex>
+    {
+        size_t operator()(bucketengine::BEModel::Vertex const &vertex) const {
+            size_t seed = 0;
+            bucketengine::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+            return seed;
+        }
+    };
+}
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr size_t SYNTHETIC_INDEX_COUNT = 10'000'000;
+        // small models are deduplicated over and over until about this many indices were processed
+        constexpr size_t MIN_INDICES_PER_RUN = 1'000'000;
+        constexpr int RUNS = 5;
+
+        // the old loader path, an unordered_map looked up twice per vertex
+        void deduplicateUnorderedMap(
+            const std::vector<BEModel::Vertex>& corners,
+            std::vector<BEModel::Vertex>& vertices,
+            std::vector<uint32_t>& indices)
+        {
+            vertices.clear();
+            indices.clear();
+            std::unordered_map<BEModel::Vertex, uint32_t> uniqueVertices{};
+            for (const auto& vertex : corners)
+            {
+                if (uniqueVertices.count(vertex) == 0)
+                {
+                    uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                    vertices.push_back(vertex);
+                }
+                indices.push_back(uniqueVertices[vertex]);
+            }
+        }
+
+        // a flat grid of quads, two triangles each with one vertex per corner, so every interior
+        // vertex shows up six times like in a typical closed mesh
+        std::vector<BEModel::Vertex> makeGridCorners(size_t indexCount)
+        {
+            size_t quadsPerSide = 1;
+            while (quadsPerSide * quadsPerSide * 6 < indexCount)
+            {
+                quadsPerSide++;
+            }
+
+            auto gridVertex = [quadsPerSide](size_t x, size_t z)
+            {
+                float u = static_cast<float>(x) / static_cast<float>(quadsPerSide);
+                float v = static_cast<float>(z) / static_cast<float>(quadsPerSide);
+                BEModel::Vertex vertex{};
+                vertex.position = {u * 100.f, 0.f, v * 100.f};
+                vertex.color = {1.f, 1.f, 1.f};
+                vertex.normal = {0.f, 1.f, 0.f};
+                vertex.uv = {u, v};
+                return vertex;
+            };
+
+            std::vector<BEModel::Vertex> corners{};
+            corners.reserve(quadsPerSide * quadsPerSide * 6);
+            for (size_t z = 0; z < quadsPerSide; z++)
+            {
+                for (size_t x = 0; x < quadsPerSide; x++)
+                {
+                    corners.push_back(gridVertex(x, z));
+                    corners.push_back(gridVertex(x, z + 1));
+                    corners.push_back(gridVertex(x + 1, z + 1));
+                    corners.push_back(gridVertex(x, z));
+                    corners.push_back(gridVertex(x + 1, z + 1));
+                    corners.push_back(gridVertex(x + 1, z));
+                }
+            }
+            return corners;
+        }
+
+        void compare(const std::string& name, const std::vector<BEModel::Vertex>& corners)
+        {
+            const size_t repeats = std::max<size_t>(1, MIN_INDICES_PER_RUN / std::max<size_t>(1, corners.size()));
+            const double indexCount = static_cast<double>(corners.size() * repeats);
+
+            std::vector<BEModel::Vertex> referenceVertices{};
+            std::vector<uint32_t> referenceIndices{};
+            double referenceSeconds = measureSeconds(RUNS, [&]()
+            {
+                for (size_t i = 0; i < repeats; i++)
+                {
+                    deduplicateUnorderedMap(corners, referenceVertices, referenceIndices);
+                }
+            });
+
+            BEModel::Builder builder{};
+            double tableSeconds = measureSeconds(RUNS, [&]()
+            {
+                for (size_t i = 0; i < repeats; i++)
+                {
+                    builder.deduplicate(corners);
+                }
+            });
+
+            // both keep vertices in the order they first appear, so the output has to match exactly
+            if (builder.indices != referenceIndices || builder.vertices != referenceVertices)
+            {
+                throw std::runtime_error("Deduplicating " + name + " gave different geometry than unordered_map");
+            }
+
+            std::printf("%s: %zu indices, %zu unique vertices\n", name.c_str(), corners.size(), builder.vertices.size());
+            reportRate("unordered_map", referenceSeconds / repeats, indexCount / repeats, "Mindices/s");
+            reportRate("open addressing table", tableSeconds / repeats, indexCount / repeats, "Mindices/s");
+            std::printf("  %-48s %10.2fx\n", "speedup", referenceSeconds / tableSeconds);
+        }
+    }
+
+    void runDedupBenchmark()
+    {
+        std::vector<std::filesystem::path> modelPaths{};
+        for (const auto& entry : std::filesystem::directory_iterator{"models"})
+        {
+            if (entry.path().extension() == ".obj") modelPaths.push_back(entry.path());
+        }
+        std::sort(modelPaths.begin(), modelPaths.end());
+
+        BEModel::ImportSettings unindexed{};
+        unindexed.deduplicateVertices = false;
+        for (const auto& path : modelPaths)
+        {
+            // without deduplication the loader keeps one vertex per index, exactly what the table gets fed
+            BEModel::Builder builder{};
+            builder.loadModel(path.generic_string(), unindexed);
+            compare(path.generic_string(), builder.vertices);
+        }
+
+        compare("synthetic grid", makeGridCorners(SYNTHETIC_INDEX_COUNT));
+    }
+}
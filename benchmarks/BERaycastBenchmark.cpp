@@ -0,0 +1,301 @@
+﻿#include "BEBenchmark.hpp"
+
+#include "BEDevice.hpp"
+#include "BEModel.hpp"
+#include "BEWindow.hpp"
+#include "assets/BEAssetManager.hpp"
+#include "game/BEBoundsSystem.hpp"
+#include "game/BETransformSystem.hpp"
+#include "scene/BEMeshBVH.hpp"
+#include "utils/BEJobSystem.hpp"
+
+// std
+#include <cstdio>
+#include <stdexcept>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        // each subdivision splits every triangle in four, the shipped vases have about 10k triangles
+        constexpr int MESH_SUBDIVISIONS = 4;
+        constexpr uint32_t CAMERA_RESOLUTION = 1024;
+        constexpr size_t RAY_COUNT = CAMERA_RESOLUTION * CAMERA_RESOLUTION;
+        // the scene is a wall of objects this many wide and high, a few layers deep
+        constexpr uint32_t SCENE_GRID = 100;
+        constexpr float SCENE_SPACING = 3.f;
+        constexpr float SCENE_DEPTH = 30.f;
+        // batch hits are compared against single raycasts for this many rays of each set
+        constexpr size_t VERIFIED_RAYS = 10'000;
+        constexpr int RUNS = 3;
+
+        // the model's triangles as a list of three positions each, every triangle split into four
+        // by its edge midpoints per subdivision. the surface stays the same, only the count grows
+        std::vector<glm::vec3> loadSubdividedMesh(const std::string& filePath, int subdivisions)
+        {
+            BEModel::Builder builder{};
+            builder.loadModel(filePath);
+
+            std::vector<glm::vec3> positions{};
+            positions.reserve(builder.indices.size());
+            for (uint32_t index : builder.indices)
+            {
+                positions.push_back(builder.vertices[index].position);
+            }
+
+            for (int level = 0; level < subdivisions; level++)
+            {
+                std::vector<glm::vec3> split{};
+                split.reserve(positions.size() * 4);
+                for (size_t i = 0; i < positions.size(); i += 3)
+                {
+                    const glm::vec3 a = positions[i];
+                    const glm::vec3 b = positions[i + 1];
+                    const glm::vec3 c = positions[i + 2];
+                    const glm::vec3 ab = (a + b) * 0.5f;
+                    const glm::vec3 bc = (b + c) * 0.5f;
+                    const glm::vec3 ca = (c + a) * 0.5f;
+                    split.insert(split.end(), {a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca});
+                }
+                positions = std::move(split);
+            }
+            return positions;
+        }
+
+        // a pinhole camera in front of the bounds, neighbouring rays take nearly the same path
+        std::vector<Ray> makeCameraRays(const AABB& bounds)
+        {
+            const glm::vec3 center = bounds.center();
+            const float radius = glm::length(bounds.extents());
+            const glm::vec3 eye = center - glm::vec3{0.f, 0.f, 3.f * radius};
+
+            std::vector<Ray> rays{};
+            rays.reserve(RAY_COUNT);
+            for (uint32_t y = 0; y < CAMERA_RESOLUTION; y++)
+            {
+                for (uint32_t x = 0; x < CAMERA_RESOLUTION; x++)
+                {
+                    const float u = (static_cast<float>(x) + 0.5f) / CAMERA_RESOLUTION * 2.f - 1.f;
+                    const float v = (static_cast<float>(y) + 0.5f) / CAMERA_RESOLUTION * 2.f - 1.f;
+                    const glm::vec3 target = center + glm::vec3{u * radius, v * radius, 0.f};
+                    rays.push_back({eye, glm::normalize(target - eye), std::numeric_limits<float>::max()});
+                }
+            }
+            return rays;
+        }
+
+        // from random points around the bounds to random points inside them, no two rays alike
+        std::vector<Ray> makeScatteredRays(const AABB& bounds, uint32_t seed)
+        {
+            const glm::vec3 center = bounds.center();
+            const glm::vec3 extents = bounds.extents();
+            const float radius = glm::length(extents);
+
+            std::mt19937 random{seed};
+            std::uniform_real_distribution<float> signedUnit{-1.f, 1.f};
+            auto randomDirection = [&]()
+            {
+                glm::vec3 direction{};
+                do
+                {
+                    direction = {signedUnit(random), signedUnit(random), signedUnit(random)};
+                } while (glm::dot(direction, direction) > 1.f || glm::dot(direction, direction) < 1e-4f);
+                return glm::normalize(direction);
+            };
+
+            std::vector<Ray> rays{};
+            rays.reserve(RAY_COUNT);
+            for (size_t i = 0; i < RAY_COUNT; i++)
+            {
+                const glm::vec3 origin = center + randomDirection() * (2.f * radius);
+                const glm::vec3 target = center + extents * glm::vec3{signedUnit(random), signedUnit(random), signedUnit(random)};
+                rays.push_back({origin, glm::normalize(target - origin), std::numeric_limits<float>::max()});
+            }
+            return rays;
+        }
+
+        void benchmarkMeshRays(const char* name, const BEMeshBVH& bvh, const std::vector<Ray>& rays)
+        {
+            size_t hitCount = 0;
+            double seconds = measureSeconds(RUNS, [&]()
+            {
+                hitCount = 0;
+                for (const auto& ray : rays)
+                {
+                    MeshRayHit hit{};
+                    hitCount += bvh.intersect(ray.origin, ray.direction, ray.maxDistance, hit);
+                }
+            });
+
+            std::string label = std::string{name} + ", " + std::to_string(hitCount * 100 / rays.size()) + "% hit";
+            reportRate(label.c_str(), seconds, static_cast<double>(rays.size()), "Mrays/s");
+        }
+
+        // single rays through one model's triangle bvh, on one thread
+        void benchmarkMesh(const std::string& filePath)
+        {
+            const std::vector<glm::vec3> positions = loadSubdividedMesh(filePath, MESH_SUBDIVISIONS);
+
+            std::unique_ptr<BEMeshBVH> bvh{};
+            double buildSeconds = measureSeconds(1, [&]()
+            {
+                bvh = std::make_unique<BEMeshBVH>(positions, std::vector<uint32_t>{});
+            });
+
+            std::printf("%s subdivided %d times: %zu triangles, %zu nodes, %.1f MB\n",
+                filePath.c_str(),
+                MESH_SUBDIVISIONS,
+                bvh->getTriangleCount(),
+                bvh->getNodeCount(),
+                bvh->getMemorySize() / (1024.0 * 1024.0));
+            reportTime("build", buildSeconds);
+
+            benchmarkMeshRays("single rays, camera", *bvh, makeCameraRays(bvh->getBounds()));
+            benchmarkMeshRays("single rays, scattered", *bvh, makeScatteredRays(bvh->getBounds(), 1234));
+        }
+
+        // a wall of randomly turned models with ray bvhs, returns its world space bounds
+        AABB generateScene(BEAssetManager& assetManager, BERegistry& registry)
+        {
+            BEModel::ImportSettings settings{};
+            settings.buildRayBVH = true;
+            const std::shared_ptr<BEModel> models[] = {
+                assetManager.loadModel("models/smooth_vase.obj", settings),
+                assetManager.loadModel("models/flat_vase.obj", settings),
+                assetManager.loadModel("models/colored_cube.obj", settings),
+            };
+
+            std::mt19937 random{1234};
+            std::uniform_real_distribution<float> unit{0.f, 1.f};
+            AABB bounds{};
+            for (uint32_t y = 0; y < SCENE_GRID; y++)
+            {
+                for (uint32_t x = 0; x < SCENE_GRID; x++)
+                {
+                    Entity entity = registry.create();
+                    TransformComponent& transform = registry.emplace<TransformComponent>(entity);
+                    transform.translation = {
+                        static_cast<float>(x) * SCENE_SPACING,
+                        static_cast<float>(y) * SCENE_SPACING,
+                        unit(random) * SCENE_DEPTH
+                    };
+                    transform.rotation = {unit(random) * 6.28f, unit(random) * 6.28f, unit(random) * 6.28f};
+                    float scale = 0.5f + unit(random);
+                    transform.scale = {scale, scale, scale};
+                    registry.emplace<ModelComponent>(entity).model = models[(x + y) % 3];
+                }
+            }
+
+            BETransformSystem transformSystem{};
+            transformSystem.update(registry);
+            registry.view<WorldTransformComponent, ModelComponent>().each(
+                [&bounds](Entity, WorldTransformComponent& world, ModelComponent& model)
+            {
+                bounds = bounds.merged(BEBoundsSystem::computeWorldBounds(world, model));
+            });
+            return bounds;
+        }
+
+        // the batch has to find what single raycasts find, whichever path it takes
+        void verifyBatch(
+            const char* name,
+            BERegistry& registry,
+            const BEBoundsSystem& boundsSystem,
+            const std::vector<Ray>& rays,
+            const std::vector<RaycastHit>& hits)
+        {
+            for (size_t i = 0; i < std::min(VERIFIED_RAYS, rays.size()); i++)
+            {
+                RaycastHit hit{};
+                boundsSystem.raycast(registry, rays[i].origin, rays[i].direction, hit, rays[i].maxDistance);
+                if (hit.entity != hits[i].entity)
+                {
+                    throw std::runtime_error(std::string{"Batch raycast "} + name + " disagrees with raycast");
+                }
+            }
+        }
+
+        void benchmarkSceneRays(
+            const char* name,
+            BERegistry& registry,
+            const BEBoundsSystem& boundsSystem,
+            const std::vector<Ray>& rays)
+        {
+            std::printf("%s rays:\n", name);
+
+            size_t hitCount = 0;
+            double singleSeconds = measureSeconds(RUNS, [&]()
+            {
+                hitCount = 0;
+                for (const auto& ray : rays)
+                {
+                    RaycastHit hit{};
+                    hitCount += boundsSystem.raycast(registry, ray.origin, ray.direction, hit, ray.maxDistance);
+                }
+            });
+            std::string label = "single rays, 1 thread, " + std::to_string(hitCount * 100 / rays.size()) + "% hit";
+            reportRate(label.c_str(), singleSeconds, static_cast<double>(rays.size()), "Mrays/s");
+
+            // every level the cpu supports, the batch goes over all job threads in each case
+            const struct
+            {
+                SimdLevel level;
+                const char* label;
+            } levels[] = {
+                {SimdLevel::Scalar, "batch, scalar packets"},
+                {SimdLevel::SSE4, "batch, 4-wide sse4 packets"},
+                {SimdLevel::AVX2, "batch, 8-wide avx2 packets"},
+            };
+
+            std::vector<RaycastHit> hits(rays.size());
+            for (const auto& level : levels)
+            {
+                if (level.level > getSimdLevel()) continue;
+
+                double batchSeconds = measureSeconds(RUNS, [&]()
+                {
+                    boundsSystem.raycastBatch(registry, rays.data(), rays.size(), hits.data(), level.level);
+                });
+                reportRate(level.label, batchSeconds, static_cast<double>(rays.size()), "Mrays/s");
+                verifyBatch(name, registry, boundsSystem, rays, hits);
+            }
+        }
+
+        // two level queries, from the bounds tree into each candidate's mesh bvh
+        void benchmarkScene()
+        {
+            // the models have to be uploaded for the bounds system to take them, nothing is drawn
+            BEWindow window{320, 240, "BucketEngine benchmark"};
+            BEDevice device{window};
+            BEAssetManager assetManager{device};
+            BERegistry registry{};
+
+            const AABB bounds = generateScene(assetManager, registry);
+            BEBoundsSystem boundsSystem{};
+            double buildSeconds = measureSeconds(1, [&]()
+            {
+                boundsSystem.update(registry, {});
+            });
+
+            std::printf("scene of %zu objects, %zu job threads\n", registry.size(), jobThreadCount());
+            reportTime("bounds tree build", buildSeconds);
+
+            // camera rays are ordered row by row, so each packet holds neighbouring rays. scattered
+            // packets point every which way and are traced one ray at a time, spread over the threads
+            benchmarkSceneRays("camera", registry, boundsSystem, makeCameraRays(bounds));
+            benchmarkSceneRays("scattered", registry, boundsSystem, makeScatteredRays(bounds, 1234));
+        }
+    }
+
+    void runRaycastBenchmark()
+    {
+        benchmarkMesh("models/smooth_vase.obj");
+        benchmarkMesh("models/flat_vase.obj");
+        benchmarkScene();
+    }
+}
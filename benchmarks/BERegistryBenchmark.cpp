@@ -0,0 +1,120 @@
+﻿#include "BEBenchmark.hpp"
+
+#include "ecs/BERegistry.hpp"
+#include "game/BEComponents.hpp"
+
+// std
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr size_t ENTITIES_PER_REPORT = 100'000;
+        constexpr size_t ENTITY_COUNTS[] = {100'000, 1'000'000};
+        constexpr int RUNS = 10;
+
+        // keeps the loops from being optimised away
+        volatile float sink = 0.f;
+
+        // the layout the registry replaced, every game object in its own hash map node
+        struct MapGameObject
+        {
+            std::shared_ptr<BEModel> model{};
+            glm::vec3 color{};
+            TransformComponent transform{};
+        };
+
+        void reportPer100k(const char* name, double seconds, size_t entityCount)
+        {
+            reportTime(name, seconds * ENTITIES_PER_REPORT / static_cast<double>(entityCount));
+        }
+
+        void benchmarkCount(size_t entityCount)
+        {
+            BERegistry registry{};
+            std::vector<Entity> entities(entityCount);
+            registry.create(entities.data(), entities.size());
+
+            std::unordered_map<uint32_t, MapGameObject> gameObjects{};
+            for (size_t i = 0; i < entityCount; i++)
+            {
+                const float x = static_cast<float>(i);
+                registry.emplace<TransformComponent>(entities[i]).translation = {x, 0.f, 0.f};
+                registry.emplace<ColorComponent>(entities[i]).color = {x, x, x};
+                WorldTransformComponent& world = registry.emplace<WorldTransformComponent>(entities[i]);
+                world.matrix[3][0] = x;
+                // half of the entities have a model, like lights and empty objects mixed into a scene
+                if (i % 2 == 0)
+                {
+                    registry.emplace<ModelComponent>(entities[i]);
+                }
+
+                MapGameObject& gameObject = gameObjects[static_cast<uint32_t>(i)];
+                gameObject.transform.translation = {x, 0.f, 0.f};
+                gameObject.color = {x, x, x};
+            }
+
+            std::printf("%zu entities, ms per %zu entities:\n", entityCount, ENTITIES_PER_REPORT);
+
+            double mapSeconds = measureSeconds(RUNS, [&]()
+            {
+                float sum = 0.f;
+                for (const auto& [id, gameObject] : gameObjects)
+                {
+                    sum += gameObject.transform.translation.x;
+                }
+                sink = sum;
+            });
+            reportPer100k("unordered_map game objects, transform", mapSeconds, entityCount);
+
+            double oneSeconds = measureSeconds(RUNS, [&]()
+            {
+                float sum = 0.f;
+                registry.view<TransformComponent>().each([&sum](Entity, TransformComponent& transform)
+                {
+                    sum += transform.translation.x;
+                });
+                sink = sum;
+            });
+            reportPer100k("view<Transform>", oneSeconds, entityCount);
+
+            double twoSeconds = measureSeconds(RUNS, [&]()
+            {
+                float sum = 0.f;
+                registry.view<TransformComponent, ColorComponent>().each(
+                    [&sum](Entity, TransformComponent& transform, ColorComponent& color)
+                {
+                    sum += transform.translation.x + color.color.y;
+                });
+                sink = sum;
+            });
+            reportPer100k("view<Transform, Color>", twoSeconds, entityCount);
+
+            // the render loop's view, the model pool is half the size so it drives the iteration
+            double renderSeconds = measureSeconds(RUNS, [&]()
+            {
+                float sum = 0.f;
+                registry.view<WorldTransformComponent, ModelComponent>().each(
+                    [&sum](Entity, WorldTransformComponent& world, ModelComponent& model)
+                {
+                    sum += world.matrix[3][0] + (model.model ? 1.f : 0.f);
+                });
+                sink = sum;
+            });
+            reportPer100k("view<WorldTransform, Model>, half have a model", renderSeconds, entityCount);
+        }
+    }
+
+    void runRegistryBenchmark()
+    {
+        for (size_t entityCount : ENTITY_COUNTS)
+        {
+            benchmarkCount(entityCount);
+        }
+    }
+}
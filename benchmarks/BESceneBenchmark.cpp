@@ -0,0 +1,138 @@
+﻿#include "BEBenchmark.hpp"
+
+#include "BEDevice.hpp"
+#include "BEWindow.hpp"
+#include "assets/BEAssetManager.hpp"
+#include "scene/BEScene.hpp"
+
+// std
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr size_t OBJECT_COUNT = 1'000'000;
+        // one in this many objects is a point light instead of a model
+        constexpr size_t LIGHT_EVERY = 1000;
+        constexpr int RUNS = 3;
+
+        const char* const MODEL_PATHS[] = {
+            "models/flat_vase.obj",
+            "models/smooth_vase.obj",
+            "models/colored_cube.obj",
+            "models/quad.obj",
+        };
+
+        // objects scattered over a large area, each using one of the shipped models
+        void generateScene(BEAssetManager& assetManager, BERegistry& registry)
+        {
+            std::vector<std::shared_ptr<BEModel>> models{};
+            for (const char* path : MODEL_PATHS)
+            {
+                models.push_back(assetManager.loadModelAsync(path));
+            }
+
+            std::vector<Entity> entities(OBJECT_COUNT);
+            registry.create(entities.data(), entities.size());
+            registry.reserve<TransformComponent>(OBJECT_COUNT);
+            registry.reserve<ColorComponent>(OBJECT_COUNT);
+            registry.reserve<ModelComponent>(OBJECT_COUNT);
+
+            std::mt19937 random{1234};
+            std::uniform_real_distribution<float> position{-1000.f, 1000.f};
+            std::uniform_real_distribution<float> unit{0.f, 1.f};
+            for (size_t i = 0; i < entities.size(); i++)
+            {
+                TransformComponent& transform = registry.emplace<TransformComponent>(entities[i]);
+                transform.translation = {position(random), position(random), position(random)};
+                transform.rotation = {unit(random) * 6.28f, unit(random) * 6.28f, unit(random) * 6.28f};
+                float scale = 0.5f + unit(random);
+                transform.scale = {scale, scale, scale};
+
+                registry.emplace<ColorComponent>(entities[i]).color = {unit(random), unit(random), unit(random)};
+
+                if (i % LIGHT_EVERY == 0)
+                {
+                    registry.emplace<PointLightComponent>(entities[i]).lightIntensity = 0.5f + unit(random);
+                }
+                else
+                {
+                    registry.emplace<ModelComponent>(entities[i]).model = models[i % models.size()];
+                }
+            }
+        }
+
+        void benchmarkFormat(
+            const char* name,
+            BEScene::Format format,
+            const std::string& filePath,
+            BEAssetManager& assetManager,
+            const BERegistry& scene)
+        {
+            double saveSeconds = measureSeconds(RUNS, [&]()
+            {
+                BEScene::save(filePath, scene, assetManager, format);
+            });
+
+            double loadSeconds = std::numeric_limits<double>::max();
+            for (int run = 0; run < RUNS; run++)
+            {
+                // a fresh registry each run, tearing down the last one isn't part of the load
+                auto loaded = std::make_unique<BERegistry>();
+                loadSeconds = std::min(loadSeconds, measureSeconds(1, [&]()
+                {
+                    BEScene::load(filePath, assetManager, *loaded);
+                }));
+
+                if (loaded->size() != scene.size())
+                {
+                    throw std::runtime_error(std::string{"Loading the "} + name + " scene gave a different object count");
+                }
+            }
+
+            std::printf("%s scene: %.1f MB\n", name, std::filesystem::file_size(filePath) / (1024.0 * 1024.0));
+            reportRate("save", saveSeconds, OBJECT_COUNT, "Mobjects/s");
+            reportRate("load", loadSeconds, OBJECT_COUNT, "Mobjects/s");
+        }
+    }
+
+    void runSceneBenchmark()
+    {
+        // the asset manager needs a device, the window is never drawn to
+        BEWindow window{320, 240, "BucketEngine benchmark"};
+        BEDevice device{window};
+        BEAssetManager assetManager{device};
+
+        auto scene = std::make_unique<BERegistry>();
+        double generateSeconds = measureSeconds(1, [&]()
+        {
+            generateScene(assetManager, *scene);
+        });
+        std::printf("%zu objects, %zu models\n", scene->size(), assetManager.getModelCount());
+        reportRate("generate", generateSeconds, OBJECT_COUNT, "Mobjects/s");
+
+        const std::filesystem::path directory = std::filesystem::temp_directory_path();
+        const std::string binaryPath = (directory / "bucketengine_benchmark.bescene").string();
+        const std::string textPath = (directory / "bucketengine_benchmark_text.bescene").string();
+
+        benchmarkFormat("binary", BEScene::Format::Binary, binaryPath, assetManager, *scene);
+        benchmarkFormat("text", BEScene::Format::Text, textPath, assetManager, *scene);
+
+        std::filesystem::remove(binaryPath);
+        std::filesystem::remove(textPath);
+
+        // let the streamer finish the models the scene requested before tearing everything down
+        scene.reset();
+        while (assetManager.getPendingCount() > 0)
+        {
+            assetManager.update();
+        }
+    }
+}
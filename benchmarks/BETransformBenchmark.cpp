@@ -0,0 +1,91 @@
+﻿#include "BEBenchmark.hpp"
+
+#include "game/BEComponents.hpp"
+#include "utils/BETransformBatch.hpp"
+
+// std
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace bucketengine
+{
+    namespace
+    {
+        constexpr size_t TRANSFORM_COUNT = 1'000'000;
+        constexpr int RUNS = 10;
+
+        const char* levelName(SimdLevel level)
+        {
+            switch (level)
+            {
+            case SimdLevel::AVX2:
+                return "batch kernel, avx2";
+            case SimdLevel::SSE4:
+                return "batch kernel, sse4";
+            default:
+                return "batch kernel, scalar";
+            }
+        }
+    }
+
+    void runTransformBenchmark()
+    {
+        std::mt19937 random{7};
+        std::uniform_real_distribution<float> position{-100.f, 100.f};
+        std::uniform_real_distribution<float> angle{-6.3f, 6.3f};
+        std::uniform_real_distribution<float> scale{0.5f, 2.f};
+
+        std::vector<TransformComponent> transforms(TRANSFORM_COUNT);
+        std::vector<float> inputs[9];
+        for (auto& input : inputs)
+        {
+            input.resize(TRANSFORM_COUNT);
+        }
+        for (size_t i = 0; i < TRANSFORM_COUNT; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                transforms[i].translation[axis] = inputs[axis][i] = position(random);
+                transforms[i].rotation[axis] = inputs[3 + axis][i] = angle(random);
+                transforms[i].scale[axis] = inputs[6 + axis][i] = scale(random);
+            }
+        }
+        TransformBatch batch{
+            inputs[0].data(), inputs[1].data(), inputs[2].data(),
+            inputs[3].data(), inputs[4].data(), inputs[5].data(),
+            inputs[6].data(), inputs[7].data(), inputs[8].data(),
+            TRANSFORM_COUNT
+        };
+
+        // both outputs in the layout the renderer reads, a mat4 and a mat3x4 per transform
+        std::vector<glm::mat4> modelMatrices(TRANSFORM_COUNT);
+        std::vector<glm::mat3x4> normalMatrices(TRANSFORM_COUNT);
+
+        std::printf("%zu transforms, model and normal matrices:\n", TRANSFORM_COUNT);
+
+        double componentSeconds = measureSeconds(RUNS, [&]()
+        {
+            for (size_t i = 0; i < TRANSFORM_COUNT; i++)
+            {
+                modelMatrices[i] = transforms[i].mat4();
+                normalMatrices[i] = glm::mat3x4{transforms[i].normalMatrix()};
+            }
+        });
+        reportRate("TransformComponent::mat4 and normalMatrix", componentSeconds, TRANSFORM_COUNT, "Mtransforms/s");
+
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2})
+        {
+            if (level > getSimdLevel())
+            {
+                std::printf("  %-48s not supported by this cpu\n", levelName(level));
+                continue;
+            }
+            double seconds = measureSeconds(RUNS, [&]()
+            {
+                computeTransformMatrices(batch, modelMatrices.data(), normalMatrices.data(), level);
+            });
+            reportRate(levelName(level), seconds, TRANSFORM_COUNT, "Mtransforms/s");
+        }
+    }
+}
@@ -0,0 +1,54 @@
+﻿#include "BEBenchmark.hpp"
+
+// std
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    struct Benchmark
+    {
+        const char* name;
+        void (*run)();
+    };
+
+    const Benchmark BENCHMARKS[] = {
+        {"dedup", bucketengine::runDedupBenchmark},
+        {"scene", bucketengine::runSceneBenchmark},
+        {"registry", bucketengine::runRegistryBenchmark},
+        {"raycast", bucketengine::runRaycastBenchmark},
+        {"transform", bucketengine::runTransformBenchmark},
+    };
+}
+
+// BucketEngineBenchmarks [benchmark names...], runs all of them when none are named
+int main(int argc, char** argv)
+{
+    // models and scenes are loaded by the same relative paths the app uses
+    std::filesystem::current_path(BUCKETENGINE_ASSET_DIR);
+
+    try
+    {
+        for (const auto& benchmark : BENCHMARKS)
+        {
+            bool selected = argc < 2;
+            for (int i = 1; i < argc; i++)
+            {
+                selected = selected || std::strcmp(argv[i], benchmark.name) == 0;
+            }
+            if (!selected) continue;
+
+            std::cout << benchmark.name << '\n';
+            benchmark.run();
+        }
+    } catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+﻿#include "assets/BEAssetArchive.hpp"
+#include "utils/BECompression.hpp"
+
+// std
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace bucketengine;
+
+// round trips the lz4 codec and the asset archive, and feeds both corrupt data. corrupt input has
+// to be rejected, running the target under a sanitizer also catches reads and writes out of range
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char* test, const char* what)
+    {
+        if (!condition)
+        {
+            std::printf("FAILED %s: %s\n", test, what);
+            failures++;
+        }
+    }
+
+    // inputs from incompressible to very repetitive, the shapes the codec's paths depend on
+    std::vector<std::vector<char>> makeInputs()
+    {
+        std::mt19937 random{1234};
+        std::vector<std::vector<char>> inputs{};
+
+        inputs.push_back({});
+        inputs.push_back({'a'});
+        inputs.push_back(std::vector<char>(13, 'b'));
+
+        std::vector<char> noise(100000);
+        for (char& c : noise) c = static_cast<char>(random());
+        inputs.push_back(noise);
+
+        // long runs, so match lengths need extra length bytes
+        inputs.push_back(std::vector<char>(1 << 20, 'z'));
+
+        // text like data with short repeats at many offsets
+        std::vector<char> text{};
+        const char* words[] = {"vertex ", "normal ", "0.5 ", "-1.25 ", "face ", "\n"};
+        while (text.size() < 300000)
+        {
+            const char* word = words[random() % 6];
+            text.insert(text.end(), word, word + std::strlen(word));
+        }
+        inputs.push_back(text);
+
+        // random bytes with repeats copied from far back, to reach the large offsets
+        std::vector<char> mixed(200000);
+        for (size_t i = 0; i < mixed.size(); i++)
+        {
+            mixed[i] = i > 60000 && random() % 4 != 0 ? mixed[i - 60000] : static_cast<char>(random());
+        }
+        inputs.push_back(mixed);
+        return inputs;
+    }
+
+    std::vector<char> compress(const std::vector<char>& input)
+    {
+        std::vector<char> block(lz4::compressBound(input.size()));
+        block.resize(lz4::compress(input.data(), input.size(), block.data()));
+        return block;
+    }
+
+    void testRoundTrip()
+    {
+        for (const auto& input : makeInputs())
+        {
+            std::vector<char> block = compress(input);
+            check(block.size() <= lz4::compressBound(input.size()), "round trip", "block larger than compressBound");
+            check(input.size() <= lz4::maxDecompressedSize(block.size()), "round trip", "input larger than maxDecompressedSize");
+
+            std::vector<char> output(input.size());
+            check(lz4::decompress(block.data(), block.size(), output.data(), output.size()), "round trip", "a block failed to decode");
+            check(output == input, "round trip", "decoded bytes differ");
+        }
+
+        // 1MB of one byte is close to the codec's best ratio
+        std::vector<char> run(1 << 20, 'z');
+        check(compress(run).size() * 200 < run.size(), "round trip", "a long run compressed poorly");
+    }
+
+    void testCorruptBlocks()
+    {
+        std::mt19937 random{5678};
+        for (const auto& input : makeInputs())
+        {
+            if (input.empty()) continue;
+            const std::vector<char> block = compress(input);
+            std::vector<char> output(input.size());
+
+            // the size is part of the format, the wrong one must not decode
+            std::vector<char> larger(input.size() + 1);
+            check(!lz4::decompress(block.data(), block.size(), larger.data(), larger.size()), "corrupt blocks", "decoded into a larger size");
+            if (input.size() > 1)
+            {
+                check(!lz4::decompress(block.data(), block.size(), output.data(), output.size() - 1), "corrupt blocks", "decoded into a smaller size");
+            }
+
+            for (size_t length = 0; length < block.size(); length += 1 + block.size() / 16)
+            {
+                check(!lz4::decompress(block.data(), length, output.data(), output.size()), "corrupt blocks", "a truncated block decoded");
+            }
+
+            // flipped bytes may still decode to something, but only to exactly the requested size
+            for (int trial = 0; trial < 200; trial++)
+            {
+                std::vector<char> corrupt = block;
+                for (int flip = 0; flip < 3; flip++)
+                {
+                    corrupt[random() % corrupt.size()] ^= static_cast<char>(1 + random() % 255);
+                }
+                lz4::decompress(corrupt.data(), corrupt.size(), output.data(), output.size());
+            }
+        }
+    }
+
+    // same layout as the archive's own header, only used to find the table of contents
+    struct ArchiveHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t entriesOffset;
+        uint64_t pathsOffset;
+        uint64_t pathsSize;
+    };
+
+    std::vector<char> readFile(const std::string& path)
+    {
+        std::ifstream file{path, std::ios::binary};
+        return std::vector<char>(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+
+    void writeFile(const std::string& path, const std::vector<char>& bytes)
+    {
+        std::ofstream file{path, std::ios::binary | std::ios::trunc};
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    bool opens(const std::string& path)
+    {
+        try
+        {
+            BEAssetArchive archive{path};
+            return true;
+        } catch (const std::runtime_error&)
+        {
+            return false;
+        }
+    }
+
+    void testArchive()
+    {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path();
+        const std::string archivePath = (directory / "bucketengine_test.bepk").string();
+        const std::string corruptPath = (directory / "bucketengine_test_corrupt.bepk").string();
+
+        std::vector<std::vector<char>> inputs = makeInputs();
+        BEAssetArchive::Writer writer{};
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            auto compression = i % 2 == 0 ? BEAssetArchive::Compression::LZ4 : BEAssetArchive::Compression::None;
+            writer.addData("data/" + std::to_string(i) + ".bin", inputs[i].data(), inputs[i].size(), compression);
+        }
+        writer.write(archivePath);
+
+        {
+            BEAssetArchive archive{archivePath};
+            check(archive.getEntryCount() == inputs.size(), "archive", "wrong entry count");
+            for (size_t i = 0; i < inputs.size(); i++)
+            {
+                const BEAssetArchive::Entry* entry = archive.find("./data/" + std::to_string(i) + ".bin");
+                check(entry != nullptr, "archive", "an entry wasn't found by an equivalent path");
+                if (entry == nullptr) continue;
+
+                std::vector<char> output{};
+                archive.read(*entry, output);
+                check(output == inputs[i], "archive", "an entry read back differently");
+            }
+            check(archive.find("data/missing.bin") == nullptr, "archive", "found an entry that was never added");
+        }
+
+        const std::vector<char> original = readFile(archivePath);
+        ArchiveHeader header;
+        std::memcpy(&header, original.data(), sizeof(header));
+
+        // every compressed entry claiming more than lz4 can expand to is rejected when opening, before
+        // anything is allocated for it
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            std::vector<char> corrupt = original;
+            auto* entry = reinterpret_cast<BEAssetArchive::Entry*>(corrupt.data() + header.entriesOffset) + i;
+            if (entry->compression != BEAssetArchive::Compression::LZ4) continue;
+
+            entry->size = uint64_t{1} << 40;
+            writeFile(corruptPath, corrupt);
+            check(!opens(corruptPath), "archive", "opened an entry with an impossible size");
+        }
+
+        // entries pointing out of the file, unknown compression and a broken header
+        {
+            std::vector<char> corrupt = original;
+            auto* entry = reinterpret_cast<BEAssetArchive::Entry*>(corrupt.data() + header.entriesOffset);
+            entry->offset = corrupt.size();
+            writeFile(corruptPath, corrupt);
+            check(!opens(corruptPath), "archive", "opened an entry outside the file");
+        }
+        {
+            std::vector<char> corrupt = original;
+            auto* entry = reinterpret_cast<BEAssetArchive::Entry*>(corrupt.data() + header.entriesOffset);
+            entry->compression = static_cast<BEAssetArchive::Compression>(7);
+            writeFile(corruptPath, corrupt);
+            check(!opens(corruptPath), "archive", "opened an entry with unknown compression");
+        }
+        {
+            std::vector<char> corrupt = original;
+            corrupt.resize(header.entriesOffset + 8);
+            writeFile(corruptPath, corrupt);
+            check(!opens(corruptPath), "archive", "opened a truncated table of contents");
+        }
+
+        // a flipped data byte keeps the table valid, so it only shows up when the entry is read,
+        // through the decoder for compressed entries and the content hash for stored ones
+        for (const char* path : {"data/3.bin", "data/6.bin"})
+        {
+            uint64_t offset = 0;
+            uint64_t storedSize = 0;
+            {
+                BEAssetArchive archive{archivePath};
+                const BEAssetArchive::Entry* entry = archive.find(path);
+                offset = entry->offset;
+                storedSize = entry->storedSize;
+            }
+
+            std::vector<char> corrupt = original;
+            corrupt[offset + storedSize / 2] ^= 0x5a;
+            writeFile(corruptPath, corrupt);
+
+            BEAssetArchive archive{corruptPath};
+            std::vector<char> output{};
+            bool threw = false;
+            try
+            {
+                archive.read(*archive.find(path), output);
+            } catch (const std::runtime_error&)
+            {
+                threw = true;
+            }
+            check(threw, "archive", "read a corrupt entry without an error");
+        }
+
+        std::filesystem::remove(archivePath);
+        std::filesystem::remove(corruptPath);
+    }
+}
+
+int main()
+{
+    testRoundTrip();
+    testCorruptBlocks();
+    testArchive();
+
+    if (failures > 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all compression checks passed\n");
+    return 0;
+}
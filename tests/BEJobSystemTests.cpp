@@ -0,0 +1,384 @@
+﻿#include "utils/BEJobSystem.hpp"
+#include "utils/BEParallel.hpp"
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace bucketengine;
+
+// stresses the work stealing deques, counters and worker sleep of the job system. every test checks
+// that each job ran exactly once, a hang is a failure too and is caught by the ctest timeout
+namespace
+{
+    constexpr size_t THREAD_COUNT = 8;
+
+    int failures = 0;
+
+    void check(bool condition, const char* test, const char* what)
+    {
+        if (!condition)
+        {
+            std::printf("FAILED %s: %s\n", test, what);
+            failures++;
+        }
+    }
+
+    // one flag per job, set by the job itself
+    struct RunOnce
+    {
+        std::unique_ptr<std::atomic<uint32_t>[]> runs;
+        size_t count;
+
+        explicit RunOnce(size_t count) : runs{std::make_unique<std::atomic<uint32_t>[]>(count)}, count{count}
+        {
+            for (size_t i = 0; i < count; i++) runs[i].store(0, std::memory_order_relaxed);
+        }
+
+        bool allOnce() const
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (runs[i].load(std::memory_order_relaxed) != 1) return false;
+            }
+            return true;
+        }
+    };
+
+    struct FlagJob
+    {
+        std::atomic<uint32_t>* run;
+    };
+
+    void runFlagJob(void* context)
+    {
+        static_cast<FlagJob*>(context)->run->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // submits count jobs from the calling thread in batches and waits for all of them
+    void submitFlagJobs(RunOnce& runOnce, std::vector<FlagJob>& contexts, size_t batchSize)
+    {
+        contexts.resize(runOnce.count);
+        std::vector<JobDecl> jobs(runOnce.count);
+        for (size_t i = 0; i < runOnce.count; i++)
+        {
+            contexts[i].run = &runOnce.runs[i];
+            jobs[i] = {runFlagJob, &contexts[i]};
+        }
+
+        JobCounter counter{};
+        for (size_t first = 0; first < jobs.size(); first += batchSize)
+        {
+            submitJobs(jobs.data() + first, std::min(batchSize, jobs.size() - first), &counter);
+        }
+        waitForCounter(counter);
+        check(counter.isDone(), "submit", "counter not done after waitForCounter");
+    }
+
+    // more jobs than a deque holds, pushed by the owning thread while every other thread steals,
+    // the overflow goes through the shared queue
+    void testPushPopSteal()
+    {
+        for (size_t batchSize : {1, 64, 10000})
+        {
+            RunOnce runOnce{200000};
+            std::vector<FlagJob> contexts;
+            submitFlagJobs(runOnce, contexts, batchSize);
+            check(runOnce.allOnce(), "push pop steal", "a job didn't run exactly once");
+        }
+    }
+
+    // threads outside the job system submit through the shared queue and help out while waiting
+    void testExternalThreads()
+    {
+        constexpr size_t EXTERNAL_THREADS = 4;
+        std::vector<std::unique_ptr<RunOnce>> runs;
+        std::vector<std::vector<FlagJob>> contexts(EXTERNAL_THREADS);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < EXTERNAL_THREADS; t++)
+        {
+            runs.push_back(std::make_unique<RunOnce>(20000));
+        }
+        for (size_t t = 0; t < EXTERNAL_THREADS; t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                for (int round = 0; round < 10; round++)
+                {
+                    RunOnce roundRuns{2000};
+                    std::vector<FlagJob> roundContexts;
+                    submitFlagJobs(roundRuns, roundContexts, 100);
+                    check(roundRuns.allOnce(), "external threads", "a job didn't run exactly once");
+                }
+                submitFlagJobs(*runs[t], contexts[t], 7);
+            });
+        }
+
+        // the owner of deque 0 keeps submitting at the same time
+        RunOnce ownRuns{50000};
+        std::vector<FlagJob> ownContexts;
+        submitFlagJobs(ownRuns, ownContexts, 50);
+
+        for (auto& thread : threads) thread.join();
+        for (const auto& run : runs)
+        {
+            check(run->allOnce(), "external threads", "a job didn't run exactly once");
+        }
+        check(ownRuns.allOnce(), "external threads", "a job on deque 0 didn't run exactly once");
+    }
+
+    // each link only starts once the one before has finished, the counters hand the continuations over
+    void testDependencyChains()
+    {
+        constexpr size_t CHAINS = 16;
+        constexpr size_t LINKS = 200;
+
+        struct Link
+        {
+            std::atomic<uint64_t>* clock;
+            std::atomic<uint64_t>* previousTime;
+            std::atomic<uint64_t> time{0};
+            std::atomic<bool> ordered{true};
+        };
+
+        std::atomic<uint64_t> clock{1};
+        std::vector<std::unique_ptr<Link[]>> chains;
+        std::vector<std::unique_ptr<JobCounter[]>> counters;
+        for (size_t c = 0; c < CHAINS; c++)
+        {
+            chains.push_back(std::make_unique<Link[]>(LINKS));
+            counters.push_back(std::make_unique<JobCounter[]>(LINKS));
+        }
+
+        auto runLink = [](void* context)
+        {
+            Link& link = *static_cast<Link*>(context);
+            // the previous link must have stamped its time before this one started
+            if (link.previousTime != nullptr && link.previousTime->load(std::memory_order_relaxed) == 0)
+            {
+                link.ordered.store(false, std::memory_order_relaxed);
+            }
+            link.time.store(link.clock->fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+        };
+
+        // every chain starts behind a slow job, so most links are still held back as continuations
+        // when they are submitted and get released by the link before them
+        auto gate = []()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        };
+        JobCounter gateCounter{};
+        submitJob(gate, &gateCounter);
+        for (size_t c = 0; c < CHAINS; c++)
+        {
+            for (size_t i = 0; i < LINKS; i++)
+            {
+                Link& link = chains[c][i];
+                link.clock = &clock;
+                link.previousTime = i > 0 ? &chains[c][i - 1].time : nullptr;
+                JobDecl job{+runLink, &link};
+                submitJobs(&job, 1, &counters[c][i], i > 0 ? &counters[c][i - 1] : &gateCounter);
+            }
+        }
+
+        for (size_t c = 0; c < CHAINS; c++)
+        {
+            for (size_t i = 0; i < LINKS; i++)
+            {
+                waitForCounter(counters[c][i]);
+                const Link& link = chains[c][i];
+                check(link.time.load() != 0, "dependency chains", "a link never ran");
+                check(link.ordered.load(), "dependency chains", "a link ran before the one it depends on");
+                if (i > 0)
+                {
+                    check(link.time.load() > chains[c][i - 1].time.load(), "dependency chains", "links ran out of order");
+                }
+            }
+        }
+
+        // many jobs held back by one counter, and a dependency that is already done
+        RunOnce fanOut{5000};
+        std::vector<FlagJob> contexts(fanOut.count);
+        std::vector<JobDecl> jobs(fanOut.count);
+        for (size_t i = 0; i < fanOut.count; i++)
+        {
+            contexts[i].run = &fanOut.runs[i];
+            jobs[i] = {runFlagJob, &contexts[i]};
+        }
+        std::atomic<bool> gateOpen{false};
+        auto openGate = [&gateOpen]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            gateOpen.store(true);
+        };
+        JobCounter fanOutGate{};
+        JobCounter fanOutCounter{};
+        submitJob(openGate, &fanOutGate);
+        submitJobs(jobs.data(), jobs.size() / 2, &fanOutCounter, &fanOutGate);
+        waitForCounter(fanOutGate);
+        submitJobs(jobs.data() + jobs.size() / 2, jobs.size() - jobs.size() / 2, &fanOutCounter, &fanOutGate);
+        waitForCounter(fanOutCounter);
+        check(gateOpen.load(), "dependency chains", "fan out finished before its dependency");
+        check(fanOut.allOnce(), "dependency chains", "a fanned out job didn't run exactly once");
+    }
+
+    // jobs that split themselves and wait for their halves, so every thread ends up waiting inside
+    // jobs while running others
+    struct TreeJob
+    {
+        uint32_t depth;
+        std::atomic<uint64_t>* leaves;
+    };
+
+    void runTreeJob(void* context)
+    {
+        TreeJob& job = *static_cast<TreeJob*>(context);
+        if (job.depth == 0)
+        {
+            job.leaves->fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        TreeJob children[2] = {{job.depth - 1, job.leaves}, {job.depth - 1, job.leaves}};
+        JobDecl jobs[2] = {{runTreeJob, &children[0]}, {runTreeJob, &children[1]}};
+        JobCounter counter{};
+        submitJobs(jobs, 2, &counter);
+        waitForCounter(counter);
+    }
+
+    void testWaitInsideJobs()
+    {
+        constexpr uint32_t DEPTH = 14;
+        for (int round = 0; round < 4; round++)
+        {
+            std::atomic<uint64_t> leaves{0};
+            TreeJob root{DEPTH, &leaves};
+            JobDecl job{runTreeJob, &root};
+            JobCounter counter{};
+            submitJobs(&job, 1, &counter);
+            waitForCounter(counter);
+            check(leaves.load() == (uint64_t{1} << DEPTH), "wait inside jobs", "wrong number of leaves");
+        }
+
+        // the same from external threads at once
+        std::vector<std::thread> threads;
+        std::atomic<uint64_t> leaves{0};
+        for (int t = 0; t < 3; t++)
+        {
+            threads.emplace_back([&leaves]()
+            {
+                TreeJob root{10, &leaves};
+                JobDecl job{runTreeJob, &root};
+                JobCounter counter{};
+                submitJobs(&job, 1, &counter);
+                waitForCounter(counter);
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        check(leaves.load() == 3 * (uint64_t{1} << 10), "wait inside jobs", "wrong number of leaves from external threads");
+    }
+
+    void testParallelFor()
+    {
+        for (size_t count : {1, 7, 1000, 100003})
+        {
+            for (size_t grainSize : {1, 16, 4096})
+            {
+                RunOnce runOnce{count};
+                parallelFor(count, grainSize, [&runOnce](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; i++) runOnce.runs[i].fetch_add(1, std::memory_order_relaxed);
+                });
+                check(runOnce.allOnce(), "parallel for", "an index wasn't visited exactly once");
+            }
+        }
+
+        // nested, the inner loops run while the outer ranges wait on them
+        constexpr size_t OUTER = 64;
+        constexpr size_t INNER = 2000;
+        RunOnce nested{OUTER * INNER};
+        parallelFor(OUTER, 1, [&nested](size_t begin, size_t end)
+        {
+            for (size_t outer = begin; outer < end; outer++)
+            {
+                parallelFor(INNER, 100, [&nested, outer](size_t innerBegin, size_t innerEnd)
+                {
+                    for (size_t i = innerBegin; i < innerEnd; i++)
+                    {
+                        nested.runs[outer * INNER + i].fetch_add(1, std::memory_order_relaxed);
+                    }
+                });
+            }
+        });
+        check(nested.allOnce(), "parallel for", "a nested index wasn't visited exactly once");
+    }
+
+    // lets the workers fall asleep, then hands them single jobs from various threads. a lost wake up
+    // leaves the job to the waiting thread, so the check is that sleeping workers do pick jobs up
+    void testSleepWake()
+    {
+        uint64_t sleepsBefore = getJobSystemStats().workerSleeps;
+        std::atomic<uint32_t> workerRuns{0};
+        auto onWorker = [&workerRuns]()
+        {
+            workerRuns.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        for (int round = 0; round < 200; round++)
+        {
+            // short enough that some rounds race the workers going to sleep
+            std::this_thread::sleep_for(std::chrono::microseconds(round % 4 == 0 ? 2000 : 50));
+
+            JobCounter counter{};
+            submitJob(onWorker, &counter);
+            // give a worker the chance to take it before helping out
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            while (!counter.isDone() && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::yield();
+            }
+            check(counter.isDone(), "sleep wake", "a sleeping worker never picked up a job");
+            waitForCounter(counter);
+        }
+
+        check(getJobSystemStats().workerSleeps > sleepsBefore, "sleep wake", "workers never went to sleep");
+        check(workerRuns.load() == 200, "sleep wake", "a job didn't run exactly once");
+    }
+}
+
+int main()
+{
+    // more threads than cores is fine, it only makes the interleavings more varied
+    setJobThreadCount(THREAD_COUNT);
+    check(jobThreadCount() == THREAD_COUNT, "setup", "job thread count wasn't applied");
+
+    testPushPopSteal();
+    testExternalThreads();
+    testDependencyChains();
+    testWaitInsideJobs();
+    testParallelFor();
+    testSleepWake();
+
+    JobSystemStats stats = getJobSystemStats();
+    std::printf("%llu jobs, %llu stolen, %llu injected, %llu worker sleeps\n",
+        static_cast<unsigned long long>(stats.jobsExecuted),
+        static_cast<unsigned long long>(stats.jobsStolen),
+        static_cast<unsigned long long>(stats.jobsInjected),
+        static_cast<unsigned long long>(stats.workerSleeps));
+    check(stats.jobsStolen > 0, "stats", "no job was ever stolen");
+    check(stats.jobsInjected > 0, "stats", "no job went through the shared queue");
+
+    if (failures > 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all job system checks passed\n");
+    return 0;
+}
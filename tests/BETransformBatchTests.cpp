@@ -0,0 +1,171 @@
+﻿#include "game/BEComponents.hpp"
+#include "utils/BETransformBatch.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace bucketengine;
+
+// runs every simd level of the batch kernel over random transforms and compares the results with
+// TransformComponent::mat4 and normalMatrix, which the renderer used before the kernel existed
+namespace
+{
+    // a few ulp of the largest entry, the polynomial sincos is accurate to about 1e-7
+    constexpr float TOLERANCE = 2e-6f;
+    // not a multiple of any simd width, so the scalar tail runs after every path
+    constexpr size_t TRANSFORM_COUNT = 10'003;
+
+    int failures = 0;
+
+    void check(bool condition, const char* test, const char* what)
+    {
+        if (!condition)
+        {
+            std::printf("FAILED %s: %s\n", test, what);
+            failures++;
+        }
+    }
+
+    const char* levelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::AVX2:
+            return "avx2";
+        case SimdLevel::SSE4:
+            return "sse4";
+        default:
+            return "scalar";
+        }
+    }
+
+    std::vector<TransformComponent> makeTransforms(float maxAngle, uint32_t seed)
+    {
+        std::mt19937 random{seed};
+        std::uniform_real_distribution<float> translation{-100.f, 100.f};
+        std::uniform_real_distribution<float> angle{-maxAngle, maxAngle};
+        std::uniform_real_distribution<float> scale{0.05f, 20.f};
+        std::bernoulli_distribution mirrored{0.1};
+
+        std::vector<TransformComponent> transforms(TRANSFORM_COUNT);
+        for (TransformComponent& transform : transforms)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                transform.translation[axis] = translation(random);
+                transform.rotation[axis] = angle(random);
+                transform.scale[axis] = scale(random) * (mirrored(random) ? -1.f : 1.f);
+            }
+        }
+        return transforms;
+    }
+
+    // error relative to the largest entry of the column, entries that should be zero are compared
+    // against the column's scale rather than against themselves
+    template <typename Column>
+    float columnError(const Column& actual, const Column& expected, int rows)
+    {
+        float magnitude = 1.f;
+        float error = 0.f;
+        for (int row = 0; row < rows; row++)
+        {
+            magnitude = std::max(magnitude, std::abs(expected[row]));
+            error = std::max(error, std::abs(actual[row] - expected[row]));
+        }
+        return error / magnitude;
+    }
+
+    void testLevel(SimdLevel level, const char* test, float maxAngle)
+    {
+        const std::vector<TransformComponent> transforms = makeTransforms(maxAngle, 42);
+
+        std::vector<float> inputs[9];
+        for (auto& input : inputs)
+        {
+            input.resize(transforms.size());
+        }
+        for (size_t i = 0; i < transforms.size(); i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                inputs[axis][i] = transforms[i].translation[axis];
+                inputs[3 + axis][i] = transforms[i].rotation[axis];
+                inputs[6 + axis][i] = transforms[i].scale[axis];
+            }
+        }
+        TransformBatch batch{
+            inputs[0].data(), inputs[1].data(), inputs[2].data(),
+            inputs[3].data(), inputs[4].data(), inputs[5].data(),
+            inputs[6].data(), inputs[7].data(), inputs[8].data(),
+            transforms.size()
+        };
+
+        std::vector<glm::mat4> modelMatrices(transforms.size());
+        std::vector<glm::mat3x4> normalMatrices(transforms.size());
+        computeTransformMatrices(batch, modelMatrices.data(), normalMatrices.data(), level);
+
+        float worstModel = 0.f;
+        float worstNormal = 0.f;
+        bool padding = true;
+        for (size_t i = 0; i < transforms.size(); i++)
+        {
+            const glm::mat4 model = transforms[i].mat4();
+            const glm::mat3 normal = transforms[i].normalMatrix();
+            for (int column = 0; column < 4; column++)
+            {
+                worstModel = std::max(worstModel, columnError(modelMatrices[i][column], model[column], 4));
+            }
+            for (int column = 0; column < 3; column++)
+            {
+                worstNormal = std::max(worstNormal, columnError(glm::vec3{normalMatrices[i][column]}, normal[column], 3));
+                // the shader reads the normal matrix as mat3, but the padding has to stay zero for the object id
+                padding = padding && normalMatrices[i][column][3] == 0.f;
+            }
+        }
+
+        std::printf("%-6s %s: worst relative error %g model, %g normal\n", levelName(level), test, worstModel, worstNormal);
+        check(worstModel <= TOLERANCE, test, "model matrices differ from TransformComponent::mat4");
+        check(worstNormal <= TOLERANCE, test, "normal matrices differ from TransformComponent::normalMatrix");
+        check(padding, test, "normal matrix padding isn't zero");
+
+        // either output can be skipped without changing the other
+        std::vector<glm::mat4> modelOnly(transforms.size());
+        std::vector<glm::mat3x4> normalOnly(transforms.size());
+        computeTransformMatrices(batch, modelOnly.data(), nullptr, level);
+        computeTransformMatrices(batch, nullptr, normalOnly.data(), level);
+        bool same = true;
+        for (size_t i = 0; i < transforms.size(); i++)
+        {
+            same = same && modelOnly[i] == modelMatrices[i] && normalOnly[i] == normalMatrices[i];
+        }
+        check(same, test, "results depend on which outputs were asked for");
+    }
+}
+
+int main()
+{
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2})
+    {
+        // levels the cpu lacks fall back to scalar, which is still worth running but proves nothing new
+        if (level > getSimdLevel())
+        {
+            std::printf("%-6s not supported by this cpu, skipped\n", levelName(level));
+            continue;
+        }
+        testLevel(level, "angles within 2pi", 6.3f);
+        // range reduction has to hold up for objects that have been spinning for a long time
+        testLevel(level, "angles up to 4000 radians", 4000.f);
+    }
+
+    if (failures > 0)
+    {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all transform batch checks passed\n");
+    return 0;
+}